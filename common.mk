@@ -29,7 +29,7 @@ LDFLAGS += -O3
 endif
 
 INCPATHS = -I/usr/local/include `pkg-config --cflags tensorlight`
-LDFLAGS += -L/usr/local/lib -lm `pkg-config --libs tensorlight`
+LDFLAGS += -L/usr/local/lib -lm -lpthread `pkg-config --libs tensorlight`
 
 ifeq ($(WITH_CUDA), yes)
 CFLAGS += -DLN_CUDA -DTL_CUDA
@@ -85,6 +85,30 @@ static void ${op_name}_post_run(ln_op_arg *op_arg, ln_error **error)
      /* ..... */
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void ${op_name}_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+
+     /* count the work of run() */
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = 0;
+}
+
+/*
+ * Define ${op_name}_emit() to let the AOT compiler handle this op, see
+ * ln_compile.h. It should write the C statements of one run() to ctx, from
+ * the tensors allocated in pre_run().
+ */
+
+/*
+ * Define ${op_name}_variants[] (ended by {NULL, NULL}) to let ln_tune_ops()
+ * pick the fastest implementation of run().
+ */
+
 static ln_op_arg op_arg_${op_name} = {
      .optype = "${op_name}",
 };
@@ -94,7 +118,10 @@ ln_op ln_opimpl_${op_name} = {
      .op_arg = &op_arg_${op_name},
      .pre_run = ${op_name}_pre_run,
      .run = ${op_name}_run,
-     .post_run = ${op_name}_post_run
+     .post_run = ${op_name}_post_run,
+     .cost = ${op_name}_cost,
+     /* .variants = ${op_name}_variants, */
+     /* .emit = ${op_name}_emit */
 };
 EOF
 
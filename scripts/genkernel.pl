@@ -0,0 +1,199 @@
+#! /usr/bin/perl
+
+use warnings;
+use strict;
+use Cwd 'abs_path';
+
+my $usage = <<EOF;
+Usage: $0 ROOT
+Generate dtype- and rank-specialized kernels.
+ROOT is the path of the project root.
+
+Example:
+	scripts/genkernel.pl .
+
+	Executing this example from project root will generate
+	ROOT/src/ln_kernel_gen.c, with transpose kernels for each element
+	size and ranks 1 to LN_KERNEL_MAXDIM, and maxreduce kernels for each
+	dtype, which ROOT/src/ln_kernel.c chooses from.
+EOF
+if (@ARGV < 1) {
+  print $usage;
+  exit;
+}
+my $root = abs_path($ARGV[0]);
+
+# keep in sync with LN_KERNEL_MAXDIM and the tables in ln_kernel.h
+my $max_dim = 6;
+my @sizes = ([1, "uint8_t"], [2, "uint16_t"], [4, "uint32_t"], [8, "uint64_t"]);
+my @dtypes = (["TL_DOUBLE", "double"], ["TL_FLOAT", "float"],
+              ["TL_INT32", "int32_t"], ["TL_INT16", "int16_t"],
+              ["TL_INT8", "int8_t"], ["TL_UINT32", "uint32_t"],
+              ["TL_UINT16", "uint16_t"], ["TL_UINT8", "uint8_t"]);
+
+my $header = <<EOF;
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Generated by scripts/genkernel.pl. Edit the script instead. */
+
+#include <stdint.h>
+#include "ln_kernel.h"
+EOF
+
+# One loop per merged dim. The innermost loop reads the source with its
+# stride, or contiguously if $contig, so the compiler can vectorize it.
+sub transpose_kernel {
+  my ($type, $size, $ndim, $contig) = @_;
+  my $name = "transpose_${size}_${ndim}" . ($contig ? "_contig" : "");
+  my $last = $ndim - 1;
+  my $code = "\nstatic void $name(const void *src, void *dst, const int *dims,\n";
+  $code .= " " x (length("static void $name(")) . "const size_t *strides)\n{\n";
+  $code .= "     const $type *s = src;\n";
+  $code .= "     $type *d = dst;\n";
+  if ($ndim > 1) {
+    $code .= "     const $type *" . join(", *", map { "s$_" } 0 .. $ndim - 2) . ";\n";
+  }
+  $code .= "     int " . join(", ", map { "i$_" } 0 .. $last) . ";\n\n";
+  my $indent = "     ";
+  my $prev = "s";
+  for my $i (0 .. $ndim - 2) {
+    $code .= "${indent}for (i$i = 0; i$i < dims[$i]; i$i++) {\n";
+    $indent .= "     ";
+    $code .= "${indent}s$i = $prev + (size_t)i$i * strides[$i];\n";
+    $prev = "s$i";
+  }
+  my $read = $contig ? "${prev}[i$last]" : "${prev}[(size_t)i$last * strides[$last]]";
+  $code .= "${indent}for (i$last = 0; i$last < dims[$last]; i$last++)\n";
+  $code .= "${indent}     d[i$last] = $read;\n";
+  $code .= "${indent}d += dims[$last];\n" if $ndim > 1;
+  for my $i (reverse 0 .. $ndim - 2) {
+    $indent = substr($indent, 5);
+    $code .= "${indent}}\n";
+  }
+  $code .= "}\n";
+  return ($name, $code);
+}
+
+# Reduce [outer, n, inner] to [outer, 1, inner]. Over the last axis
+# (inner == 1) rows are scanned; otherwise whole rows of inner elements
+# are compared at once. The first maximum wins, like tl_tensor_maxreduce().
+sub maxreduce_kernel {
+  my ($type, $tname, $last, $with_arg) = @_;
+  my $name = "maxreduce_${tname}_" . ($last ? "last" : "mid") . ($with_arg ? "_arg" : "");
+  my $code = "\nstatic void $name(const void *src, void *dst, void *arg,\n";
+  $code .= " " x (length("static void $name(")) . "int outer, int n, int inner)\n{\n";
+  $code .= "     const $type *s = src;\n";
+  $code .= "     $type *d = dst;\n";
+  $code .= $with_arg ? "     $type *a = arg;\n" : "";
+  if ($last) {
+    $code .= "     $type m;\n";
+    $code .= "     int i, k" . ($with_arg ? ", mk" : "") . ";\n\n";
+    $code .= "     for (i = 0; i < outer; i++, s += n) {\n";
+    $code .= "          m = s[0];\n";
+    if ($with_arg) {
+      $code .= "          mk = 0;\n";
+      $code .= "          for (k = 1; k < n; k++) {\n";
+      $code .= "               if (s[k] > m) {\n";
+      $code .= "                    m = s[k];\n";
+      $code .= "                    mk = k;\n";
+      $code .= "               }\n";
+      $code .= "          }\n";
+      $code .= "          d[i] = m;\n";
+      $code .= "          a[i] = mk;\n";
+    } else {
+      $code .= "          for (k = 1; k < n; k++)\n";
+      $code .= "               m = s[k] > m ? s[k] : m;\n";
+      $code .= "          d[i] = m;\n";
+    }
+    $code .= "     }\n";
+  } else {
+    $code .= "     int i, j, k;\n\n";
+    $code .= "     for (i = 0; i < outer; i++, d += inner"
+      . ($with_arg ? ", a += inner" : "") . ") {\n";
+    $code .= "          for (j = 0; j < inner; j++)\n";
+    $code .= "               d[j] = s[j];\n";
+    if ($with_arg) {
+      $code .= "          for (j = 0; j < inner; j++)\n";
+      $code .= "               a[j] = 0;\n";
+    }
+    $code .= "          s += inner;\n";
+    $code .= "          for (k = 1; k < n; k++, s += inner) {\n";
+    $code .= "               for (j = 0; j < inner; j++) {\n";
+    if ($with_arg) {
+      $code .= "                    if (s[j] > d[j]) {\n";
+      $code .= "                         d[j] = s[j];\n";
+      $code .= "                         a[j] = k;\n";
+      $code .= "                    }\n";
+    } else {
+      $code .= "                    d[j] = s[j] > d[j] ? s[j] : d[j];\n";
+    }
+    $code .= "               }\n";
+    $code .= "          }\n";
+    $code .= "     }\n";
+  }
+  $code .= "}\n";
+  return ($name, $code);
+}
+
+my $out = $header;
+my $table = "\nconst ln_kernel_transpose_func ln_kernel_transpose_table["
+  . scalar(@sizes) . "][LN_KERNEL_MAXDIM][2] = {\n";
+for my $i (0 .. $#sizes) {
+  my ($size, $type) = @{$sizes[$i]};
+  my @rows;
+  for my $ndim (1 .. $max_dim) {
+    my ($strided, $code1) = transpose_kernel($type, $size, $ndim, 0);
+    my ($contig, $code2) = transpose_kernel($type, $size, $ndim, 1);
+    $out .= $code1 . $code2;
+    push @rows, "          {$strided, $contig}";
+  }
+  $table .= "     {\n" . join(",\n", @rows) . "\n     }";
+  $table .= $i == $#sizes ? "\n" : ",\n";
+}
+$table .= "};\n";
+$out .= $table;
+
+$table = "\nconst ln_kernel_maxreduce_func ln_kernel_maxreduce_table[TL_DTYPE_SIZE][2][2] = {\n";
+my @entries;
+for my $d (@dtypes) {
+  my ($dtype, $type) = @$d;
+  my $tname = lc substr($dtype, 3);
+  my @names;
+  for my $last (0, 1) {
+    for my $with_arg (0, 1) {
+      my ($name, $code) = maxreduce_kernel($type, $tname, $last, $with_arg);
+      $out .= $code;
+      push @names, $name;
+    }
+  }
+  push @entries, "     [$dtype] = {{$names[0], $names[1]},\n"
+    . " " x length("     [$dtype] = ") . " {$names[2], $names[3]}}";
+}
+$table .= join(",\n", @entries) . "\n};\n";
+$out .= $table;
+
+my $gen_file = "$root/src/ln_kernel_gen.c";
+open GEN, '>', $gen_file
+  or die "Cannot open $gen_file: $!";
+print GEN $out;
+close GEN;
@@ -1,9 +1,244 @@
-#include "ln_error.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ln_parse.h"
+#include "ln_pass.h"
+#include "ln_optimize.h"
+#include "ln_sim.h"
+#include "ln_compile.h"
+#include "ln_jit.h"
+#include "ln_op.h"
+#include "ln_mem.h"
+
+extern ln_op *ln_init_ops[];
+
+static const char *usage =
+     "usage: lightnet [-p PASSES] [-t CACHE] [-S SIM [-a]] [-s]\n"
+     "                [-r RUNS [-g GFLOPS -b GBPS]] NET_JSON\n"
+     "       lightnet compile [-p PASSES] [-t CACHE] [-s] [-n NAME]\n"
+     "                [-i INPUTS] [-O OUTPUTS] -o OUT_C NET_JSON\n"
+     "  -p PASSES  comma separated optimization passes, such as\n"
+     "             \"cse,simplify,transpose,dce,fuse,mem\", overriding the\n"
+     "             \"passes\" item of NET_JSON\n"
+     "  -t CACHE   tuning cache file of the autotune pass\n"
+     "  -S SIM     add a simulated device for the \"mtype\" pass, with SIM as\n"
+     "             GBPS,LATENCY_US[,SPEEDUP]: its link GB/s and microseconds\n"
+     "             per transfer, and how much faster than the host it is\n"
+     "             taken to be\n"
+     "  -a         overlap transfers of the simulated device with its kernels\n"
+     "  -s         print timing and statistics of each pass\n"
+     "  -r RUNS    run the net RUNS times and print the roofline view of ops\n"
+     "  -g GFLOPS  peak GFLOP/s of the machine, for the roofline view and\n"
+     "             the \"mtype\" pass\n"
+     "  -b GBPS    peak memory GB/s of the machine, for the roofline view and\n"
+     "             the \"mtype\" pass\n"
+     "compile writes the optimized net to OUT_C as C code with a function\n"
+     "NAME_run(inputs, outputs), calling TensorLight kernels directly:\n"
+     "  -n NAME    prefix of the run function, \"model\" by default\n"
+     "  -i INPUTS  comma separated static tensors, such as those of \"create\"\n"
+     "             ops, read from inputs[i] instead\n"
+     "  -O OUTPUTS comma separated tensors copied to outputs[i], by default\n"
+     "             the tensors no op reads\n"
+     "  -o OUT_C   the C file to write\n";
+
+static char *read_file(const char *path)
+{
+     struct stat buf;
+     char *str;
+     FILE *fp;
+
+     if (stat(path, &buf) < 0)
+          ln_err_sys("cannot stat %s", path);
+     if (!(fp = fopen(path, "rb")))
+          ln_err_sys("cannot open %s", path);
+     str = ln_alloc(buf.st_size + 1);
+     if (fread(str, buf.st_size, 1, fp) < 1 && ferror(fp))
+          ln_err_sys("error reading %s", path);
+     str[buf.st_size] = '\0';
+     fclose(fp);
+
+     return str;
+}
+
+/* names in a comma separated list, pointing into str */
+static ln_list *split_names(char *str)
+{
+     ln_list *names = NULL;
+     char *name;
+
+     for (name = strtok(str, ","); name; name = strtok(NULL, ","))
+          names = ln_list_append(names, name);
+     return names;
+}
 
 int main(int argc, char **argv)
 {
-     ln_error *error;
+     ln_list *registered_ops, *ops, *pipeline, *stats;
+     ln_pass_arg pass_arg;
+     ln_backend host = {"cpu", LN_MEM_CPU, "", "copy", 0, 0, 0, 0};
+     ln_backend sim;
+     ln_sim_config sim_config;
+     ln_sim_stat sim_stat;
+     ln_error *error = NULL;
+     char *passes = NULL;
+     char *tune_cache = NULL;
+     char *out_path = NULL, *prefix = NULL;
+     ln_list *inputs = NULL, *outputs = NULL;
+     FILE *fp;
+     char *json_str;
+     double peak_gflops = 0, peak_gbps = 0;
+     double sim_latency = 0, sim_speedup = 1;
+     double *times;
+     int print_stats = 0;
+     int use_sim = 0;
+     int sim_async = 0;
+     int n_runs = 0;
+     int compile = 0;
+     int opt;
+
+     if (argc > 1 && !strcmp(argv[1], "compile")) {
+          compile = 1;
+          argc--;
+          argv++;
+     }
+     while ((opt = getopt(argc, argv, "p:t:S:asr:g:b:n:i:O:o:h")) != -1) {
+          switch (opt) {
+          case 'p':
+               passes = optarg;
+               break;
+          case 't':
+               tune_cache = optarg;
+               break;
+          case 'S':
+               memset(&sim_config, 0, sizeof(sim_config));
+               if (sscanf(optarg, "%lf,%lf,%lf", &sim_config.link_gbps,
+                          &sim_latency, &sim_speedup) < 2) {
+                    fprintf(stderr, "%s", usage);
+                    exit(EXIT_FAILURE);
+               }
+               use_sim = 1;
+               break;
+          case 'a':
+               sim_async = 1;
+               break;
+          case 's':
+               print_stats = 1;
+               break;
+          case 'r':
+               n_runs = atoi(optarg);
+               break;
+          case 'g':
+               peak_gflops = atof(optarg);
+               break;
+          case 'b':
+               peak_gbps = atof(optarg);
+               break;
+          case 'n':
+               prefix = optarg;
+               break;
+          case 'i':
+               inputs = split_names(optarg);
+               break;
+          case 'O':
+               outputs = split_names(optarg);
+               break;
+          case 'o':
+               out_path = optarg;
+               break;
+          case 'h':
+               printf("%s", usage);
+               exit(EXIT_SUCCESS);
+          default:
+               fprintf(stderr, "%s", usage);
+               exit(EXIT_FAILURE);
+          }
+     }
+     if (optind != argc - 1 || compile != !!out_path) {
+          fprintf(stderr, "%s", usage);
+          exit(EXIT_FAILURE);
+     }
+
+     if (use_sim) {
+          sim_config.link_latency = sim_latency * 1e-6;
+          sim_config.gflops = peak_gflops * sim_speedup;
+          sim_config.gbps = peak_gbps * sim_speedup;
+          /* the pool of the device maps its memory, so keep it finite */
+          sim_config.mem_size = (size_t)1 << 30;
+          sim_config.async = sim_async;
+          ln_sim_init(&sim_config);
+     }
 
-     error = ln_error_create(LN_INFO, "test error %s", "test_str");
+     json_str = read_file(argv[optind]);
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+     ops = ln_parse_ops(json_str, registered_ops, &error);
      ln_error_handle(&error);
+     if (passes)
+          pipeline = ln_pass_pipeline_create(passes, &error);
+     else
+          pipeline = ln_parse_passes(json_str, &error);
+     ln_error_handle(&error);
+
+     pass_arg.mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL,
+                                         (ln_free_func)ln_mem_pool_free);
+     ln_hash_insert(pass_arg.mem_pools, (void *)LN_MEM_CPU,
+                    ln_mem_pool_create((size_t)-1 >> 1, 64));
+#ifdef LN_CUDA
+     ln_hash_insert(pass_arg.mem_pools, (void *)LN_MEM_CUDA,
+                    ln_mem_pool_create((size_t)-1 >> 1, 64));
+#endif
+     if (use_sim)
+          ln_hash_insert(pass_arg.mem_pools, (void *)LN_MEM_SIM,
+                         ln_sim_mem_pool_create(64));
+     pass_arg.outputs = outputs;
+     pass_arg.tune_cache = tune_cache;
+     host.gflops = peak_gflops;
+     host.gbps = peak_gbps;
+     pass_arg.registered_ops = registered_ops;
+     pass_arg.backends = ln_list_append(NULL, &host);
+     if (use_sim) {
+          ln_sim_backend(&sim);
+          pass_arg.backends = ln_list_append(pass_arg.backends, &sim);
+     }
+     ops = ln_pass_pipeline_run(pipeline, ops, &pass_arg, &stats, &error);
+     ln_error_handle(&error);
+     if (print_stats)
+          ln_pass_stats_print(stats, stdout);
+     if (compile) {
+          if (!(fp = fopen(out_path, "w")))
+               ln_err_sys("cannot open %s", out_path);
+          ln_compile(ops, inputs, outputs, prefix, fp, &error);
+          ln_error_handle(&error);
+          fclose(fp);
+     }
+     if (n_runs > 0) {
+          times = ln_op_list_time(ops, n_runs, &error);
+          ln_error_handle(&error);
+          ln_op_list_print_roofline(ops, times, peak_gflops, peak_gbps,
+                                    stdout);
+          ln_free(times);
+          if (use_sim) {
+               ln_sim_get_stat(&sim_stat);
+               printf("sim: %lu kernels, %lu copies of %lu bytes, %.3f ms in transfers\n",
+                      (unsigned long)sim_stat.n_kernels,
+                      (unsigned long)sim_stat.n_copies,
+                      (unsigned long)sim_stat.bytes_copied,
+                      sim_stat.copy_time * 1e3);
+          }
+     }
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_list_free_deep(stats, ln_free);
+     ln_list_free(pipeline);
+     ln_list_free(registered_ops);
+     ln_hash_free(pass_arg.mem_pools);
+     ln_list_free(pass_arg.backends);
+     ln_list_free(inputs);
+     ln_list_free(outputs);
+     ln_free(json_str);
+     ln_sim_cleanup();
+     ln_jit_cleanup();
+
+     return 0;
 }
@@ -0,0 +1,649 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdarg.h>
+#include "ln_compile.h"
+#include "ln_optimize.h"
+
+#define ARENA_ALIGN 64
+#define BYTES_PER_LINE 12
+
+enum loc_kind {
+     LOC_NONE,                  /* not set at this point */
+     LOC_ARENA,                 /* in the arena, at an offset */
+     LOC_OWN,                   /* in the buffer of a tensor */
+     LOC_INPUT                  /* in a buffer passed to the run function */
+};
+
+/* where the data of a tensor is in the generated code */
+struct loc {
+     enum loc_kind kind;
+     size_t        at;          /* offset, tensor id or input index */
+};
+
+/* a tl_tensor of the generated code */
+struct ctensor {
+     int         id;
+     tl_tensor  *tensor;
+     const char *name;          /* NULL for tensors private to an op */
+     char        ref[32];       /* C expression of its address */
+     struct loc  init;          /* data set by its static initializer */
+     struct loc  cur;           /* data at this point of the run function */
+     int         seen;
+     int         moves;         /* data changes during a run */
+     int         own;           /* has a buffer: 0 no, 1 zeroed, 2 constant */
+     int         used;          /* referenced by the run function */
+     int         buf_used;      /* its buffer is referenced */
+};
+
+struct ln_compile_ctx {
+     ln_hash *ctensors;         /* tl_tensor -> struct ctensor */
+     ln_list *order;            /* struct ctensor, by id */
+     int      n_ctensors;
+     FILE    *body;             /* statements of the run function */
+     int      bol;              /* body is at the beginning of a line */
+};
+
+static struct ctensor *ctensor_get(ln_compile_ctx *ctx, tl_tensor *tensor,
+                                   const char *name)
+{
+     struct ctensor *ct;
+
+     if ((ct = ln_hash_find(ctx->ctensors, tensor)))
+          return ct;
+     ct = ln_alloc(sizeof(struct ctensor));
+     memset(ct, 0, sizeof(struct ctensor));
+     ct->id = ctx->n_ctensors++;
+     ct->tensor = tensor;
+     ct->name = name;
+     snprintf(ct->ref, sizeof(ct->ref), "&t_%d", ct->id);
+     ln_hash_insert(ctx->ctensors, tensor, ct);
+     ctx->order = ln_list_append(ctx->order, ct);
+
+     return ct;
+}
+
+static int loc_eq(const struct loc *a, const struct loc *b)
+{
+     return a->kind == b->kind && a->at == b->at;
+}
+
+static void loc_sprint(ln_compile_ctx *ctx, char *buf, size_t size,
+                       const struct loc *loc)
+{
+     struct ctensor *ct;
+
+     switch (loc->kind) {
+     case LOC_ARENA:
+          snprintf(buf, size, "arena.bytes + %lu", (unsigned long)loc->at);
+          break;
+     case LOC_OWN:
+          ct = ln_list_nth_data(ctx->order, loc->at);
+          ct->buf_used = 1;
+          snprintf(buf, size, "d_%lu.bytes", (unsigned long)loc->at);
+          break;
+     case LOC_INPUT:
+          snprintf(buf, size, "(void *)inputs[%lu]", (unsigned long)loc->at);
+          break;
+     default:
+          snprintf(buf, size, "NULL");
+          break;
+     }
+}
+
+static void record_loc(struct ctensor *ct, const struct loc *loc)
+{
+     /* inputs are only known in the run function */
+     if (loc->kind == LOC_INPUT)
+          ct->moves = 1;
+     if (!ct->seen) {
+          ct->init = *loc;
+          ct->seen = 1;
+     } else if (!loc_eq(&ct->init, loc)) {
+          ct->moves = 1;
+     }
+}
+
+static int name_index(ln_list *names, const char *name)
+{
+     ln_list *l;
+     int i;
+
+     for (l = names, i = 0; l; l = l->next, i++) {
+          if (!strcmp(l->data, name))
+               return i;
+     }
+     return -1;
+}
+
+/* whether op computes some data, not only sets it in pre_run or views it */
+static int computes(ln_op *op)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if (!te->isstatic && !te->owner)
+               return 1;
+     }
+     return 0;
+}
+
+/*
+ * Find where the data of every tensor entry of ops is: planned tensors in
+ * the arena, static, dead and external ones in buffers of their own, inputs
+ * in the buffers passed to the run function, and views where their owners
+ * are. locs maps entries to struct loc.
+ */
+static void locate(ln_compile_ctx *ctx, ln_list *ops, ln_list *inputs,
+                   ln_hash *locs, ln_error **error)
+{
+     ln_hash *defs;             /* tensor name -> loc of its definition */
+     ln_hash *planned;          /* names of tensors planned in the arena */
+     ln_hash *read_inputs;      /* indexes of inputs compiled ops read */
+     ln_tensor_entry *te;
+     struct ctensor *ct;
+     struct loc *loc;
+     ln_list *l;
+     ln_op *op;
+     int i;
+
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     planned = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     read_inputs = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          /* the inputs of ops left out of the run function don't matter */
+          if (op->emit || computes(op)) {
+               LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+                    ct = ctensor_get(ctx, te->tensor, te->name);
+                    loc = ln_alloc(sizeof(struct loc));
+                    ln_hash_insert(locs, te, loc);
+                    if (ln_hash_find_extended(defs, te->name, NULL)) {
+                         *loc = *(struct loc *)ln_hash_find(defs, te->name);
+                    } else {
+                         /* not created by ops, so its data is kept */
+                         ct->own = 2;
+                         loc->kind = LOC_OWN;
+                         loc->at = ct->id;
+                    }
+                    if (loc->kind == LOC_INPUT)
+                         ln_hash_insert(read_inputs, (void *)loc->at, NULL);
+                    record_loc(ct, loc);
+               }
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ct = ctensor_get(ctx, te->tensor, te->name);
+               loc = ln_alloc(sizeof(struct loc));
+               ln_hash_insert(locs, te, loc);
+               if ((i = name_index(inputs, te->name)) >= 0) {
+                    if (!te->isstatic) {
+                         *error = ln_error_create(LN_ERROR,
+                                                  "compile: input \"%s\" should be a static tensor, such as one of a \"create\" op",
+                                                  te->name);
+                         goto end;
+                    }
+                    loc->kind = LOC_INPUT;
+                    loc->at = i;
+               } else if (te->owner ?
+                          ln_hash_find_extended(planned, te->owner, NULL)
+                          : !te->isstatic && !te->isdead) {
+                    loc->kind = LOC_ARENA;
+                    loc->at = te->offset;
+               } else if (te->owner) {
+                    *loc = *(struct loc *)ln_hash_find(defs, te->owner);
+               } else {
+                    ct->own = te->isstatic ? 2 : 1;
+                    loc->kind = LOC_OWN;
+                    loc->at = ct->id;
+               }
+               if (loc->kind == LOC_ARENA)
+                    ln_hash_insert(planned, te->name, NULL);
+               else
+                    ln_hash_remove(planned, te->name);
+               ln_hash_insert(defs, te->name, loc);
+               record_loc(ct, loc);
+          }
+     }
+
+     for (l = inputs, i = 0; l; l = l->next, i++) {
+          if (!ln_hash_find_extended(defs, l->data, NULL)) {
+               *error = ln_error_create(LN_ERROR,
+                                        "compile: no tensor \"%s\" to be an input",
+                                        (char *)l->data);
+               goto end;
+          }
+          /* such as an input that the "fold" pass took as a constant */
+          if (!ln_hash_find_extended(read_inputs, (void *)(size_t)i, NULL)) {
+               *error = ln_error_create(LN_ERROR,
+                                        "compile: input \"%s\" isn't read at run time, was it folded?",
+                                        (char *)l->data);
+               goto end;
+          }
+     }
+
+end:
+     ln_hash_free(read_inputs);
+     ln_hash_free(planned);
+     ln_hash_free(defs);
+}
+
+/* point the tensors of table to where they are at this op */
+static void move_data(ln_compile_ctx *ctx, ln_tensor_table *table,
+                      ln_hash *locs)
+{
+     ln_tensor_entry *te;
+     struct ctensor *ct;
+     struct loc *loc;
+     char buf[64];
+
+     LN_LIST_FOREACH(te, table) {
+          ct = ln_hash_find(ctx->ctensors, te->tensor);
+          loc = ln_hash_find(locs, te);
+          if (loc_eq(&ct->cur, loc))
+               continue;
+          loc_sprint(ctx, buf, sizeof(buf), loc);
+          ln_compile_printf(ctx, "t_%d.data = %s;\n", ct->id, buf);
+          ct->used = 1;
+          ct->cur = *loc;
+     }
+}
+
+static const char *dtype_name(tl_dtype dtype)
+{
+     switch (dtype) {
+     case TL_DOUBLE:
+          return "TL_DOUBLE";
+     case TL_FLOAT:
+          return "TL_FLOAT";
+     case TL_INT32:
+          return "TL_INT32";
+     case TL_INT16:
+          return "TL_INT16";
+     case TL_INT8:
+          return "TL_INT8";
+     case TL_UINT32:
+          return "TL_UINT32";
+     case TL_UINT16:
+          return "TL_UINT16";
+     case TL_UINT8:
+          return "TL_UINT8";
+     case TL_BOOL:
+          return "TL_BOOL";
+     default:
+          return NULL;
+     }
+}
+
+/* name in a C comment */
+static void print_name(FILE *fp, const char *name)
+{
+     for (; *name; name++) {
+          fputc(*name, fp);
+          if (*name == '*' && name[1] == '/')
+               fputc(' ', fp);
+     }
+}
+
+static void print_shape(FILE *fp, tl_tensor *tensor)
+{
+     int i;
+
+     fprintf(fp, "%s [", dtype_name(tensor->dtype));
+     for (i = 0; i < tensor->ndim; i++)
+          fprintf(fp, i ? ", %d" : "%d", tensor->dims[i]);
+     fprintf(fp, "], %lu bytes", (unsigned long)tl_tensor_size(tensor));
+}
+
+static void print_tensor(ln_compile_ctx *ctx, FILE *fp, struct ctensor *ct)
+{
+     tl_tensor *t;
+     unsigned char *bytes;
+     size_t size, i;
+     char buf[64];
+
+     t = ct->tensor;
+     size = tl_tensor_size(t);
+     fprintf(fp, "/* ");
+     if (ct->name) {
+          fprintf(fp, "\"");
+          print_name(fp, ct->name);
+          fprintf(fp, "\"");
+     } else {
+          fprintf(fp, "private");
+     }
+     fprintf(fp, " */\n");
+
+     if (ct->own && ct->buf_used) {
+          fprintf(fp, "static union { unsigned char bytes[%lu]; double align; } d_%d",
+                  (unsigned long)size, ct->id);
+          bytes = t->data;
+          if (ct->own == 2 && bytes) {
+               fprintf(fp, " = {{");
+               for (i = 0; i < size; i++) {
+                    fprintf(fp, "%s0x%02x", i % BYTES_PER_LINE ? ", "
+                            : i ? ",\n     " : "\n     ", bytes[i]);
+               }
+               fprintf(fp, "\n}}");
+          }
+          fprintf(fp, ";\n");
+     }
+
+     if (!ct->used) {
+          fprintf(fp, "\n");
+          return;
+     }
+     fprintf(fp, "static int dims_%d[] = {", ct->id);
+     for (i = 0; i < t->ndim; i++)
+          fprintf(fp, i ? ", %d" : "%d", t->dims[i]);
+     fprintf(fp, "};\n");
+
+     loc_sprint(ctx, buf, sizeof(buf), &ct->init);
+     fprintf(fp, "static tl_tensor t_%d = {\n", ct->id);
+     fprintf(fp, "     .dtype = %s, .len = %d, .ndim = %d, .dims = dims_%d,\n",
+             dtype_name(t->dtype), t->len, t->ndim, ct->id);
+     fprintf(fp, "     .data = %s\n", ct->moves ? "NULL" : buf);
+     fprintf(fp, "};\n\n");
+}
+
+/* the ctensor of name, which locate() has checked to be there */
+static struct ctensor *find_ctensor(ln_compile_ctx *ctx, const char *name)
+{
+     struct ctensor *ct;
+
+     LN_LIST_FOREACH(ct, ctx->order) {
+          if (ct->name && !strcmp(ct->name, name))
+               return ct;
+     }
+     assert(0 && "input not located");
+     return NULL;
+}
+
+static void print_file(ln_compile_ctx *ctx, ln_list *inputs,
+                       ln_list *output_tes, const char *prefix,
+                       size_t arena_size, FILE *fp)
+{
+     ln_tensor_entry *te;
+     struct ctensor *ct;
+     ln_list *l;
+     char *name;
+     char buf[BUFSIZ];
+     size_t n;
+     int i;
+
+     fprintf(fp, "/*\n * Generated by lightnet compile.\n *\n");
+     fprintf(fp, " * void %s_run(const void *const *inputs, void *const *outputs);\n",
+             prefix);
+     fprintf(fp, " *\n * inputs:\n");
+     for (l = inputs, i = 0; l; l = l->next, i++) {
+          name = l->data;
+          ct = find_ctensor(ctx, name);
+          fprintf(fp, " *   %d: \"", i);
+          print_name(fp, name);
+          fprintf(fp, "\", ");
+          print_shape(fp, ct->tensor);
+          fprintf(fp, "\n");
+     }
+     fprintf(fp, " * outputs:\n");
+     for (l = output_tes, i = 0; l; l = l->next, i++) {
+          te = l->data;
+          fprintf(fp, " *   %d: \"", i);
+          print_name(fp, te->name);
+          fprintf(fp, "\", ");
+          print_shape(fp, te->tensor);
+          fprintf(fp, "\n");
+     }
+     fprintf(fp, " *\n * Link with TensorLight.\n */\n\n");
+     fprintf(fp, "#include <string.h>\n#include <math.h>\n#include \"tl_tensor.h\"\n\n");
+
+     if (arena_size > 0)
+          fprintf(fp, "static union { unsigned char bytes[%lu]; double align; } arena;\n\n",
+                  (unsigned long)arena_size);
+     /* mark the buffers static initializers point to */
+     LN_LIST_FOREACH(ct, ctx->order) {
+          if (ct->used && !ct->moves)
+               loc_sprint(ctx, buf, sizeof(buf), &ct->init);
+     }
+     LN_LIST_FOREACH(ct, ctx->order) {
+          if (ct->used || ct->buf_used)
+               print_tensor(ctx, fp, ct);
+     }
+
+     fprintf(fp, "void %s_run(const void *const *inputs, void *const *outputs)\n{\n",
+             prefix);
+     if (!inputs)
+          fprintf(fp, "     (void)inputs;\n");
+     if (!output_tes)
+          fprintf(fp, "     (void)outputs;\n");
+     rewind(ctx->body);
+     while ((n = fread(buf, 1, sizeof(buf), ctx->body)) > 0)
+          fwrite(buf, 1, n, fp);
+     fprintf(fp, "}\n");
+}
+
+/* the last definitions of the outputs, or of tensors no one reads */
+static ln_list *find_outputs(ln_list *ops, ln_list *outputs,
+                             ln_error **error)
+{
+     ln_hash *defs, *unread;
+     ln_list *tes, *output_tes;
+     ln_tensor_entry *te;
+     ln_op *op;
+     ln_list *l;
+
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     unread = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     tes = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_remove(unread, te->name);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(defs, te->name, te);
+               if (te->isdead)
+                    continue;
+               ln_hash_insert(unread, te->name, te);
+               tes = ln_list_append(tes, te);
+          }
+     }
+
+     output_tes = NULL;
+     if (outputs) {
+          for (l = outputs; l; l = l->next) {
+               if (!(te = ln_hash_find(defs, l->data))) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "compile: no tensor \"%s\" to be an output",
+                                             (char *)l->data);
+                    ln_list_free(output_tes);
+                    output_tes = NULL;
+                    break;
+               }
+               output_tes = ln_list_append(output_tes, te);
+          }
+     } else {
+          LN_LIST_FOREACH(te, tes) {
+               if (ln_hash_find(unread, te->name) == te)
+                    output_tes = ln_list_append(output_tes, te);
+          }
+     }
+
+     ln_list_free(tes);
+     ln_hash_free(unread);
+     ln_hash_free(defs);
+     return output_tes;
+}
+
+/*
+ * Write ops as a C translation unit to fp, with a straight-line function
+ * "<prefix>_run(inputs, outputs)" calling the kernels of ops directly.
+ * ops should have been through pre_run, and every op computing something
+ * at run time needs an emit function. Tensors are planned again here,
+ * into a static arena, so the pipeline needn't have planned memory; static
+ * tensors become static arrays of their data.
+ *
+ * inputs names static tensors, such as those of "create" ops, whose data
+ * is instead read from inputs[i] of the run function, without a copy.
+ * outputs names tensors copied to outputs[i] at the end of a run; if it is
+ * NULL, the tensors no op reads are the outputs, in the order of ops.
+ * Nothing is written if there is an error.
+ */
+void ln_compile(ln_list *ops, ln_list *inputs, ln_list *outputs,
+                const char *prefix, FILE *fp, ln_error **error)
+{
+     ln_compile_ctx ctx;
+     ln_hash *locs, *mem_pools;
+     ln_list *output_tes, *l;
+     ln_tensor_entry *te;
+     struct ctensor *ct;
+     ln_mem_pool *mp;
+     ln_op *op;
+     char buf[64];
+     size_t arena_size;
+     int i;
+
+     if (!prefix)
+          prefix = "model";
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->mtype != LN_MEM_UNDEFINED && te->mtype != LN_MEM_CPU) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "compile: tensor \"%s\" isn't in host memory",
+                                             te->name);
+                    return;
+               }
+               if (!dtype_name(te->tensor->dtype)) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "compile: tensor \"%s\" has an unknown dtype",
+                                             te->name);
+                    return;
+               }
+          }
+     }
+     output_tes = find_outputs(ops, outputs, error);
+     if (*error)
+          return;
+
+     mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL,
+                                (ln_free_func)ln_mem_pool_free);
+     mp = ln_mem_pool_create((size_t)-1 >> 1, ARENA_ALIGN);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_CPU, mp);
+     ops = ln_optimize_mem(ops, mem_pools);
+     arena_size = mp->peak;
+     ln_hash_free(mem_pools);
+
+     ctx.ctensors = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     ctx.order = NULL;
+     ctx.n_ctensors = 0;
+     ctx.body = NULL;
+     ctx.bol = 1;
+     locs = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, ln_free);
+     locate(&ctx, ops, inputs, locs, error);
+     if (*error)
+          goto end;
+     LN_LIST_FOREACH(ct, ctx.order) {
+          if (ct->moves)
+               ct->cur.kind = LOC_NONE;
+          else
+               ct->cur = ct->init;
+     }
+
+     if (!(ctx.body = tmpfile())) {
+          *error = ln_error_create(LN_ERROR_SYS,
+                                   "compile: cannot create a temporary file");
+          goto end;
+     }
+     LN_LIST_FOREACH(op, ops) {
+          if (!op->emit) {
+               if (!computes(op))
+                    continue;
+               *error = ln_error_create(LN_ERROR,
+                                        "compile: \"%s\" of optype \"%s\" can't be compiled",
+                                        op->op_arg->name, op->op_arg->optype);
+               goto end;
+          }
+          move_data(&ctx, op->op_arg->tensors_in, locs);
+          move_data(&ctx, op->op_arg->tensors_out, locs);
+          op->emit(op->op_arg, &ctx);
+     }
+     for (l = output_tes, i = 0; l; l = l->next, i++) {
+          te = l->data;
+          loc_sprint(&ctx, buf, sizeof(buf), ln_hash_find(locs, te));
+          ln_compile_printf(&ctx, "memcpy(outputs[%d], %s, %lu);\n", i, buf,
+                            (unsigned long)tl_tensor_size(te->tensor));
+     }
+
+     print_file(&ctx, inputs, output_tes, prefix, arena_size, fp);
+
+end:
+     if (ctx.body)
+          fclose(ctx.body);
+     ln_hash_free(locs);
+     ln_list_free_deep(ctx.order, ln_free);
+     ln_hash_free(ctx.ctensors);
+     ln_list_free(output_tes);
+}
+
+/*
+ * The C expression of the address of tensor in the generated code, for
+ * emit functions. A tensor that isn't an entry of the ops, such as a
+ * workspace, gets a zeroed buffer of its own.
+ */
+const char *ln_compile_tensor(ln_compile_ctx *ctx, tl_tensor *tensor)
+{
+     struct ctensor *ct;
+
+     ct = ctensor_get(ctx, tensor, NULL);
+     ct->used = 1;
+     if (!ct->seen) {
+          ct->own = 1;
+          ct->init.kind = LOC_OWN;
+          ct->init.at = ct->id;
+          ct->cur = ct->init;
+          ct->seen = 1;
+     }
+
+     return ct->ref;
+}
+
+/* write statements of the run function, indented */
+void ln_compile_printf(ln_compile_ctx *ctx, const char *fmt, ...)
+{
+     va_list ap;
+     char *str, *p;
+     int n;
+
+     va_start(ap, fmt);
+     n = vsnprintf(NULL, 0, fmt, ap);
+     va_end(ap);
+     str = ln_alloc(n + 1);
+     va_start(ap, fmt);
+     vsnprintf(str, n + 1, fmt, ap);
+     va_end(ap);
+
+     for (p = str; *p; p++) {
+          if (ctx->bol && *p != '\n')
+               fputs("     ", ctx->body);
+          fputc(*p, ctx->body);
+          ctx->bol = *p == '\n';
+     }
+     ln_free(str);
+}
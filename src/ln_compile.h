@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_COMPILE_H_
+#define _LN_COMPILE_H_
+
+#include <stdio.h>
+#include "ln_list.h"
+#include "ln_error.h"
+#include "ln_op.h"
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+void ln_compile(ln_list *ops, ln_list *inputs, ln_list *outputs,
+                const char *prefix, FILE *fp, ln_error **error);
+const char *ln_compile_tensor(ln_compile_ctx *ctx, tl_tensor *tensor);
+void ln_compile_printf(ln_compile_ctx *ctx, const char *fmt, ...);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_COMPILE_H_ */
@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ln_io.h"
+#include "ln_optimize.h"
+
+struct io_tensor {
+     char      *name;
+     tl_tensor *tensor;
+     ln_list   *views;          /* tensors sharing its data */
+     void      *data;           /* the bound buffer, or NULL */
+     int        direct;         /* written by its op straight into data */
+     int        wanted;         /* an output requested by this run */
+     ln_op     *producer;       /* the op of its latest definition */
+     ln_io_ready_func ready;    /* called when it's computed, or NULL */
+     void      *ready_data;
+};
+
+struct ln_io {
+     ln_list *ops;
+     ln_list *inputs;           /* struct io_tensor */
+     ln_list *outputs;          /* struct io_tensor */
+     ln_hash *subsets;          /* requested names -> list of ops to run */
+};
+
+static struct io_tensor *io_tensor_create(ln_tensor_entry *te, ln_hash *views)
+{
+     struct io_tensor *t;
+     tl_tensor *view;
+
+     t = ln_alloc(sizeof(struct io_tensor));
+     t->name = ln_strdup(te->name);
+     t->tensor = te->tensor;
+     t->views = NULL;
+     LN_LIST_FOREACH(view, (ln_list *)ln_hash_find(views, te->name)) {
+          t->views = ln_list_append(t->views, view);
+     }
+     t->data = NULL;
+     t->direct = 0;
+     t->wanted = 0;
+     t->producer = NULL;
+     t->ready = NULL;
+     t->ready_data = NULL;
+     return t;
+}
+
+static void io_tensor_free(void *p)
+{
+     struct io_tensor *t = p;
+
+     ln_list_free(t->views);
+     ln_free(t->name);
+     ln_free(t);
+}
+
+static struct io_tensor *find(ln_list *list, const char *name)
+{
+     struct io_tensor *t;
+
+     LN_LIST_FOREACH(t, list) {
+          if (!strcmp(t->name, name))
+               return t;
+     }
+     return NULL;
+}
+
+static const char *root_name(ln_hash *roots, const char *name)
+{
+     const char *root;
+
+     root = ln_hash_find(roots, (void *)name);
+     return root ? root : name;
+}
+
+static int is_host(ln_tensor_entry *te)
+{
+     return te->mtype == LN_MEM_UNDEFINED || te->mtype == LN_MEM_CPU;
+}
+
+/*
+ * An input should be read at run time only, by ops that aren't folded, or
+ * its data would be baked into constants already.
+ */
+static void check_input_readers(ln_list *ops, const char *name,
+                                ln_error **error)
+{
+     ln_tensor_entry *te;
+     ln_op *op;
+     int n_readers = 0;
+
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (strcmp(te->name, name))
+                    continue;
+               if (ln_optimize_is_folded(op))
+                    n_readers = -1;
+               else if (n_readers >= 0)
+                    n_readers++;
+          }
+          if (n_readers < 0)
+               break;
+     }
+     if (n_readers <= 0)
+          *error = ln_error_create(LN_ERROR,
+                                   "io: input \"%s\" isn't read at run time, was it folded?",
+                                   name);
+}
+
+/*
+ * Declare inputs and outputs of ops, which are lists of tensor names.
+ * ops should be pre_run, and run with ln_io_run() until they are post_run.
+ */
+ln_io *ln_io_create(ln_list *ops, ln_list *inputs, ln_list *outputs,
+                    ln_error **error)
+{
+     ln_hash *defs;             /* name -> its latest definition */
+     ln_hash *producers;        /* name -> op of its latest definition */
+     ln_hash *roots;            /* view name -> name of the data owner */
+     ln_hash *views;            /* owner name -> list of its view tensors */
+     ln_tensor_entry *te;
+     struct io_tensor *t;
+     ln_list *l, *list;
+     ln_op *op;
+     ln_io *io;
+
+     io = ln_alloc(sizeof(ln_io));
+     io->ops = ops;
+     io->inputs = NULL;
+     io->outputs = NULL;
+     io->subsets = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free,
+                                  (ln_free_func)ln_list_free);
+
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     roots = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     views = ln_hash_create(ln_str_hash, ln_str_cmp, NULL,
+                            (ln_free_func)ln_list_free);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(defs, te->name, te);
+               ln_hash_insert(producers, te->name, op);
+               if (!te->owner)
+                    continue;
+               ln_hash_insert(roots, te->name,
+                              (void *)root_name(roots, te->owner));
+               list = ln_hash_find(views, (void *)root_name(roots, te->name));
+               list = ln_list_append(list, te->tensor);
+               ln_hash_insert(views, (void *)root_name(roots, te->name), list);
+          }
+     }
+
+     for (l = inputs; l; l = l->next) {
+          if (!(te = ln_hash_find(defs, l->data))) {
+               *error = ln_error_create(LN_ERROR,
+                                        "io: no tensor \"%s\" to be an input",
+                                        (char *)l->data);
+               goto end;
+          }
+          if (!te->isstatic || te->owner || !is_host(te)) {
+               *error = ln_error_create(LN_ERROR,
+                                        "io: input \"%s\" should be a static tensor in host memory, such as one of a \"create\" op",
+                                        te->name);
+               goto end;
+          }
+          check_input_readers(ops, te->name, error);
+          if (*error)
+               goto end;
+          io->inputs = ln_list_append(io->inputs, io_tensor_create(te, views));
+     }
+
+     for (l = outputs; l; l = l->next) {
+          if (!(te = ln_hash_find(defs, l->data))) {
+               *error = ln_error_create(LN_ERROR,
+                                        "io: no tensor \"%s\" to be an output",
+                                        (char *)l->data);
+               goto end;
+          }
+          if (te->isdead || !is_host(te)) {
+               *error = ln_error_create(LN_ERROR,
+                                        "io: output \"%s\" should be computed in host memory, was it left out of the outputs of the passes?",
+                                        te->name);
+               goto end;
+          }
+          t = io_tensor_create(te, views);
+          /* views and constants are copied out when computed instead */
+          t->direct = !te->owner && !te->isstatic;
+          t->producer = ln_hash_find(producers, te->name);
+          io->outputs = ln_list_append(io->outputs, t);
+     }
+
+end:
+     ln_hash_free(views);
+     ln_hash_free(roots);
+     ln_hash_free(producers);
+     ln_hash_free(defs);
+     if (*error) {
+          ln_io_free(io);
+          return NULL;
+     }
+     return io;
+}
+
+void ln_io_free(ln_io *io)
+{
+     ln_hash_free(io->subsets);
+     ln_list_free_deep(io->inputs, io_tensor_free);
+     ln_list_free_deep(io->outputs, io_tensor_free);
+     ln_free(io);
+}
+
+tl_tensor *ln_io_find_input(ln_io *io, const char *name)
+{
+     struct io_tensor *t;
+
+     t = find(io->inputs, name);
+     return t ? t->tensor : NULL;
+}
+
+tl_tensor *ln_io_find_output(ln_io *io, const char *name)
+{
+     struct io_tensor *t;
+
+     t = find(io->outputs, name);
+     return t ? t->tensor : NULL;
+}
+
+static void bind(struct io_tensor *t, const char *kind, void *data,
+                 size_t size, ln_error **error)
+{
+     if (data && size != tl_tensor_size(t->tensor)) {
+          *error = ln_error_create(LN_ERROR,
+                                   "io: %s \"%s\" needs a buffer of %lu bytes, not %lu",
+                                   kind, t->name,
+                                   (unsigned long)tl_tensor_size(t->tensor),
+                                   (unsigned long)size);
+          return;
+     }
+     if ((size_t)data % tl_size_of(t->tensor->dtype)) {
+          *error = ln_error_create(LN_ERROR,
+                                   "io: buffer of %s \"%s\" isn't aligned to its %lu-byte elements",
+                                   kind, t->name,
+                                   (unsigned long)tl_size_of(t->tensor->dtype));
+          return;
+     }
+     t->data = data;
+}
+
+/*
+ * Bind data of size bytes to an input, which ops read in place of the
+ * tensor's own data. It isn't copied, so it should stay valid and unchanged
+ * while running. A NULL data unbinds the input, leaving its own data.
+ */
+void ln_io_bind_input(ln_io *io, const char *name, const void *data,
+                      size_t size, ln_error **error)
+{
+     struct io_tensor *t;
+
+     if (!(t = find(io->inputs, name))) {
+          *error = ln_error_create(LN_ERROR, "io: no input \"%s\"", name);
+          return;
+     }
+     bind(t, "input", (void *)data, size, error);
+}
+
+/*
+ * Bind data of size bytes to an output, which gets its value every run.
+ * A NULL data unbinds the output.
+ */
+void ln_io_bind_output(ln_io *io, const char *name, void *data, size_t size,
+                       ln_error **error)
+{
+     struct io_tensor *t;
+
+     if (!(t = find(io->outputs, name))) {
+          *error = ln_error_create(LN_ERROR, "io: no output \"%s\"", name);
+          return;
+     }
+     bind(t, "output", data, size, error);
+}
+
+/* whether the op of an output writes it into the bound buffer directly */
+int ln_io_output_is_direct(ln_io *io, const char *name)
+{
+     struct io_tensor *t;
+
+     t = find(io->outputs, name);
+     return t && t->direct;
+}
+
+/*
+ * Have func called with the data of output name and user_data as soon as
+ * the op computing it is run, while the rest of the ops are still to run.
+ * The data isn't written again until the next run, so func can hand it
+ * over to work overlapping the rest of the run. A NULL func removes it.
+ */
+void ln_io_set_ready_func(ln_io *io, const char *name, ln_io_ready_func func,
+                          void *user_data, ln_error **error)
+{
+     struct io_tensor *t;
+
+     if (!(t = find(io->outputs, name))) {
+          *error = ln_error_create(LN_ERROR, "io: no output \"%s\"", name);
+          return;
+     }
+     t->ready = func;
+     t->ready_data = user_data;
+}
+
+static void point_data(tl_tensor *tensor, void *data, ln_hash *saved_data)
+{
+     if (!ln_hash_find_extended(saved_data, tensor, NULL))
+          ln_hash_insert(saved_data, tensor, tensor->data);
+     tensor->data = data;
+}
+
+/* point t and its views to the bound buffer */
+static void bind_data(struct io_tensor *t, ln_hash *saved_data)
+{
+     tl_tensor *view;
+
+     point_data(t->tensor, t->data, saved_data);
+     LN_LIST_FOREACH(view, t->views) {
+          point_data(view, t->data, saved_data);
+     }
+}
+
+static void restore_data(tl_tensor *tensor, ln_hash *saved_data)
+{
+     void *data;
+
+     if (!ln_hash_find_extended(saved_data, tensor, &data))
+          return;
+     tensor->data = data;
+     ln_hash_remove(saved_data, tensor);
+}
+
+static void unbind_data(struct io_tensor *t, ln_hash *saved_data)
+{
+     tl_tensor *view;
+
+     restore_data(t->tensor, saved_data);
+     LN_LIST_FOREACH(view, t->views) {
+          restore_data(view, saved_data);
+     }
+}
+
+static void output_ready(struct io_tensor *t)
+{
+     if (t->data && !t->direct && t->data != t->tensor->data)
+          memcpy(t->data, t->tensor->data, tl_tensor_size(t->tensor));
+     if (t->ready)
+          t->ready(t->name, t->tensor, t->data ? t->data : t->tensor->data,
+                   t->ready_data);
+}
+
+static void run_ops(ln_io *io, ln_list *ops, ln_error **error)
+{
+     ln_hash *saved_data;
+     struct io_tensor *t;
+     ln_op *op;
+
+     /* such as a placeholder, a "create" op without data */
+     LN_LIST_FOREACH(t, io->inputs) {
+          if (!t->data && !t->tensor->data) {
+               *error = ln_error_create(LN_ERROR,
+                                        "io: input \"%s\" has no data, bind a buffer to it",
+                                        t->name);
+               return;
+          }
+     }
+
+     saved_data = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     LN_LIST_FOREACH(t, io->inputs) {
+          if (t->data)
+               bind_data(t, saved_data);
+     }
+     LN_LIST_FOREACH(t, io->outputs) {
+          if (t->wanted && t->data && t->direct)
+               bind_data(t, saved_data);
+     }
+
+     LN_LIST_FOREACH(op, ops) {
+          op->run(op->op_arg, error);
+          if (*error)
+               break;
+          /* before unbinding, as a copied view may share a bound buffer */
+          LN_LIST_FOREACH(t, io->outputs) {
+               if (t->wanted && t->producer == op)
+                    output_ready(t);
+          }
+     }
+
+     LN_LIST_FOREACH(t, io->inputs) {
+          unbind_data(t, saved_data);
+     }
+     LN_LIST_FOREACH(t, io->outputs) {
+          unbind_data(t, saved_data);
+     }
+     ln_hash_free(saved_data);
+}
+
+/*
+ * Run ops in order, reading the bound inputs and writing the bound
+ * outputs, each as soon as its op is run. The tensors point to the bound buffers only while
+ * running, so that post_run still frees their own data.
+ */
+void ln_io_run(ln_io *io, ln_error **error)
+{
+     struct io_tensor *t;
+
+     LN_LIST_FOREACH(t, io->outputs) {
+          t->wanted = 1;
+     }
+     run_ops(io, io->ops, error);
+}
+
+/*
+ * The ops that the tensors in names depend on, in the order of ops: those
+ * creating them, those creating the tensors such an op reads, and so on.
+ */
+static ln_list *ancestor_ops(ln_list *ops, ln_list *names)
+{
+     ln_hash *needed;           /* names of tensors needed */
+     ln_list *subset, *reversed;
+     ln_tensor_entry *te;
+     char *name;
+     ln_op *op;
+     int is_needed;
+
+     needed = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(name, names) {
+          ln_hash_insert(needed, name, NULL);
+     }
+     reversed = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          reversed = ln_list_prepend(reversed, op);
+     }
+     subset = NULL;
+     LN_LIST_FOREACH(op, reversed) {
+          is_needed = 0;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (ln_hash_find_extended(needed, te->name, NULL))
+                    is_needed = 1;
+          }
+          if (!is_needed)
+               continue;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(needed, te->name, NULL);
+          }
+          subset = ln_list_prepend(subset, op);
+     }
+     ln_list_free(reversed);
+     ln_hash_free(needed);
+
+     return subset;
+}
+
+/*
+ * Run only the ops the outputs in names depend on, writing those outputs
+ * only. The ops for the same set of names, in any order and with any
+ * repeats, are found once and remembered.
+ */
+void ln_io_run_outputs(ln_io *io, ln_list *names, ln_error **error)
+{
+     struct io_tensor *t;
+     ln_list *subset;
+     size_t size;
+     char *key, *name;
+     FILE *fp;
+
+     LN_LIST_FOREACH(t, io->outputs) {
+          t->wanted = 0;
+     }
+     LN_LIST_FOREACH(name, names) {
+          if (!(t = find(io->outputs, name))) {
+               *error = ln_error_create(LN_ERROR, "io: no output \"%s\"",
+                                        name);
+               return;
+          }
+          t->wanted = 1;
+     }
+
+     /* the wanted outputs in their declared order, each once */
+     fp = open_memstream(&key, &size);
+     LN_LIST_FOREACH(t, io->outputs) {
+          if (t->wanted)
+               fprintf(fp, "%s,", t->name);
+     }
+     fclose(fp);
+
+     if (!ln_hash_find_extended(io->subsets, key, (void **)&subset)) {
+          subset = ancestor_ops(io->ops, names);
+          ln_hash_insert(io->subsets, key, subset);
+     } else {
+          ln_free(key);
+     }
+     run_ops(io, subset, error);
+}
+
+/* the number of distinct sets of outputs whose ops are remembered */
+int ln_io_n_subsets(ln_io *io)
+{
+     return ln_hash_size(io->subsets);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_IO_H_
+#define _LN_IO_H_
+
+#include <stddef.h>
+#include "ln_list.h"
+#include "ln_error.h"
+#include "ln_op.h"
+
+/*
+ * Named graph inputs and outputs of prepared ops, bound to buffers of the
+ * caller. Inputs are static tensors, such as those of "create" ops, whose
+ * data is replaced by the bound buffers without a copy; outputs are
+ * written by their ops straight into the bound buffers when they can be.
+ */
+typedef struct ln_io ln_io;
+
+typedef void (*ln_io_ready_func) (const char *name, const tl_tensor *tensor,
+                                  void *data, void *user_data);
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_io *ln_io_create(ln_list *ops, ln_list *inputs, ln_list *outputs,
+                    ln_error **error);
+void ln_io_free(ln_io *io);
+tl_tensor *ln_io_find_input(ln_io *io, const char *name);
+tl_tensor *ln_io_find_output(ln_io *io, const char *name);
+void ln_io_bind_input(ln_io *io, const char *name, const void *data,
+                      size_t size, ln_error **error);
+void ln_io_bind_output(ln_io *io, const char *name, void *data, size_t size,
+                       ln_error **error);
+int ln_io_output_is_direct(ln_io *io, const char *name);
+void ln_io_set_ready_func(ln_io *io, const char *name, ln_io_ready_func func,
+                          void *user_data, ln_error **error);
+void ln_io_run(ln_io *io, ln_error **error);
+void ln_io_run_outputs(ln_io *io, ln_list *names, ln_error **error);
+int ln_io_n_subsets(ln_io *io);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_IO_H_ */
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ln_jit.h"
+#include "ln_hash.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <sys/mman.h>
+#define JIT_X86_64
+#endif
+
+#define N_VREGS 16
+
+/* general purpose registers in ModRM and SIB */
+enum gpr {
+     RAX = 0,
+     RCX = 1,
+     RDX = 2,
+     RSI = 6,
+     RDI = 7
+};
+
+struct jit_code {
+     void   *mem;               /* NULL if prog couldn't be compiled */
+     size_t  size;
+};
+
+struct code_buf {
+     unsigned char *bytes;
+     size_t         len;
+     size_t         cap;
+};
+
+static struct {
+     pthread_mutex_t  mutex;
+     ln_hash         *cache;    /* signature -> struct jit_code */
+     FILE            *perf_map;
+     int              disabled;
+} jit = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0};
+
+/*
+ * Whether ln_jit_compile() can make code: on x86-64 with AVX, and unless
+ * turned off by ln_jit_set_enabled().
+ */
+int ln_jit_is_available(void)
+{
+#ifdef JIT_X86_64
+     return !jit.disabled && __builtin_cpu_supports("avx");
+#else
+     return 0;
+#endif
+}
+
+void ln_jit_set_enabled(int enabled)
+{
+     jit.disabled = !enabled;
+}
+
+static const float *operand(const ln_jit_prog *prog, const float *const *srcs,
+                            float *work, int x, size_t i)
+{
+     if (x < prog->n_in)
+          return srcs[x] + i;
+     return work + (size_t)(x - prog->n_in) * LN_JIT_BLOCK;
+}
+
+#define APPLY(expr)                             \
+     do {                                       \
+          for (j = 0; j < n; j++)               \
+               v[j] = (expr);                   \
+     } while (0)
+
+/*
+ * Compute elements [start, end) of dst by prog, a block of LN_JIT_BLOCK
+ * elements after another, keeping node values in work, which holds
+ * prog->n_nodes blocks. dst may be a source.
+ */
+void ln_jit_interpret(const ln_jit_prog *prog, const float *const *srcs,
+                      float *dst, size_t start, size_t end, float *work)
+{
+     const float *a, *b;
+     size_t i, j, n;
+     float *v;
+     int k;
+
+     for (i = start; i < end; i += n) {
+          n = end - i < LN_JIT_BLOCK ? end - i : LN_JIT_BLOCK;
+          for (k = 0; k < prog->n_nodes; k++) {
+               a = operand(prog, srcs, work, prog->nodes[k].a, i);
+               b = operand(prog, srcs, work, prog->nodes[k].b, i);
+               if (k == prog->n_nodes - 1)
+                    v = dst + i;
+               else
+                    v = work + (size_t)k * LN_JIT_BLOCK;
+               switch (prog->nodes[k].op) {
+               case TL_MUL:
+                    APPLY(a[j] * b[j]);
+                    break;
+               case TL_DIV:
+                    APPLY(a[j] / b[j]);
+                    break;
+               case TL_SUM:
+                    APPLY(a[j] + b[j]);
+                    break;
+               case TL_SUB:
+                    APPLY(a[j] - b[j]);
+                    break;
+               case TL_MAX:
+                    APPLY(a[j] > b[j] ? a[j] : b[j]);
+                    break;
+               case TL_MIN:
+                    APPLY(a[j] < b[j] ? a[j] : b[j]);
+                    break;
+               case TL_POW:
+                    APPLY(powf(a[j], b[j]));
+                    break;
+               default:
+                    assert(0 && "unsupported tl_elew_op");
+               }
+          }
+     }
+}
+
+/*
+ * Run prog over len elements: the compiled func, if any, on the longest
+ * prefix of whole vectors, and the interpreter on the rest.
+ */
+void ln_jit_run(const ln_jit_prog *prog, ln_jit_func func,
+                const float *const *srcs, float *dst, size_t len,
+                float *work)
+{
+     size_t n = 0;
+
+     if (func) {
+          n = len / LN_JIT_WIDTH * LN_JIT_WIDTH;
+          if (n > 0)
+               func(srcs, dst, n);
+     }
+     ln_jit_interpret(prog, srcs, dst, n, len, work);
+}
+
+#ifdef JIT_X86_64
+
+static void put(struct code_buf *c, const unsigned char *bytes, size_t n)
+{
+     unsigned char *p;
+
+     if (c->len + n > c->cap) {
+          c->cap = (c->len + n) * 2;
+          p = ln_alloc(c->cap);
+          if (c->bytes)
+               memcpy(p, c->bytes, c->len);
+          ln_free(c->bytes);
+          c->bytes = p;
+     }
+     memcpy(c->bytes + c->len, bytes, n);
+     c->len += n;
+}
+
+static void put_rel32(struct code_buf *c, size_t at, size_t target)
+{
+     int32_t rel;
+
+     rel = (int32_t)((long)target - (long)(at + 4));
+     memcpy(c->bytes + at, &rel, 4);
+}
+
+/*
+ * A VEX.256.0F instruction on ymm registers: reg is ModRM.reg, vvvv the
+ * first source, and the other operand is ymm rm if base < 0, otherwise
+ * memory at [base + rcx].
+ */
+static void emit_vex(struct code_buf *c, unsigned char opcode, int reg,
+                     int vvvv, int rm, int base)
+{
+     unsigned char b[6];
+     int ext_b;
+
+     ext_b = base < 0 ? rm >> 3 : 0;
+     b[0] = 0xc4;
+     b[1] = !(reg >> 3) << 7 | 1 << 6 | !ext_b << 5 | 0x01;
+     b[2] = (~vvvv & 15) << 3 | 1 << 2;
+     b[3] = opcode;
+     if (base < 0) {
+          b[4] = 0xc0 | (reg & 7) << 3 | (rm & 7);
+          put(c, b, 5);
+     } else {
+          b[4] = 0x04 | (reg & 7) << 3;
+          b[5] = RCX << 3 | base;
+          put(c, b, 6);
+     }
+}
+
+/* mov rax, [rdi + 8 * i]: the pointer of source i */
+static void emit_load_src_ptr(struct code_buf *c, int i)
+{
+     unsigned char b[3] = {0x48, 0x8b, 0x87};
+     int32_t disp;
+
+     disp = 8 * i;
+     put(c, b, 3);
+     put(c, (unsigned char *)&disp, 4);
+}
+
+static int vex_opcode(tl_elew_op op)
+{
+     switch (op) {
+     case TL_MUL:
+          return 0x59;
+     case TL_DIV:
+          return 0x5e;
+     case TL_SUM:
+          return 0x58;
+     case TL_SUB:
+          return 0x5c;
+     case TL_MAX:
+          return 0x5f;
+     case TL_MIN:
+          return 0x5d;
+     default:
+          return -1;             /* such as TL_POW, left to the interpreter */
+     }
+}
+
+static int alloc_vreg(int *used)
+{
+     int r;
+
+     for (r = 0; r < N_VREGS; r++) {
+          if (!used[r]) {
+               used[r] = 1;
+               return r;
+          }
+     }
+     return -1;
+}
+
+/*
+ * Generate the loop of a ln_jit_func:
+ *
+ *      xor ecx, ecx            ; byte offset
+ *      shl rdx, 2              ; length in bytes
+ *      test rdx, rdx
+ *      jz end
+ * loop:
+ *      ...                     ; nodes in ymm registers, sources loaded
+ *                              ; at their first use
+ *      vmovups [rsi + rcx], ymm(result)
+ *      add rcx, 32
+ *      cmp rcx, rdx
+ *      jb loop
+ * end:
+ *      vzeroupper
+ *      ret
+ *
+ * Values are in registers until their last use, so nothing but the result
+ * is stored. Returns 0 if prog needs more than 16 registers or has an
+ * operation without a vector instruction.
+ */
+static int generate(const ln_jit_prog *prog, struct code_buf *c)
+{
+     static const unsigned char prologue[] = {
+          0x31, 0xc9, 0x48, 0xc1, 0xe2, 0x02, 0x48, 0x85, 0xd2,
+          0x0f, 0x84, 0, 0, 0, 0
+     };
+     static const unsigned char step[] = {
+          0x48, 0x83, 0xc1, 0x20, 0x48, 0x39, 0xd1, 0x0f, 0x82, 0, 0, 0, 0
+     };
+     static const unsigned char epilogue[] = {0xc5, 0xf8, 0x77, 0xc3};
+     int *last_use, *reg;
+     int used[N_VREGS];
+     int n_vals, opcode, x, k, r, ret;
+     const ln_jit_node *node;
+     size_t loop;
+
+     n_vals = prog->n_in + prog->n_nodes;
+     last_use = ln_alloc(sizeof(int) * n_vals);
+     reg = ln_alloc(sizeof(int) * n_vals);
+     for (x = 0; x < n_vals; x++) {
+          last_use[x] = -1;
+          reg[x] = -1;
+     }
+     for (k = 0; k < prog->n_nodes; k++) {
+          last_use[prog->nodes[k].a] = k;
+          last_use[prog->nodes[k].b] = k;
+     }
+     memset(used, 0, sizeof(used));
+
+     ret = 0;
+     put(c, prologue, sizeof(prologue));
+     loop = c->len;
+     for (k = 0; k < prog->n_nodes; k++) {
+          node = &prog->nodes[k];
+          if ((opcode = vex_opcode(node->op)) < 0)
+               goto end;
+          for (x = node->a; ; x = node->b) {
+               if (reg[x] < 0) {
+                    if ((reg[x] = alloc_vreg(used)) < 0)
+                         goto end;
+                    emit_load_src_ptr(c, x);
+                    emit_vex(c, 0x10, reg[x], 0, 0, RAX);
+               }
+               if (x == node->b)
+                    break;
+          }
+          r = reg[node->a];
+          x = reg[node->b];
+          if (last_use[node->a] == k)
+               used[r] = 0;
+          if (last_use[node->b] == k)
+               used[x] = 0;
+          reg[prog->n_in + k] = alloc_vreg(used);
+          if (reg[prog->n_in + k] < 0)
+               goto end;
+          emit_vex(c, opcode, reg[prog->n_in + k], r, x, -1);
+     }
+     emit_vex(c, 0x11, reg[n_vals - 1], 0, 0, RSI);
+     put(c, step, sizeof(step));
+     put_rel32(c, c->len - 4, loop);
+     put_rel32(c, sizeof(prologue) - 4, c->len);
+     put(c, epilogue, sizeof(epilogue));
+     ret = 1;
+
+end:
+     ln_free(reg);
+     ln_free(last_use);
+     return ret;
+}
+
+static void code_free(void *p)
+{
+     struct jit_code *code = p;
+
+     if (code->mem)
+          munmap(code->mem, code->size);
+     ln_free(code);
+}
+
+/* executable memory holding the code of c, or NULL */
+static void *map_code(struct code_buf *c, size_t *size)
+{
+     long page;
+     void *mem;
+
+     page = sysconf(_SC_PAGESIZE);
+     *size = (c->len + page - 1) / page * page;
+     mem = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (mem == MAP_FAILED)
+          return NULL;
+     memcpy(mem, c->bytes, c->len);
+     if (mprotect(mem, *size, PROT_READ | PROT_EXEC) < 0) {
+          munmap(mem, *size);
+          return NULL;
+     }
+     return mem;
+}
+
+/* let perf attribute samples in the code to signature */
+static void write_perf_map(struct jit_code *code, size_t len,
+                           const char *signature)
+{
+     char path[64];
+
+     if (!jit.perf_map) {
+          snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+          if (!(jit.perf_map = fopen(path, "a")))
+               return;
+     }
+     fprintf(jit.perf_map, "%lx %lx ln_jit:%s\n", (unsigned long)code->mem,
+             (unsigned long)len, signature);
+     fflush(jit.perf_map);
+}
+
+#endif  /* JIT_X86_64 */
+
+/*
+ * Machine code computing prog, cached by signature, which should identify
+ * prog, or NULL if it can't be compiled, when ln_jit_run() interprets it.
+ * The code stays until ln_jit_cleanup(). Each compiled function is listed
+ * in /tmp/perf-<pid>.map.
+ */
+ln_jit_func ln_jit_compile(const ln_jit_prog *prog, const char *signature)
+{
+#ifdef JIT_X86_64
+     struct jit_code *code;
+     struct code_buf c;
+
+     if (!ln_jit_is_available())
+          return NULL;
+
+     pthread_mutex_lock(&jit.mutex);
+     if (!jit.cache)
+          jit.cache = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free,
+                                     code_free);
+     if (!(code = ln_hash_find(jit.cache, (void *)signature))) {
+          code = ln_alloc(sizeof(struct jit_code));
+          code->mem = NULL;
+          code->size = 0;
+          c.bytes = NULL;
+          c.len = c.cap = 0;
+          if (generate(prog, &c))
+               code->mem = map_code(&c, &code->size);
+          if (code->mem)
+               write_perf_map(code, c.len, signature);
+          ln_free(c.bytes);
+          ln_hash_insert(jit.cache, ln_strdup(signature), code);
+     }
+     pthread_mutex_unlock(&jit.mutex);
+
+     return (ln_jit_func)code->mem;
+#else
+     return NULL;
+#endif
+}
+
+/* free all compiled code, after no op runs it any more */
+void ln_jit_cleanup(void)
+{
+     pthread_mutex_lock(&jit.mutex);
+     if (jit.cache)
+          ln_hash_free(jit.cache);
+     jit.cache = NULL;
+     if (jit.perf_map)
+          fclose(jit.perf_map);
+     jit.perf_map = NULL;
+     pthread_mutex_unlock(&jit.mutex);
+}
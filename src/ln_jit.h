@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_JIT_H_
+#define _LN_JIT_H_
+
+#include "tl_tensor.h"
+#include "ln_util.h"
+
+/*
+ * A fused elementwise expression over float tensors of the same shape.
+ * Operands below n_in are sources, and n_in + k is the value of node k.
+ * The value of the last node is the result.
+ */
+typedef struct ln_jit_node ln_jit_node;
+struct ln_jit_node {
+     tl_elew_op op;
+     int        a;
+     int        b;
+};
+
+typedef struct ln_jit_prog ln_jit_prog;
+struct ln_jit_prog {
+     int          n_in;
+     int          n_nodes;
+     ln_jit_node *nodes;
+};
+
+/* computes elements [0, len) of dst, len being a multiple of LN_JIT_WIDTH */
+typedef void (*ln_jit_func) (const float *const *srcs, float *dst,
+                             size_t len);
+
+#define LN_JIT_WIDTH 8          /* floats in a vector register */
+#define LN_JIT_BLOCK 64         /* elements an interpreter step computes */
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+int ln_jit_is_available(void);
+void ln_jit_set_enabled(int enabled);
+ln_jit_func ln_jit_compile(const ln_jit_prog *prog, const char *signature);
+void ln_jit_interpret(const ln_jit_prog *prog, const float *const *srcs,
+                      float *dst, size_t start, size_t end, float *work);
+void ln_jit_run(const ln_jit_prog *prog, ln_jit_func func,
+                const float *const *srcs, float *dst, size_t len,
+                float *work);
+void ln_jit_cleanup(void);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_JIT_H_ */
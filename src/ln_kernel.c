@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ln_kernel.h"
+
+#define SRC_MAXDIM 16
+
+static int size_index(size_t size)
+{
+     switch (size) {
+     case 1:
+          return 0;
+     case 2:
+          return 1;
+     case 4:
+          return 2;
+     case 8:
+          return 3;
+     default:
+          return -1;
+     }
+}
+
+/*
+ * Plan the transpose of src by axes as in tl_tensor_transpose(). Walking
+ * dst in order, a dst dim whose src stride times its size is the stride
+ * of the dim before it continues that dim, so the two are merged. Returns
+ * 0 if there is no kernel for the element size or the merged rank, when
+ * the caller should use tl_tensor_transpose().
+ */
+int ln_kernel_transpose_plan(ln_kernel_transpose *kt, const tl_tensor *src,
+                             const int *axes)
+{
+     size_t src_strides[SRC_MAXDIM];
+     size_t stride;
+     int ndim, dim, i, s;
+
+     kt->func = NULL;
+     kt->ndim = 0;
+     if ((s = size_index(tl_size_of(src->dtype))) < 0
+         || src->ndim > SRC_MAXDIM)
+          return 0;
+
+     for (i = src->ndim - 1, stride = 1; i >= 0; i--) {
+          src_strides[i] = stride;
+          stride *= src->dims[i];
+     }
+     ndim = 0;
+     for (i = 0; i < src->ndim; i++) {
+          dim = src->dims[axes[i]];
+          stride = src_strides[axes[i]];
+          if (dim == 1)
+               continue;
+          if (ndim > 0 && kt->strides[ndim - 1] == stride * dim) {
+               kt->dims[ndim - 1] *= dim;
+               kt->strides[ndim - 1] = stride;
+               continue;
+          }
+          if (ndim == LN_KERNEL_MAXDIM)
+               return 0;
+          kt->dims[ndim] = dim;
+          kt->strides[ndim] = stride;
+          ndim++;
+     }
+     if (ndim == 0) {
+          kt->dims[0] = 1;
+          kt->strides[0] = 1;
+          ndim = 1;
+     }
+
+     kt->ndim = ndim;
+     kt->func = ln_kernel_transpose_table[s][ndim - 1][kt->strides[ndim - 1] == 1];
+     return 1;
+}
+
+void ln_kernel_transpose_run(const ln_kernel_transpose *kt,
+                             const tl_tensor *src, tl_tensor *dst)
+{
+     kt->func(src->data, dst->data, kt->dims, kt->strides);
+}
+
+/*
+ * The maxreduce kernel of dtype, over the last axis of the collapsed
+ * [outer, n, inner] shape if last, or NULL if there is none.
+ */
+ln_kernel_maxreduce_func ln_kernel_maxreduce_find(tl_dtype dtype, int last,
+                                                  int with_arg)
+{
+     if (dtype < 0 || dtype >= TL_DTYPE_SIZE)
+          return NULL;
+     return ln_kernel_maxreduce_table[dtype][!!last][!!with_arg];
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_KERNEL_H_
+#define _LN_KERNEL_H_
+
+#include <stddef.h>
+#include "tl_tensor.h"
+#include "ln_util.h"
+
+/*
+ * Kernels specialized by dtype and rank, generated by scripts/genkernel.pl
+ * in ln_kernel_gen.c, whose inner loops are plain strided loops.
+ */
+#define LN_KERNEL_MAXDIM 6
+
+/* copy dst in order from src, walking dims with src strides in elements */
+typedef void (*ln_kernel_transpose_func) (const void *src, void *dst,
+                                          const int *dims,
+                                          const size_t *strides);
+
+/* max of [outer, n, inner] over n to [outer, inner], and its index in arg */
+typedef void (*ln_kernel_maxreduce_func) (const void *src, void *dst,
+                                          void *arg, int outer, int n,
+                                          int inner);
+
+/*
+ * A transpose with the dst dims that stay adjacent in src merged and dims
+ * of 1 dropped, see ln_kernel_transpose_plan().
+ */
+typedef struct ln_kernel_transpose ln_kernel_transpose;
+struct ln_kernel_transpose {
+     ln_kernel_transpose_func func;
+     int                      ndim;
+     int                      dims[LN_KERNEL_MAXDIM];
+     size_t                   strides[LN_KERNEL_MAXDIM];
+};
+
+/* [element size 1, 2, 4, 8][ndim - 1][innermost stride is 1] */
+extern const ln_kernel_transpose_func ln_kernel_transpose_table[4][LN_KERNEL_MAXDIM][2];
+/* [dtype][over the last axis][with arg], NULL for TL_BOOL */
+extern const ln_kernel_maxreduce_func ln_kernel_maxreduce_table[TL_DTYPE_SIZE][2][2];
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+int ln_kernel_transpose_plan(ln_kernel_transpose *kt, const tl_tensor *src,
+                             const int *axes);
+void ln_kernel_transpose_run(const ln_kernel_transpose *kt,
+                             const tl_tensor *src, tl_tensor *dst);
+ln_kernel_maxreduce_func ln_kernel_maxreduce_find(tl_dtype dtype, int last,
+                                                  int with_arg);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_KERNEL_H_ */
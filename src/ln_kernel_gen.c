@@ -0,0 +1,1712 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Generated by scripts/genkernel.pl. Edit the script instead. */
+
+#include <stdint.h>
+#include "ln_kernel.h"
+
+static void transpose_1_1(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[(size_t)i0 * strides[0]];
+}
+
+static void transpose_1_1_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[i0];
+}
+
+static void transpose_1_2(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[(size_t)i1 * strides[1]];
+          d += dims[1];
+     }
+}
+
+static void transpose_1_2_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[i1];
+          d += dims[1];
+     }
+}
+
+static void transpose_1_3(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[(size_t)i2 * strides[2]];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_1_3_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[i2];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_1_4(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[(size_t)i3 * strides[3]];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_1_4_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[i3];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_1_5(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[(size_t)i4 * strides[4]];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_1_5_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[i4];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_1_6(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[(size_t)i5 * strides[5]];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_1_6_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     const uint8_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[i5];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_2_1(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[(size_t)i0 * strides[0]];
+}
+
+static void transpose_2_1_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[i0];
+}
+
+static void transpose_2_2(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[(size_t)i1 * strides[1]];
+          d += dims[1];
+     }
+}
+
+static void transpose_2_2_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[i1];
+          d += dims[1];
+     }
+}
+
+static void transpose_2_3(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[(size_t)i2 * strides[2]];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_2_3_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[i2];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_2_4(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[(size_t)i3 * strides[3]];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_2_4_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[i3];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_2_5(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[(size_t)i4 * strides[4]];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_2_5_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[i4];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_2_6(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[(size_t)i5 * strides[5]];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_2_6_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     const uint16_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[i5];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_4_1(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[(size_t)i0 * strides[0]];
+}
+
+static void transpose_4_1_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[i0];
+}
+
+static void transpose_4_2(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[(size_t)i1 * strides[1]];
+          d += dims[1];
+     }
+}
+
+static void transpose_4_2_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[i1];
+          d += dims[1];
+     }
+}
+
+static void transpose_4_3(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[(size_t)i2 * strides[2]];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_4_3_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[i2];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_4_4(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[(size_t)i3 * strides[3]];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_4_4_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[i3];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_4_5(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[(size_t)i4 * strides[4]];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_4_5_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[i4];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_4_6(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[(size_t)i5 * strides[5]];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_4_6_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     const uint32_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[i5];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_8_1(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[(size_t)i0 * strides[0]];
+}
+
+static void transpose_8_1_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     int i0;
+
+     for (i0 = 0; i0 < dims[0]; i0++)
+          d[i0] = s[i0];
+}
+
+static void transpose_8_2(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[(size_t)i1 * strides[1]];
+          d += dims[1];
+     }
+}
+
+static void transpose_8_2_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0;
+     int i0, i1;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++)
+               d[i1] = s0[i1];
+          d += dims[1];
+     }
+}
+
+static void transpose_8_3(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[(size_t)i2 * strides[2]];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_8_3_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1;
+     int i0, i1, i2;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++)
+                    d[i2] = s1[i2];
+               d += dims[2];
+          }
+     }
+}
+
+static void transpose_8_4(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[(size_t)i3 * strides[3]];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_8_4_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2;
+     int i0, i1, i2, i3;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++)
+                         d[i3] = s2[i3];
+                    d += dims[3];
+               }
+          }
+     }
+}
+
+static void transpose_8_5(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[(size_t)i4 * strides[4]];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_8_5_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2, *s3;
+     int i0, i1, i2, i3, i4;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++)
+                              d[i4] = s3[i4];
+                         d += dims[4];
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_8_6(const void *src, void *dst, const int *dims,
+                          const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[(size_t)i5 * strides[5]];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+static void transpose_8_6_contig(const void *src, void *dst, const int *dims,
+                                 const size_t *strides)
+{
+     const uint64_t *s = src;
+     uint64_t *d = dst;
+     const uint64_t *s0, *s1, *s2, *s3, *s4;
+     int i0, i1, i2, i3, i4, i5;
+
+     for (i0 = 0; i0 < dims[0]; i0++) {
+          s0 = s + (size_t)i0 * strides[0];
+          for (i1 = 0; i1 < dims[1]; i1++) {
+               s1 = s0 + (size_t)i1 * strides[1];
+               for (i2 = 0; i2 < dims[2]; i2++) {
+                    s2 = s1 + (size_t)i2 * strides[2];
+                    for (i3 = 0; i3 < dims[3]; i3++) {
+                         s3 = s2 + (size_t)i3 * strides[3];
+                         for (i4 = 0; i4 < dims[4]; i4++) {
+                              s4 = s3 + (size_t)i4 * strides[4];
+                              for (i5 = 0; i5 < dims[5]; i5++)
+                                   d[i5] = s4[i5];
+                              d += dims[5];
+                         }
+                    }
+               }
+          }
+     }
+}
+
+const ln_kernel_transpose_func ln_kernel_transpose_table[4][LN_KERNEL_MAXDIM][2] = {
+     {
+          {transpose_1_1, transpose_1_1_contig},
+          {transpose_1_2, transpose_1_2_contig},
+          {transpose_1_3, transpose_1_3_contig},
+          {transpose_1_4, transpose_1_4_contig},
+          {transpose_1_5, transpose_1_5_contig},
+          {transpose_1_6, transpose_1_6_contig}
+     },
+     {
+          {transpose_2_1, transpose_2_1_contig},
+          {transpose_2_2, transpose_2_2_contig},
+          {transpose_2_3, transpose_2_3_contig},
+          {transpose_2_4, transpose_2_4_contig},
+          {transpose_2_5, transpose_2_5_contig},
+          {transpose_2_6, transpose_2_6_contig}
+     },
+     {
+          {transpose_4_1, transpose_4_1_contig},
+          {transpose_4_2, transpose_4_2_contig},
+          {transpose_4_3, transpose_4_3_contig},
+          {transpose_4_4, transpose_4_4_contig},
+          {transpose_4_5, transpose_4_5_contig},
+          {transpose_4_6, transpose_4_6_contig}
+     },
+     {
+          {transpose_8_1, transpose_8_1_contig},
+          {transpose_8_2, transpose_8_2_contig},
+          {transpose_8_3, transpose_8_3_contig},
+          {transpose_8_4, transpose_8_4_contig},
+          {transpose_8_5, transpose_8_5_contig},
+          {transpose_8_6, transpose_8_6_contig}
+     }
+};
+
+static void maxreduce_double_mid(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const double *s = src;
+     double *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_double_mid_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const double *s = src;
+     double *d = dst;
+     double *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_double_last(const void *src, void *dst, void *arg,
+                                  int outer, int n, int inner)
+{
+     const double *s = src;
+     double *d = dst;
+     double m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_double_last_arg(const void *src, void *dst, void *arg,
+                                      int outer, int n, int inner)
+{
+     const double *s = src;
+     double *d = dst;
+     double *a = arg;
+     double m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_float_mid(const void *src, void *dst, void *arg,
+                                int outer, int n, int inner)
+{
+     const float *s = src;
+     float *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_float_mid_arg(const void *src, void *dst, void *arg,
+                                    int outer, int n, int inner)
+{
+     const float *s = src;
+     float *d = dst;
+     float *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_float_last(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const float *s = src;
+     float *d = dst;
+     float m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_float_last_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const float *s = src;
+     float *d = dst;
+     float *a = arg;
+     float m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_int32_mid(const void *src, void *dst, void *arg,
+                                int outer, int n, int inner)
+{
+     const int32_t *s = src;
+     int32_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_int32_mid_arg(const void *src, void *dst, void *arg,
+                                    int outer, int n, int inner)
+{
+     const int32_t *s = src;
+     int32_t *d = dst;
+     int32_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_int32_last(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const int32_t *s = src;
+     int32_t *d = dst;
+     int32_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_int32_last_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const int32_t *s = src;
+     int32_t *d = dst;
+     int32_t *a = arg;
+     int32_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_int16_mid(const void *src, void *dst, void *arg,
+                                int outer, int n, int inner)
+{
+     const int16_t *s = src;
+     int16_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_int16_mid_arg(const void *src, void *dst, void *arg,
+                                    int outer, int n, int inner)
+{
+     const int16_t *s = src;
+     int16_t *d = dst;
+     int16_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_int16_last(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const int16_t *s = src;
+     int16_t *d = dst;
+     int16_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_int16_last_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const int16_t *s = src;
+     int16_t *d = dst;
+     int16_t *a = arg;
+     int16_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_int8_mid(const void *src, void *dst, void *arg,
+                               int outer, int n, int inner)
+{
+     const int8_t *s = src;
+     int8_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_int8_mid_arg(const void *src, void *dst, void *arg,
+                                   int outer, int n, int inner)
+{
+     const int8_t *s = src;
+     int8_t *d = dst;
+     int8_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_int8_last(const void *src, void *dst, void *arg,
+                                int outer, int n, int inner)
+{
+     const int8_t *s = src;
+     int8_t *d = dst;
+     int8_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_int8_last_arg(const void *src, void *dst, void *arg,
+                                    int outer, int n, int inner)
+{
+     const int8_t *s = src;
+     int8_t *d = dst;
+     int8_t *a = arg;
+     int8_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_uint32_mid(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_uint32_mid_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     uint32_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_uint32_last(const void *src, void *dst, void *arg,
+                                  int outer, int n, int inner)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     uint32_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_uint32_last_arg(const void *src, void *dst, void *arg,
+                                      int outer, int n, int inner)
+{
+     const uint32_t *s = src;
+     uint32_t *d = dst;
+     uint32_t *a = arg;
+     uint32_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_uint16_mid(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_uint16_mid_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     uint16_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_uint16_last(const void *src, void *dst, void *arg,
+                                  int outer, int n, int inner)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     uint16_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_uint16_last_arg(const void *src, void *dst, void *arg,
+                                      int outer, int n, int inner)
+{
+     const uint16_t *s = src;
+     uint16_t *d = dst;
+     uint16_t *a = arg;
+     uint16_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+static void maxreduce_uint8_mid(const void *src, void *dst, void *arg,
+                                int outer, int n, int inner)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    d[j] = s[j] > d[j] ? s[j] : d[j];
+               }
+          }
+     }
+}
+
+static void maxreduce_uint8_mid_arg(const void *src, void *dst, void *arg,
+                                    int outer, int n, int inner)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     uint8_t *a = arg;
+     int i, j, k;
+
+     for (i = 0; i < outer; i++, d += inner, a += inner) {
+          for (j = 0; j < inner; j++)
+               d[j] = s[j];
+          for (j = 0; j < inner; j++)
+               a[j] = 0;
+          s += inner;
+          for (k = 1; k < n; k++, s += inner) {
+               for (j = 0; j < inner; j++) {
+                    if (s[j] > d[j]) {
+                         d[j] = s[j];
+                         a[j] = k;
+                    }
+               }
+          }
+     }
+}
+
+static void maxreduce_uint8_last(const void *src, void *dst, void *arg,
+                                 int outer, int n, int inner)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     uint8_t m;
+     int i, k;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          for (k = 1; k < n; k++)
+               m = s[k] > m ? s[k] : m;
+          d[i] = m;
+     }
+}
+
+static void maxreduce_uint8_last_arg(const void *src, void *dst, void *arg,
+                                     int outer, int n, int inner)
+{
+     const uint8_t *s = src;
+     uint8_t *d = dst;
+     uint8_t *a = arg;
+     uint8_t m;
+     int i, k, mk;
+
+     for (i = 0; i < outer; i++, s += n) {
+          m = s[0];
+          mk = 0;
+          for (k = 1; k < n; k++) {
+               if (s[k] > m) {
+                    m = s[k];
+                    mk = k;
+               }
+          }
+          d[i] = m;
+          a[i] = mk;
+     }
+}
+
+const ln_kernel_maxreduce_func ln_kernel_maxreduce_table[TL_DTYPE_SIZE][2][2] = {
+     [TL_DOUBLE] = {{maxreduce_double_mid, maxreduce_double_mid_arg},
+                    {maxreduce_double_last, maxreduce_double_last_arg}},
+     [TL_FLOAT] = {{maxreduce_float_mid, maxreduce_float_mid_arg},
+                   {maxreduce_float_last, maxreduce_float_last_arg}},
+     [TL_INT32] = {{maxreduce_int32_mid, maxreduce_int32_mid_arg},
+                   {maxreduce_int32_last, maxreduce_int32_last_arg}},
+     [TL_INT16] = {{maxreduce_int16_mid, maxreduce_int16_mid_arg},
+                   {maxreduce_int16_last, maxreduce_int16_last_arg}},
+     [TL_INT8] = {{maxreduce_int8_mid, maxreduce_int8_mid_arg},
+                  {maxreduce_int8_last, maxreduce_int8_last_arg}},
+     [TL_UINT32] = {{maxreduce_uint32_mid, maxreduce_uint32_mid_arg},
+                    {maxreduce_uint32_last, maxreduce_uint32_last_arg}},
+     [TL_UINT16] = {{maxreduce_uint16_mid, maxreduce_uint16_mid_arg},
+                    {maxreduce_uint16_last, maxreduce_uint16_last_arg}},
+     [TL_UINT8] = {{maxreduce_uint8_mid, maxreduce_uint8_mid_arg},
+                   {maxreduce_uint8_last, maxreduce_uint8_last_arg}}
+};
@@ -21,6 +21,9 @@
  */
 
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "ln_mem.h"
 #include "ln_error.h"
 
@@ -62,6 +65,9 @@ ln_mem_pool *ln_mem_pool_create(size_t size, size_t align_size)
      mem_pool = ln_alloc(sizeof(ln_mem_pool));
      mem_pool->size = size;
      mem_pool->align_size = align_size;
+     mem_pool->peak = 0;
+     mem_pool->base = NULL;
+     mem_pool->fd = -1;
      minfo = mem_info_create(HOLE, 0, size);
      mem_pool->mem_blocks = ln_list_append(NULL, minfo);
 
@@ -73,8 +79,81 @@ static void mem_info_free_wrapper(void *minfo)
      mem_info_free((mem_info *)minfo);
 }
 
+/*
+ * Create a memory pool backed by the file at path, which is created and
+ * mapped into memory, so that tensors planned in the pool may be larger than
+ * the RAM and are paged to the disk by the kernel. The file is unlinked right
+ * away and vanishes when the pool is freed.
+ */
+ln_mem_pool *ln_mem_pool_create_mmap(size_t size, size_t align_size,
+                                     const char *path)
+{
+     ln_mem_pool *mem_pool;
+     ln_error *error;
+     void *base;
+     int fd;
+
+     mem_pool = ln_mem_pool_create(size, align_size);
+     fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+     if (fd < 0) {
+          error = ln_error_create(LN_ERROR_SYS,
+                                  "ln_mem_pool_create_mmap(): cannot create %s",
+                                  path);
+          ln_error_handle(&error);
+     }
+     unlink(path);
+     if (ftruncate(fd, size) < 0) {
+          error = ln_error_create(LN_ERROR_SYS,
+                                  "ln_mem_pool_create_mmap(): cannot resize %s to %lu bytes",
+                                  path, size);
+          ln_error_handle(&error);
+     }
+     base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+     if (base == MAP_FAILED) {
+          error = ln_error_create(LN_ERROR_SYS,
+                                  "ln_mem_pool_create_mmap(): cannot map %s",
+                                  path);
+          ln_error_handle(&error);
+     }
+     /* tensors are mostly read and written from start to end */
+     madvise(base, size, MADV_SEQUENTIAL);
+     mem_pool->base = base;
+     mem_pool->fd = fd;
+
+     return mem_pool;
+}
+
+/*
+ * Create a memory pool backed by one block of anonymous host memory, so that
+ * the tensors planned in it take the pool size of RAM at most, and only the
+ * pages touched so far.
+ */
+ln_mem_pool *ln_mem_pool_create_arena(size_t size, size_t align_size)
+{
+     ln_mem_pool *mem_pool;
+     ln_error *error;
+     void *base;
+
+     mem_pool = ln_mem_pool_create(size, align_size);
+     base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (base == MAP_FAILED) {
+          error = ln_error_create(LN_ERROR_SYS,
+                                  "ln_mem_pool_create_arena(): cannot map %lu bytes",
+                                  size);
+          ln_error_handle(&error);
+     }
+     mem_pool->base = base;
+
+     return mem_pool;
+}
+
 void ln_mem_pool_free(ln_mem_pool *mem_pool)
 {
+     if (mem_pool->base)
+          munmap(mem_pool->base, mem_pool->size);
+     if (mem_pool->fd >= 0)
+          close(mem_pool->fd);
      ln_list_free_deep(mem_pool->mem_blocks, mem_info_free_wrapper);
      ln_free(mem_pool);
 }
@@ -132,6 +211,8 @@ size_t ln_mem_alloc(ln_mem_pool *mem_pool, size_t size)
                                                new_minfo, fit_idx);
      minfo->start += mem_size;
      minfo->size -= mem_size;
+     if (minfo->start > mem_pool->peak)
+          mem_pool->peak = minfo->start;
      if (minfo->size == 0)
           mem_pool->mem_blocks = ln_list_remove_nth_deep(mem_pool->mem_blocks,
                                                          fit_idx + 1,
@@ -203,3 +284,35 @@ void ln_mem_dump(ln_mem_pool *mem_pool, FILE *fp)
                   minfo->start+minfo->size-1, minfo->flag==HOLE?"H":"S");
      }
 }
+
+static void mem_advise(ln_mem_pool *mem_pool, size_t addr, size_t size,
+                       int advice)
+{
+     size_t page_size, start, end;
+
+     if (mem_pool->fd < 0 || size == 0)
+          return;
+     page_size = sysconf(_SC_PAGESIZE);
+     start = addr / page_size * page_size;
+     end = addr + size;
+     madvise((char *)mem_pool->base + start, end - start, advice);
+}
+
+/*
+ * Tell the kernel [addr, addr+size) of a file-backed pool will be used soon,
+ * so that it's read in ahead. No-op for other pools.
+ */
+void ln_mem_prefetch(ln_mem_pool *mem_pool, size_t addr, size_t size)
+{
+     mem_advise(mem_pool, addr, size, MADV_WILLNEED);
+}
+
+/*
+ * Tell the kernel [addr, addr+size) of a file-backed pool won't be used for
+ * a while, so that its pages can be written back and dropped from the RAM.
+ * No-op for other pools.
+ */
+void ln_mem_release(ln_mem_pool *mem_pool, size_t addr, size_t size)
+{
+     mem_advise(mem_pool, addr, size, MADV_DONTNEED);
+}
@@ -30,14 +30,19 @@ typedef enum ln_mem_type ln_mem_type;
 enum ln_mem_type {
      LN_MEM_UNDEFINED,
      LN_MEM_CPU,
-     LN_MEM_CUDA
+     LN_MEM_CUDA,
+     LN_MEM_MMAP,               /* host memory mapped from a disk file */
+     LN_MEM_SIM                 /* memory of the simulated device, see ln_sim.h */
 };
 
 typedef struct ln_mem_pool ln_mem_pool;
 struct ln_mem_pool {
      size_t   size;
      size_t   align_size;
+     size_t   peak;              /* highest end of allocated blocks so far */
      ln_list *mem_blocks;
+     void    *base;              /* memory addressed by the pool, or NULL */
+     int      fd;                /* file mapped at base, or -1 */
 };
 
 #ifdef __cplusplus
@@ -45,11 +50,16 @@ LN_CPPSTART
 #endif
 
 ln_mem_pool *ln_mem_pool_create(size_t size, size_t align_size);
+ln_mem_pool *ln_mem_pool_create_mmap(size_t size, size_t align_size,
+                                     const char *path);
+ln_mem_pool *ln_mem_pool_create_arena(size_t size, size_t align_size);
 void ln_mem_pool_free(ln_mem_pool *mem_pool);
 size_t ln_mem_alloc(ln_mem_pool *mem_pool, size_t size);
 void ln_mem_free(ln_mem_pool *mem_pool, size_t addr);
 int ln_mem_exist(ln_mem_pool *mem_pool, size_t addr);
 void ln_mem_dump(ln_mem_pool *mem_pool, FILE *fp);
+void ln_mem_prefetch(ln_mem_pool *mem_pool, size_t addr, size_t size);
+void ln_mem_release(ln_mem_pool *mem_pool, size_t addr, size_t size);
 
 #ifdef __cplusplus
 LN_CPPEND
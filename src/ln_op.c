@@ -20,6 +20,8 @@
  * SOFTWARE.
  */
 
+#include <string.h>
+#include <time.h>
 #include "ln_op.h"
 
 static ln_op_arg *ln_op_arg_create(const char *name, const char *optype,
@@ -62,10 +64,21 @@ ln_op *ln_op_create(const char *name, const char *optype,
      op->pre_run = pre_run;
      op->run = run;
      op->post_run = post_run;
+     op->cost = NULL;
+     op->variants = NULL;
+     op->emit = NULL;
 
      return op;
 }
 
+/* copy the optional members of proto's implementation to op */
+void ln_op_copy_impl(ln_op *op, const ln_op *proto)
+{
+     op->cost = proto->cost;
+     op->variants = proto->variants;
+     op->emit = proto->emit;
+}
+
 void ln_op_free(ln_op *op)
 {
      ln_op_arg_free(op->op_arg);
@@ -188,6 +201,151 @@ void ln_op_list_do_run(ln_list *ops, ln_error **error)
      }
 }
 
+/* the pool whose memory te is bound to when running, or NULL */
+static ln_mem_pool *bound_pool(ln_tensor_entry *te, ln_hash *planned,
+                               ln_hash *mem_pools)
+{
+     ln_mem_pool *mp;
+     ln_mem_type mtype;
+
+     /* external inputs and static tensors aren't planned */
+     if (!ln_hash_find_extended(planned, te->name, NULL))
+          return NULL;
+     mtype = te->mtype == LN_MEM_UNDEFINED ? LN_MEM_CPU : te->mtype;
+     mp = ln_hash_find(mem_pools, (void *)mtype);
+     if (!mp || !mp->base)
+          return NULL;
+     return mp;
+}
+
+static void prefetch_table(ln_tensor_table *table, ln_hash *planned,
+                           ln_hash *mem_pools)
+{
+     ln_tensor_entry *te;
+     ln_mem_pool *mp;
+
+     LN_LIST_FOREACH(te, table) {
+          if ((mp = bound_pool(te, planned, mem_pools)))
+               ln_mem_prefetch(mp, te->offset, tl_tensor_size(te->tensor));
+     }
+}
+
+static void bind_table(ln_tensor_table *table, ln_hash *planned,
+                       ln_hash *mem_pools, ln_hash *saved_data)
+{
+     ln_tensor_entry *te;
+     ln_mem_pool *mp;
+
+     LN_LIST_FOREACH(te, table) {
+          if (!(mp = bound_pool(te, planned, mem_pools)))
+               continue;
+          if (!ln_hash_find_extended(saved_data, te->tensor, NULL))
+               ln_hash_insert(saved_data, te->tensor, te->tensor->data);
+          te->tensor->data = (char *)mp->base + te->offset;
+     }
+}
+
+static void unbind_table(ln_tensor_table *table, ln_hash *saved_data)
+{
+     ln_tensor_entry *te;
+     void *data;
+
+     LN_LIST_FOREACH(te, table) {
+          if (!ln_hash_find_extended(saved_data, te->tensor, &data))
+               continue;
+          te->tensor->data = data;
+          ln_hash_remove(saved_data, te->tensor);
+     }
+}
+
+static void release_table(ln_tensor_table *table, ln_hash *planned,
+                          ln_hash *mem_pools, ln_hash *last_uses, ssize_t i)
+{
+     ln_tensor_entry *te;
+     ln_mem_pool *mp;
+
+     LN_LIST_FOREACH(te, table) {
+          if (!(mp = bound_pool(te, planned, mem_pools))
+              || ln_hash_find(last_uses, te->name) != (void *)i)
+               continue;
+          ln_mem_release(mp, te->offset, tl_tensor_size(te->tensor));
+     }
+}
+
+/*
+ * Run ops with the tensors they create bound to the memory planned by
+ * ln_optimize_mem() in those of mem_pools that have real memory, such as
+ * arenas and file-backed pools. The data of a bound tensor points into its
+ * pool while its op runs, and is restored afterwards. The buffers pre_run
+ * gave bound tensors are freed on the first run, so that they take the
+ * memory of the pools only, and their data is NULL out of a run. Driven by
+ * the op order, bound tensors of the next op are prefetched, and tensors
+ * are released from RAM after their last use.
+ */
+void ln_op_list_do_run_in_pools(ln_list *ops, ln_hash *mem_pools,
+                                ln_error **error)
+{
+     ln_hash *planned, *last_uses, *saved_data;
+     ln_tensor_entry *te;
+     ln_list *l;
+     ln_op *op;
+     ssize_t i;
+
+     planned = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     last_uses = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     saved_data = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     for (l = ops, i = 0; l; l = l->next, i++) {
+          op = (ln_op *)l->data;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(last_uses, te->name, (void *)i);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->owner ? ln_hash_find_extended(planned, te->owner, NULL)
+                   : !te->isstatic && !te->isdead)
+                    ln_hash_insert(planned, te->name, NULL);
+               ln_hash_insert(last_uses, te->name, (void *)i);
+          }
+     }
+
+     /* bound tensors don't need the buffers of pre_run, nor views of them */
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!bound_pool(te, planned, mem_pools))
+                    continue;
+               if (!te->owner)
+                    ln_free(te->tensor->data);
+               te->tensor->data = NULL;
+          }
+     }
+
+     if (ops) {
+          op = (ln_op *)ops->data;
+          prefetch_table(op->op_arg->tensors_in, planned, mem_pools);
+     }
+     for (l = ops, i = 0; l; l = l->next, i++) {
+          op = (ln_op *)l->data;
+          if (l->next) {
+               prefetch_table(((ln_op *)l->next->data)->op_arg->tensors_in,
+                              planned, mem_pools);
+          }
+          bind_table(op->op_arg->tensors_in, planned, mem_pools, saved_data);
+          bind_table(op->op_arg->tensors_out, planned, mem_pools, saved_data);
+          op->run(op->op_arg, error);
+          unbind_table(op->op_arg->tensors_in, saved_data);
+          unbind_table(op->op_arg->tensors_out, saved_data);
+          release_table(op->op_arg->tensors_in, planned, mem_pools,
+                        last_uses, i);
+          release_table(op->op_arg->tensors_out, planned, mem_pools,
+                        last_uses, i);
+          if (*error)
+               break;
+     }
+
+     ln_hash_free(saved_data);
+     ln_hash_free(last_uses);
+     ln_hash_free(planned);
+}
+
 void ln_op_list_do_post_run(ln_list *ops, ln_error **error)
 {
      ln_list *l;
@@ -200,3 +358,133 @@ void ln_op_list_do_post_run(ln_list *ops, ln_error **error)
                return;
      }
 }
+
+/* the work of one run of op, or zeros if op doesn't report its cost */
+void ln_op_get_cost(ln_op *op, ln_op_cost *cost)
+{
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = 0;
+     if (op->cost)
+          op->cost(op->op_arg, cost);
+}
+
+/* op's variant of run named name, or NULL if there isn't one */
+const ln_op_variant *ln_op_find_variant(ln_op *op, const char *name)
+{
+     const ln_op_variant *v;
+
+     if (!op->variants)
+          return NULL;
+     for (v = op->variants; v->name; v++) {
+          if (!strcmp(v->name, name))
+               return v;
+     }
+     return NULL;
+}
+
+static double now(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Run ops n_runs times and return the average time of each op's run() in
+ * seconds, in an array in the order of ops, which should be freed.
+ */
+double *ln_op_list_time(ln_list *ops, int n_runs, ln_error **error)
+{
+     double *times;
+     double start;
+     ln_op *op;
+     int i, j;
+
+     times = ln_alloc(sizeof(double) * (ln_list_length(ops) + 1));
+     memset(times, 0, sizeof(double) * (ln_list_length(ops) + 1));
+     for (i = 0; i < n_runs; i++) {
+          j = 0;
+          LN_LIST_FOREACH(op, ops) {
+               start = now();
+               op->run(op->op_arg, error);
+               times[j++] += now() - start;
+               if (*error)
+                    return times;
+          }
+     }
+     for (j = 0; n_runs > 0 && j < ln_list_length(ops); j++)
+          times[j] /= n_runs;
+
+     return times;
+}
+
+static void print_roofline_line(FILE *fp, const char *name,
+                                const char *optype, ln_op_cost *cost,
+                                double time, double peak_gflops,
+                                double peak_gbps)
+{
+     double bytes, gflops, gbps, intensity, roof;
+
+     bytes = cost->bytes_read + cost->bytes_written;
+     gflops = time > 0 ? cost->flops / time * 1e-9 : 0;
+     gbps = time > 0 ? bytes / time * 1e-9 : 0;
+     intensity = bytes > 0 ? cost->flops / bytes : 0;
+     fprintf(fp, "%-20s %-12s %12.3f %14lu %14lu %10.3f %10.3f %10.3f",
+             name, optype, time * 1e6, (unsigned long)cost->flops,
+             (unsigned long)bytes, intensity, gflops, gbps);
+     if (peak_gflops > 0 && peak_gbps > 0) {
+          /* the attainable performance under the roofline */
+          if (cost->flops > 0) {
+               roof = intensity * peak_gbps < peak_gflops ?
+                    intensity * peak_gbps : peak_gflops;
+               fprintf(fp, " %8.1f%% %s", gflops / roof * 100,
+                       intensity < peak_gflops / peak_gbps ?
+                       "memory" : "compute");
+          } else if (bytes > 0) {
+               fprintf(fp, " %8.1f%% %s", gbps / peak_gbps * 100, "memory");
+          }
+     }
+     fprintf(fp, "\n");
+}
+
+/*
+ * Print the roofline view of ops: each op's cost, arithmetic intensity in
+ * FLOPs per byte and attained GFLOP/s and GB/s with its times, as returned
+ * by ln_op_list_time(). If the machine's peak_gflops and peak_gbps are
+ * positive, also print the percent of the attainable performance, which
+ * is the peak GFLOP/s or intensity times the peak GB/s, whichever is
+ * lower, and which of them bounds the op.
+ */
+void ln_op_list_print_roofline(ln_list *ops, const double *times,
+                               double peak_gflops, double peak_gbps,
+                               FILE *fp)
+{
+     ln_op_cost cost, total;
+     double total_time;
+     ln_op *op;
+     int i;
+
+     fprintf(fp, "%-20s %-12s %12s %14s %14s %10s %10s %10s",
+             "op", "optype", "time (us)", "FLOPs", "bytes", "FLOP/byte",
+             "GFLOP/s", "GB/s");
+     if (peak_gflops > 0 && peak_gbps > 0)
+          fprintf(fp, " %9s %s", "of roof", "bound");
+     fprintf(fp, "\n");
+
+     total.flops = total.bytes_read = total.bytes_written = 0;
+     total_time = 0;
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          ln_op_get_cost(op, &cost);
+          print_roofline_line(fp, op->op_arg->name, op->op_arg->optype,
+                              &cost, times[i], peak_gflops, peak_gbps);
+          total.flops += cost.flops;
+          total.bytes_read += cost.bytes_read;
+          total.bytes_written += cost.bytes_written;
+          total_time += times[i++];
+     }
+     print_roofline_line(fp, "total", "", &total, total_time,
+                         peak_gflops, peak_gbps);
+}
@@ -26,6 +26,7 @@
 #include "ln_tensor.h"
 #include "ln_param.h"
 #include "ln_error.h"
+#include "ln_hash.h"
 
 typedef struct ln_op_arg ln_op_arg;
 struct ln_op_arg {
@@ -39,12 +40,37 @@ struct ln_op_arg {
 
 typedef void (*ln_op_func) (ln_op_arg *op_arg, ln_error **error);
 
+/* work done by one run of an op */
+typedef struct ln_op_cost ln_op_cost;
+struct ln_op_cost {
+     size_t flops;              /* arithmetic operations */
+     size_t bytes_read;
+     size_t bytes_written;
+};
+
+/* fill cost from the tensors made by pre_run */
+typedef void (*ln_op_cost_func) (ln_op_arg *op_arg, ln_op_cost *cost);
+
+/* another implementation of run, sharing the private data of pre_run */
+typedef struct ln_op_variant ln_op_variant;
+struct ln_op_variant {
+     const char *name;
+     ln_op_func  run;
+};
+
+/* write one run of an op as C statements, see ln_compile.h */
+typedef struct ln_compile_ctx ln_compile_ctx;
+typedef void (*ln_op_emit_func) (ln_op_arg *op_arg, ln_compile_ctx *ctx);
+
 typedef struct ln_op ln_op;
 struct ln_op {
-     ln_op_arg   *op_arg;
-     ln_op_func   pre_run;
-     ln_op_func   run;
-     ln_op_func   post_run;
+     ln_op_arg           *op_arg;
+     ln_op_func           pre_run;
+     ln_op_func           run;
+     ln_op_func           post_run;
+     ln_op_cost_func      cost;     /* optional, NULL if unknown */
+     const ln_op_variant *variants; /* optional, ended by a NULL name */
+     ln_op_emit_func      emit;     /* optional, NULL if it can't be compiled */
 };
 
 #ifdef __cplusplus
@@ -55,6 +81,7 @@ ln_op *ln_op_create(const char *name, const char *optype,
                     ln_tensor_table *tensors_in, ln_tensor_table *tensors_out,
                     ln_param_table *params,
                     ln_op_func pre_run, ln_op_func run, ln_op_func post_run);
+void ln_op_copy_impl(ln_op *op, const ln_op *proto);
 void ln_op_free(ln_op *op);
 ln_list *ln_op_list_create_from_array(ln_op **op_array);
 void ln_op_list_free_tables_too(ln_list *ops);
@@ -63,7 +90,15 @@ ln_op *ln_op_list_find_by_optype(ln_list *ops, char *optype);
 ln_op *ln_op_list_find_by_name(ln_list *ops, char *name);
 void ln_op_list_do_pre_run(ln_list *ops, ln_error **error);
 void ln_op_list_do_run(ln_list *ops, ln_error **error);
+void ln_op_list_do_run_in_pools(ln_list *ops, ln_hash *mem_pools,
+                                ln_error **error);
 void ln_op_list_do_post_run(ln_list *ops, ln_error **error);
+void ln_op_get_cost(ln_op *op, ln_op_cost *cost);
+const ln_op_variant *ln_op_find_variant(ln_op *op, const char *name);
+double *ln_op_list_time(ln_list *ops, int n_runs, ln_error **error);
+void ln_op_list_print_roofline(ln_list *ops, const double *times,
+                               double peak_gflops, double peak_gbps,
+                               FILE *fp);
 
 #ifdef __cplusplus
 LN_CPPEND
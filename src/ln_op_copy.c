@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "ln_op.h"
+#include "ln_compile.h"
+
+struct priv_s {
+     tl_tensor *src;
+     tl_tensor *dst;
+};
+
+/*
+ * This function should do the parameter checking and tensor memory allocation.
+ */
+static void copy_pre_run(ln_op_arg *op_arg, ln_error **error)
+{
+     ln_tensor_entry *src_entry, *dst_entry;
+     int tensors_n, params_n;
+     struct priv_s *priv;
+
+     /* check tensors and parameters */
+     tensors_n = ln_tensor_table_length(op_arg->tensors_in);
+     ln_op_check_tensor_in_len_eq(LN_ERROR, tensors_n, 1);
+
+     tensors_n = ln_tensor_table_length(op_arg->tensors_out);
+     ln_op_check_tensor_out_len_eq(LN_ERROR, tensors_n, 1);
+
+     src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src");
+     ln_op_check_tensor_in_exist(LN_ERROR, src_entry, "src");
+     ln_op_check_tensor_defined(LN_ERROR, src_entry);
+
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+     ln_op_check_tensor_out_exist(LN_ERROR, dst_entry, "dst");
+     ln_op_check_tensor_not_defined(LN_ERROR, dst_entry);
+
+     params_n = ln_param_table_length(op_arg->params);
+     ln_op_check_param_len_eq(LN_ERROR, params_n, 0);
+
+     /* allocate tensor memory in need */
+     dst_entry->tensor = tl_tensor_zeros(src_entry->tensor->ndim,
+                                         src_entry->tensor->dims,
+                                         src_entry->tensor->dtype);
+
+     priv = ln_alloc(sizeof(struct priv_s));
+     priv->src = src_entry->tensor;
+     priv->dst = dst_entry->tensor;
+     op_arg->priv = priv;
+}
+
+/*
+ * Normally we should only do the calculations here. Operations with memory
+ * and such should go in pre_run().
+ */
+static void copy_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+
+     /* both tensors are in host addressable memory */
+     priv = op_arg->priv;
+     memcpy(priv->dst->data, priv->src->data, tl_tensor_size(priv->src));
+}
+
+/*
+ * This function should free all tensor memory pre_run() allocated.
+ */
+static void copy_post_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+
+     /* free the tensor memory allocated in pre_run() */
+     priv = op_arg->priv;
+     tl_tensor_free_data_too(priv->dst);
+     ln_free(op_arg->priv);
+}
+
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void copy_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *src_entry, *dst_entry;
+
+     src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src");
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     cost->flops = 0;
+     cost->bytes_read = ln_tensor_entry_size(src_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void copy_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     struct priv_s *priv;
+
+     priv = op_arg->priv;
+     ln_compile_printf(ctx, "memcpy((%s)->data, (%s)->data, %lu);\n",
+                       ln_compile_tensor(ctx, priv->dst),
+                       ln_compile_tensor(ctx, priv->src),
+                       (unsigned long)tl_tensor_size(priv->src));
+}
+
+static ln_op_arg op_arg_copy = {
+     .optype = "copy",
+};
+
+/* struct used for op registration in ln_oplist.c */
+ln_op ln_opimpl_copy = {
+     .op_arg = &op_arg_copy,
+     .pre_run = copy_pre_run,
+     .run = copy_run,
+     .post_run = copy_post_run,
+     .cost = copy_cost,
+     .emit = copy_emit
+};
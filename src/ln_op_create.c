@@ -89,7 +89,7 @@ static void create_pre_run(ln_op_arg *op_arg, ln_error **error)
      dims_entry = ln_param_table_find_by_arg_name(op_arg->params, "dims");
      ln_op_check_param_exist(LN_ERROR, dims_entry, "dims");
      ln_op_check_param_type(LN_ERROR, dims_entry, LN_PARAM_ARRAY_NUMBER);
-     for (i = 0; i < dtype_entry->array_len; i++)
+     for (i = 0; i < dims_entry->array_len; i++)
           ln_op_check_param_satisfy_msg(LN_ERROR,
                                         dims_entry->value_array_int[i] > 0,
                                         "\"dims\" array elements should be positive");
@@ -125,6 +125,8 @@ static void create_pre_run(ln_op_arg *op_arg, ln_error **error)
           dst_entry->tensor = tl_tensor_create(NULL, dims_entry->array_len,
                                                dims_entry->value_array_int,
                                                dtype);
+     /* the data is only set here, so it must survive across runs */
+     dst_entry->isstatic = 1;
      op_arg->priv = dst_entry->tensor;
 }
 
@@ -152,6 +154,18 @@ static void create_post_run(ln_op_arg *op_arg, ln_error **error)
      tl_tensor_free_data_too(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void create_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     /* the data is set once in pre_run() */
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = 0;
+}
+
 static ln_op_arg op_arg_create = {
      .optype = "create",
 };
@@ -161,5 +175,6 @@ ln_op ln_opimpl_create = {
      .op_arg = &op_arg_create,
      .pre_run = create_pre_run,
      .run = create_run,
-     .post_run = create_post_run
+     .post_run = create_post_run,
+     .cost = create_cost
 };
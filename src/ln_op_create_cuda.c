@@ -125,6 +125,8 @@ static void create_cuda_pre_run(ln_op_arg *op_arg, ln_error **error)
           dst_entry->tensor = tl_tensor_create_cuda(NULL, dims_entry->array_len,
                                                     dims_entry->value_array_int,
                                                     dtype);
+     /* the data is only set here, so it must survive across runs */
+     dst_entry->isstatic = 1;
      op_arg->priv = dst_entry->tensor;
 }
 
@@ -152,6 +154,18 @@ static void create_cuda_post_run(ln_op_arg *op_arg, ln_error **error)
      tl_tensor_free_data_too_cuda(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void create_cuda_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     /* the data is set once in pre_run() */
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = 0;
+}
+
 static ln_op_arg op_arg_create_cuda = {
      .optype = "create_cuda",
 };
@@ -161,5 +175,6 @@ ln_op ln_opimpl_create_cuda = {
      .op_arg = &op_arg_create_cuda,
      .pre_run = create_cuda_pre_run,
      .run = create_cuda_run,
-     .post_run = create_cuda_post_run
+     .post_run = create_cuda_post_run,
+     .cost = create_cuda_cost
 };
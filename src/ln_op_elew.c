@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include "ln_op.h"
+#include "ln_compile.h"
 
 static tl_elew_op k2v(char *str)
 {
@@ -97,6 +98,8 @@ static void elew_pre_run(ln_op_arg *op_arg, ln_error **error)
      dst_entry->tensor = tl_tensor_zeros(src1_entry->tensor->ndim,
                                          src2_entry->tensor->dims,
                                          src1_entry->tensor->dtype);
+     /* elementwise ops can write "dst" over "src1" if "src1" dies here */
+     dst_entry->inplace = ln_strdup(src1_entry->name);
 
      /* use op_arg->priv to store private data
         to be used directly in elew_run() */
@@ -134,6 +137,43 @@ static void elew_post_run(ln_op_arg *op_arg, ln_error **error)
      ln_free(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void elew_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *src1_entry, *src2_entry, *dst_entry;
+
+     src1_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src1");
+     src2_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src2");
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     /* one operation per element */
+     cost->flops = dst_entry->tensor->len;
+     cost->bytes_read = ln_tensor_entry_size(src1_entry)
+          + ln_tensor_entry_size(src2_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void elew_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     ln_param_entry *elew_op_entry;
+     struct priv_s *priv;
+
+     priv = op_arg->priv;
+     elew_op_entry = ln_param_table_find_by_arg_name(op_arg->params, "elew_op");
+     ln_compile_printf(ctx, "tl_tensor_elew(%s, %s, %s, %s);\n",
+                       ln_compile_tensor(ctx, priv->src1),
+                       ln_compile_tensor(ctx, priv->src2),
+                       ln_compile_tensor(ctx, priv->dst),
+                       elew_op_entry->value_string);
+}
+
 static ln_op_arg op_arg_elew = {
      .optype = "elew",
 };
@@ -143,5 +183,7 @@ ln_op ln_opimpl_elew = {
      .op_arg = &op_arg_elew,
      .pre_run = elew_pre_run,
      .run = elew_run,
-     .post_run = elew_post_run
+     .post_run = elew_post_run,
+     .cost = elew_cost,
+     .emit = elew_emit
 };
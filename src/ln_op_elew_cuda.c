@@ -57,6 +57,25 @@ static void elew_cuda_post_run(ln_op_arg *op_arg, ln_error **error)
      /* ..... */
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void elew_cuda_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *src1_entry, *src2_entry, *dst_entry;
+
+     src1_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src1");
+     src2_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src2");
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     /* one operation per element */
+     cost->flops = dst_entry->tensor->len;
+     cost->bytes_read = ln_tensor_entry_size(src1_entry)
+          + ln_tensor_entry_size(src2_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
 static ln_op_arg op_arg_elew_cuda = {
      .optype = "elew_cuda",
 };
@@ -66,5 +85,6 @@ ln_op ln_opimpl_elew_cuda = {
      .op_arg = &op_arg_elew_cuda,
      .pre_run = elew_cuda_pre_run,
      .run = elew_cuda_run,
-     .post_run = elew_cuda_post_run
+     .post_run = elew_cuda_post_run,
+     .cost = elew_cuda_cost
 };
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "ln_op.h"
+#include "ln_jit.h"
+#include "ln_compile.h"
+
+static tl_elew_op k2v(char *str)
+{
+     if (!strcmp(str, "TL_MUL"))
+          return TL_MUL;
+     if (!strcmp(str, "TL_DIV"))
+          return TL_DIV;
+     if (!strcmp(str, "TL_SUM"))
+          return TL_SUM;
+     if (!strcmp(str, "TL_SUB"))
+          return TL_SUB;
+     if (!strcmp(str, "TL_MAX"))
+          return TL_MAX;
+     if (!strcmp(str, "TL_MIN"))
+          return TL_MIN;
+     if (!strcmp(str, "TL_POW"))
+          return TL_POW;
+     return -1;
+}
+
+struct priv_s {
+     tl_tensor   **srcs;
+     tl_tensor    *dst;
+     ln_jit_prog   prog;
+     ln_jit_func   func;
+     const float **src_data;
+     float        *work;
+};
+
+/*
+ * An operand of a node: "sK" is source K and "nK" the value of node K,
+ * which should come before. Returns -1 if str isn't one.
+ */
+static int parse_operand(const char *str, int n_in, int node)
+{
+     char *end;
+     long k;
+
+     if (str[0] != 's' && str[0] != 'n')
+          return -1;
+     k = strtol(str + 1, &end, 10);
+     if (end == str + 1 || *end != '\0' || k < 0)
+          return -1;
+     if (str[0] == 's')
+          return k < n_in ? k : -1;
+     return k < node ? n_in + k : -1;
+}
+
+static int parse_node(const char *str, int n_in, int node, ln_jit_node *res)
+{
+     char op[16], a[16], b[16];
+
+     if (sscanf(str, "%15s %15s %15s", op, a, b) != 3)
+          return 0;
+     res->op = k2v(op);
+     res->a = parse_operand(a, n_in, node);
+     res->b = parse_operand(b, n_in, node);
+     return res->op != -1 && res->a >= 0 && res->b >= 0;
+}
+
+/*
+ * "expr" is the fused expression, one node per string, such as
+ * ["TL_MUL s0 s1", "TL_SUM n0 s2"] for src0 * src1 + src2; the last node
+ * is "dst".
+ */
+static void elew_fused_pre_run(ln_op_arg *op_arg, ln_error **error)
+{
+     ln_tensor_entry *src_entry, *src0_entry, *dst_entry;
+     ln_param_entry *expr_entry;
+     int tensors_n, params_n, n_in, i;
+     char arg_name[32];
+     char *signature, *p;
+     size_t size;
+     struct priv_s *priv;
+     ln_jit_node *nodes;
+
+     /* check tensors and parameters */
+     n_in = ln_tensor_table_length(op_arg->tensors_in);
+     ln_op_check_tensor_in_len_gt(LN_ERROR, n_in, 0);
+
+     tensors_n = ln_tensor_table_length(op_arg->tensors_out);
+     ln_op_check_tensor_out_len_eq(LN_ERROR, tensors_n, 1);
+
+     src0_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src0");
+     ln_op_check_tensor_in_exist(LN_ERROR, src0_entry, "src0");
+     ln_op_check_tensor_defined(LN_ERROR, src0_entry);
+     ln_op_check_tensor_satisfy_msg(LN_ERROR,
+                                    src0_entry->tensor->dtype == TL_FLOAT,
+                                    "\"src0\" should be TL_FLOAT");
+     for (i = 1; i < n_in; i++) {
+          snprintf(arg_name, sizeof(arg_name), "src%d", i);
+          src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in,
+                                                       arg_name);
+          ln_op_check_tensor_in_exist(LN_ERROR, src_entry, arg_name);
+          ln_op_check_tensor_defined(LN_ERROR, src_entry);
+          ln_op_check_tensor_issameshape(LN_ERROR, src0_entry, src_entry);
+          ln_op_check_tensor_issametype(LN_ERROR, src0_entry, src_entry);
+     }
+
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+     ln_op_check_tensor_out_exist(LN_ERROR, dst_entry, "dst");
+     ln_op_check_tensor_not_defined(LN_ERROR, dst_entry);
+
+     params_n = ln_param_table_length(op_arg->params);
+     ln_op_check_param_len_eq(LN_ERROR, params_n, 1);
+
+     expr_entry = ln_param_table_find_by_arg_name(op_arg->params, "expr");
+     ln_op_check_param_exist(LN_ERROR, expr_entry, "expr");
+     ln_op_check_param_type(LN_ERROR, expr_entry, LN_PARAM_ARRAY_STRING);
+     ln_op_check_param_satisfy_msg(LN_ERROR, expr_entry->array_len > 0,
+                                   "\"expr\" param should have at least one node");
+
+     nodes = ln_alloc(sizeof(ln_jit_node) * expr_entry->array_len);
+     for (i = 0; i < expr_entry->array_len; i++) {
+          if (parse_node(expr_entry->value_array_string[i], n_in, i,
+                         &nodes[i]))
+               continue;
+          ln_free(nodes);
+          ln_op_check_param_satisfy_msg(LN_ERROR, 0,
+                                        "\"expr\" param should be nodes like \"TL_MUL s0 n1\", of a supported tl_elew_op, sources and earlier nodes");
+     }
+
+     /* allocate tensor memory in need */
+     dst_entry->tensor = tl_tensor_zeros(src0_entry->tensor->ndim,
+                                         src0_entry->tensor->dims,
+                                         src0_entry->tensor->dtype);
+     dst_entry->inplace = ln_strdup(src0_entry->name);
+
+     priv = ln_alloc(sizeof(struct priv_s));
+     priv->srcs = ln_alloc(sizeof(tl_tensor *) * n_in);
+     priv->src_data = ln_alloc(sizeof(float *) * n_in);
+     for (i = 0; i < n_in; i++) {
+          snprintf(arg_name, sizeof(arg_name), "src%d", i);
+          src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in,
+                                                       arg_name);
+          priv->srcs[i] = src_entry->tensor;
+     }
+     priv->dst = dst_entry->tensor;
+     priv->prog.n_in = n_in;
+     priv->prog.n_nodes = expr_entry->array_len;
+     priv->prog.nodes = nodes;
+     priv->work = ln_alloc(sizeof(float) * LN_JIT_BLOCK * priv->prog.n_nodes);
+
+     /* compile the expression once for all ops of the same signature */
+     size = 16;
+     for (i = 0; i < expr_entry->array_len; i++)
+          size += strlen(expr_entry->value_array_string[i]) + 1;
+     signature = ln_alloc(size);
+     p = signature + sprintf(signature, "%d", n_in);
+     for (i = 0; i < expr_entry->array_len; i++)
+          p += sprintf(p, ";%s", expr_entry->value_array_string[i]);
+     priv->func = ln_jit_compile(&priv->prog, signature);
+     ln_free(signature);
+
+     op_arg->priv = priv;
+}
+
+/*
+ * Normally we should only do the calculations here. Operations with memory
+ * and such should go in pre_run().
+ */
+static void elew_fused_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+     int i;
+
+     /* the tensor data may move between pre_run() and run() */
+     priv = op_arg->priv;
+     for (i = 0; i < priv->prog.n_in; i++)
+          priv->src_data[i] = priv->srcs[i]->data;
+     ln_jit_run(&priv->prog, priv->func, priv->src_data, priv->dst->data,
+                priv->dst->len, priv->work);
+}
+
+/*
+ * This function should free all tensor memory pre_run() allocated.
+ */
+static void elew_fused_post_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+
+     /* free the memory allocated in pre_run() */
+     priv = op_arg->priv;
+     tl_tensor_free_data_too(priv->dst);
+     ln_free(priv->srcs);
+     ln_free(priv->src_data);
+     ln_free(priv->prog.nodes);
+     ln_free(priv->work);
+     ln_free(op_arg->priv);
+}
+
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void elew_fused_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *dst_entry;
+     ln_param_entry *expr_entry;
+     ln_list *l;
+
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+     expr_entry = ln_param_table_find_by_arg_name(op_arg->params, "expr");
+
+     /* one operation per element and node, and no intermediate tensors */
+     cost->flops = (double)dst_entry->tensor->len * expr_entry->array_len;
+     cost->bytes_read = 0;
+     for (l = op_arg->tensors_in; l; l = l->next)
+          cost->bytes_read += ln_tensor_entry_size(l->data);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+static void emit_operand(ln_compile_ctx *ctx, const ln_jit_prog *prog, int x)
+{
+     if (x < prog->n_in)
+          ln_compile_printf(ctx, "s%d[i]", x);
+     else
+          ln_compile_printf(ctx, "n%d", x - prog->n_in);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void elew_fused_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     static const char *infix[] = {
+          [TL_MUL] = " * ", [TL_DIV] = " / ", [TL_SUM] = " + ",
+          [TL_SUB] = " - "
+     };
+     const ln_jit_node *node;
+     struct priv_s *priv;
+     int i, k;
+
+     priv = op_arg->priv;
+     ln_compile_printf(ctx, "{\n");
+     for (i = 0; i < priv->prog.n_in; i++)
+          ln_compile_printf(ctx, "     const float *s%d = (%s)->data;\n", i,
+                            ln_compile_tensor(ctx, priv->srcs[i]));
+     ln_compile_printf(ctx, "     float *d = (%s)->data;\n",
+                       ln_compile_tensor(ctx, priv->dst));
+     ln_compile_printf(ctx, "     size_t i;\n\n");
+     ln_compile_printf(ctx, "     for (i = 0; i < %d; i++) {\n",
+                       priv->dst->len);
+     for (k = 0; k < priv->prog.n_nodes; k++) {
+          node = &priv->prog.nodes[k];
+          if (k == priv->prog.n_nodes - 1)
+               ln_compile_printf(ctx, "          d[i] = ");
+          else
+               ln_compile_printf(ctx, "          float n%d = ", k);
+          switch (node->op) {
+          case TL_MAX:
+          case TL_MIN:
+               ln_compile_printf(ctx, "(");
+               emit_operand(ctx, &priv->prog, node->a);
+               ln_compile_printf(ctx, node->op == TL_MAX ? " > " : " < ");
+               emit_operand(ctx, &priv->prog, node->b);
+               ln_compile_printf(ctx, ") ? ");
+               emit_operand(ctx, &priv->prog, node->a);
+               ln_compile_printf(ctx, " : ");
+               emit_operand(ctx, &priv->prog, node->b);
+               break;
+          case TL_POW:
+               ln_compile_printf(ctx, "powf(");
+               emit_operand(ctx, &priv->prog, node->a);
+               ln_compile_printf(ctx, ", ");
+               emit_operand(ctx, &priv->prog, node->b);
+               ln_compile_printf(ctx, ")");
+               break;
+          default:
+               emit_operand(ctx, &priv->prog, node->a);
+               ln_compile_printf(ctx, "%s", infix[node->op]);
+               emit_operand(ctx, &priv->prog, node->b);
+               break;
+          }
+          ln_compile_printf(ctx, ";\n");
+     }
+     ln_compile_printf(ctx, "     }\n}\n");
+}
+
+static ln_op_arg op_arg_elew_fused = {
+     .optype = "elew_fused",
+};
+
+/* struct used for op registration in ln_oplist.c */
+ln_op ln_opimpl_elew_fused = {
+     .op_arg = &op_arg_elew_fused,
+     .pre_run = elew_fused_pre_run,
+     .run = elew_fused_run,
+     .post_run = elew_fused_post_run,
+     .cost = elew_fused_cost,
+     .emit = elew_fused_emit
+};
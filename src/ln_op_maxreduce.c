@@ -22,12 +22,19 @@
 
 #include <assert.h>
 #include "ln_op.h"
+#include "ln_compile.h"
+#include "ln_kernel.h"
 
 struct priv_s {
-     tl_tensor *src;
-     tl_tensor *dst;
-     tl_tensor *arg;
-     int        axis;
+     tl_tensor                *src;
+     tl_tensor                *dst;
+     tl_tensor                *arg;
+     ln_tensor_entry          *arg_entry;
+     int                       axis;
+     int                       outer;
+     int                       inner;
+     ln_kernel_maxreduce_func  kernel;
+     ln_kernel_maxreduce_func  kernel_arg;
 };
 
 /*
@@ -38,7 +45,7 @@ static void maxreduce_pre_run(ln_op_arg *op_arg, ln_error **error)
      ln_tensor_entry *src_entry, *dst_entry, *arg_entry;
      ln_param_entry *axis_entry;
      int tensors_n, params_n;
-     int axis;
+     int axis, i;
      struct priv_s *priv;
 
      /* check tensors and parameters */
@@ -84,7 +91,21 @@ static void maxreduce_pre_run(ln_op_arg *op_arg, ln_error **error)
      priv->src = src_entry->tensor;
      priv->dst = dst_entry->tensor;
      priv->arg = arg_entry ? arg_entry->tensor : NULL;
+     priv->arg_entry = arg_entry;
      priv->axis = axis;
+
+     /* pick the kernels specialized for the dtype and the reduced axis,
+        with "src" taken as [outer, dims[axis], inner] */
+     priv->outer = 1;
+     for (i = 0; i < axis; i++)
+          priv->outer *= src_entry->tensor->dims[i];
+     priv->inner = 1;
+     for (i = axis + 1; i < src_entry->tensor->ndim; i++)
+          priv->inner *= src_entry->tensor->dims[i];
+     priv->kernel = ln_kernel_maxreduce_find(src_entry->tensor->dtype,
+                                             priv->inner == 1, 0);
+     priv->kernel_arg = ln_kernel_maxreduce_find(src_entry->tensor->dtype,
+                                                 priv->inner == 1, 1);
      op_arg->priv = priv;
 }
 
@@ -98,7 +119,39 @@ static void maxreduce_run(ln_op_arg *op_arg, ln_error **error)
 
      /* do the real work */
      priv = op_arg->priv;
-     tl_tensor_maxreduce(priv->src, priv->dst, priv->arg, priv->axis);
+     if (priv->kernel) {
+          /* skip the argmax if no one reads "arg" */
+          if (!priv->arg || priv->arg_entry->isdead)
+               priv->kernel(priv->src->data, priv->dst->data, NULL,
+                            priv->outer, priv->src->dims[priv->axis],
+                            priv->inner);
+          else
+               priv->kernel_arg(priv->src->data, priv->dst->data,
+                                priv->arg->data, priv->outer,
+                                priv->src->dims[priv->axis], priv->inner);
+          return;
+     }
+     /* skip the argmax if no one reads "arg" */
+     if (priv->arg_entry && priv->arg_entry->isdead)
+          tl_tensor_maxreduce(priv->src, priv->dst, NULL, priv->axis);
+     else
+          tl_tensor_maxreduce(priv->src, priv->dst, priv->arg, priv->axis);
+}
+
+/*
+ * Another run() calling TensorLight's generic maxreduce, which handles any
+ * axis with index math per element.
+ */
+static void maxreduce_tl_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+
+     priv = op_arg->priv;
+     /* skip the argmax if no one reads "arg" */
+     if (priv->arg_entry && priv->arg_entry->isdead)
+          tl_tensor_maxreduce(priv->src, priv->dst, NULL, priv->axis);
+     else
+          tl_tensor_maxreduce(priv->src, priv->dst, priv->arg, priv->axis);
 }
 
 /*
@@ -115,6 +168,50 @@ static void maxreduce_post_run(ln_op_arg *op_arg, ln_error **error)
      ln_free(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void maxreduce_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *src_entry, *dst_entry, *arg_entry;
+
+     src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src");
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+     arg_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "arg");
+
+     /* one comparison per source element */
+     cost->flops = src_entry->tensor->len;
+     cost->bytes_read = ln_tensor_entry_size(src_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+     if (arg_entry && !arg_entry->isdead)
+          cost->bytes_written += ln_tensor_entry_size(arg_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void maxreduce_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     struct priv_s *priv;
+
+     priv = op_arg->priv;
+     /* skip the argmax if no one reads "arg" */
+     ln_compile_printf(ctx, "tl_tensor_maxreduce(%s, %s, %s, %d);\n",
+                       ln_compile_tensor(ctx, priv->src),
+                       ln_compile_tensor(ctx, priv->dst),
+                       !priv->arg || priv->arg_entry->isdead ? "NULL"
+                       : ln_compile_tensor(ctx, priv->arg),
+                       priv->axis);
+}
+
+static const ln_op_variant maxreduce_variants[] = {
+     {"kernel", maxreduce_run},
+     {"tl", maxreduce_tl_run},
+     {NULL, NULL}
+};
+
 static ln_op_arg op_arg_maxreduce = {
      .optype = "maxreduce",
 };
@@ -124,5 +221,8 @@ ln_op ln_opimpl_maxreduce = {
      .op_arg = &op_arg_maxreduce,
      .pre_run = maxreduce_pre_run,
      .run = maxreduce_run,
-     .post_run = maxreduce_post_run
+     .post_run = maxreduce_post_run,
+     .cost = maxreduce_cost,
+     .variants = maxreduce_variants,
+     .emit = maxreduce_emit
 };
@@ -78,6 +78,8 @@ static void reshape_pre_run(ln_op_arg *op_arg, ln_error **error)
 
      /* Allocate memory in need. */
      dst_entry->tensor = tl_tensor_reshape(src_entry->tensor, ndim, dims);
+     /* "dst" is a view of "src", so memory planner won't allocate it */
+     dst_entry->owner = ln_strdup(src_entry->name);
 
      op_arg->priv = dst_entry->tensor;
 }
@@ -104,6 +106,18 @@ static void reshape_post_run(ln_op_arg *op_arg, ln_error **error)
      tl_tensor_free(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void reshape_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     /* "dst" shares the data of "src", nothing is moved */
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = 0;
+}
+
 static ln_op_arg op_arg_reshape = {
      .optype = "reshape",
 };
@@ -112,5 +126,6 @@ ln_op ln_opimpl_reshape = {
      .op_arg = &op_arg_reshape,
      .pre_run = reshape_pre_run,
      .run = reshape_run,
-     .post_run = reshape_post_run
+     .post_run = reshape_post_run,
+     .cost = reshape_cost
 };
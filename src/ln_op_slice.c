@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include "ln_op.h"
+#include "ln_compile.h"
 
 struct priv_s {
      tl_tensor *src;
@@ -123,6 +124,37 @@ static void slice_post_run(ln_op_arg *op_arg, ln_error **error)
      ln_free(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void slice_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *dst_entry;
+
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     /* only the sliced part of "src" is read */
+     cost->flops = 0;
+     cost->bytes_read = ln_tensor_entry_size(dst_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void slice_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     struct priv_s *priv;
+
+     priv = op_arg->priv;
+     ln_compile_printf(ctx, "tl_tensor_slice(%s, %s, %d, %d, %d);\n",
+                       ln_compile_tensor(ctx, priv->src),
+                       ln_compile_tensor(ctx, priv->dst),
+                       priv->axis, priv->start, priv->len);
+}
+
 static ln_op_arg op_arg_slice = {
      .optype = "slice",
 };
@@ -132,5 +164,7 @@ ln_op ln_opimpl_slice = {
      .op_arg = &op_arg_slice,
      .pre_run = slice_pre_run,
      .run = slice_run,
-     .post_run = slice_post_run
+     .post_run = slice_post_run,
+     .cost = slice_cost,
+     .emit = slice_emit
 };
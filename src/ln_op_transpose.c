@@ -21,13 +21,20 @@
  */
 
 #include <assert.h>
+#include <string.h>
+#include <stdint.h>
 #include "ln_op.h"
+#include "ln_compile.h"
+#include "ln_kernel.h"
+
+#define GATHER_MAXDIM 16
 
 struct priv_s {
-     tl_tensor *src;
-     tl_tensor *dst;
-     int       *axes;
-     tl_tensor *workspace;
+     tl_tensor           *src;
+     tl_tensor           *dst;
+     int                 *axes;
+     tl_tensor           *workspace;
+     ln_kernel_transpose  kernel;
 };
 
 /*
@@ -90,6 +97,8 @@ static void transpose_pre_run(ln_op_arg *op_arg, ln_error **error)
      priv->dst = dst_entry->tensor;
      priv->axes = axes;
      priv->workspace = workspace;
+     /* pick the kernel specialized for the element size and merged rank */
+     ln_kernel_transpose_plan(&priv->kernel, priv->src, axes);
      op_arg->priv = priv;
 }
 
@@ -102,10 +111,89 @@ static void transpose_run(ln_op_arg *op_arg, ln_error **error)
      struct priv_s *priv;
 
      /* do the real work */
+     priv = op_arg->priv;
+     if (priv->kernel.func)
+          ln_kernel_transpose_run(&priv->kernel, priv->src, priv->dst);
+     else
+          tl_tensor_transpose(priv->src, priv->dst, priv->axes,
+                              priv->workspace);
+}
+
+/*
+ * Another run() calling TensorLight's generic transpose, which handles any
+ * rank with index math per element.
+ */
+static void transpose_tl_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+
      priv = op_arg->priv;
      tl_tensor_transpose(priv->src, priv->dst, priv->axes, priv->workspace);
 }
 
+/*
+ * Another run() walking "dst" in order and gathering from "src" by strides,
+ * without the workspace. Which one is faster depends on the shape and the
+ * machine; the autotuner chooses.
+ */
+static void transpose_gather_run(ln_op_arg *op_arg, ln_error **error)
+{
+     struct priv_s *priv;
+     size_t strides[GATHER_MAXDIM], steps[GATHER_MAXDIM];
+     int idx[GATHER_MAXDIM];
+     size_t size, offset, stride;
+     int ndim, i, n;
+     char *src, *dst;
+
+     priv = op_arg->priv;
+     ndim = priv->src->ndim;
+     if (ndim > GATHER_MAXDIM) {
+          tl_tensor_transpose(priv->src, priv->dst, priv->axes,
+                              priv->workspace);
+          return;
+     }
+
+     for (i = ndim - 1, stride = 1; i >= 0; i--) {
+          strides[i] = stride;
+          stride *= priv->src->dims[i];
+     }
+     for (i = 0; i < ndim; i++) {
+          steps[i] = strides[priv->axes[i]];
+          idx[i] = 0;
+     }
+
+     size = tl_size_of(priv->src->dtype);
+     src = priv->src->data;
+     dst = priv->dst->data;
+     offset = 0;
+     for (n = 0; n < priv->dst->len; n++) {
+          switch (size) {
+          case 1:
+               ((uint8_t *)dst)[n] = ((uint8_t *)src)[offset];
+               break;
+          case 2:
+               ((uint16_t *)dst)[n] = ((uint16_t *)src)[offset];
+               break;
+          case 4:
+               ((uint32_t *)dst)[n] = ((uint32_t *)src)[offset];
+               break;
+          case 8:
+               ((uint64_t *)dst)[n] = ((uint64_t *)src)[offset];
+               break;
+          default:
+               memcpy(dst + n * size, src + offset * size, size);
+               break;
+          }
+          for (i = ndim - 1; i >= 0; i--) {
+               offset += steps[i];
+               if (++idx[i] < priv->dst->dims[i])
+                    break;
+               offset -= steps[i] * priv->dst->dims[i];
+               idx[i] = 0;
+          }
+     }
+}
+
 /*
  * This function should free all tensor memory pre_run() allocated.
  */
@@ -120,6 +208,48 @@ static void transpose_post_run(ln_op_arg *op_arg, ln_error **error)
      ln_free(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void transpose_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *src_entry, *dst_entry;
+
+     src_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_in, "src");
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     cost->flops = 0;
+     cost->bytes_read = ln_tensor_entry_size(src_entry);
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void transpose_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     struct priv_s *priv;
+     int i;
+
+     priv = op_arg->priv;
+     ln_compile_printf(ctx, "tl_tensor_transpose(%s, %s, (int[]){",
+                       ln_compile_tensor(ctx, priv->src),
+                       ln_compile_tensor(ctx, priv->dst));
+     for (i = 0; i < priv->src->ndim; i++)
+          ln_compile_printf(ctx, i ? ", %d" : "%d", priv->axes[i]);
+     ln_compile_printf(ctx, "}, %s);\n",
+                       ln_compile_tensor(ctx, priv->workspace));
+}
+
+static const ln_op_variant transpose_variants[] = {
+     {"kernel", transpose_run},
+     {"tl", transpose_tl_run},
+     {"gather", transpose_gather_run},
+     {NULL, NULL}
+};
+
 static ln_op_arg op_arg_transpose = {
      .optype = "transpose",
 };
@@ -129,5 +259,8 @@ ln_op ln_opimpl_transpose = {
      .op_arg = &op_arg_transpose,
      .pre_run = transpose_pre_run,
      .run = transpose_run,
-     .post_run = transpose_post_run
+     .post_run = transpose_post_run,
+     .cost = transpose_cost,
+     .variants = transpose_variants,
+     .emit = transpose_emit
 };
@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include "ln_op.h"
+#include "ln_compile.h"
 
 static int k2v(char *str)
 {
@@ -80,7 +81,7 @@ static void zeros_pre_run(ln_op_arg *op_arg, ln_error **error)
      dims_entry = ln_param_table_find_by_arg_name(op_arg->params, "dims");
      ln_op_check_param_exist(LN_ERROR, dims_entry, "dims");
      ln_op_check_param_type(LN_ERROR, dims_entry, LN_PARAM_ARRAY_NUMBER);
-     for (i = 0; i < dtype_entry->array_len; i++)
+     for (i = 0; i < dims_entry->array_len; i++)
           ln_op_check_param_satisfy_msg(LN_ERROR,
                                         dims_entry->value_array_int[i] > 0,
                                         "\"dims\" array elements should be positive");
@@ -115,6 +116,35 @@ static void zeros_post_run(ln_op_arg *op_arg, ln_error **error)
      tl_tensor_free_data_too(op_arg->priv);
 }
 
+/*
+ * This function should fill the work done by one run(), from the tensors
+ * allocated in pre_run().
+ */
+static void zeros_cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     ln_tensor_entry *dst_entry;
+
+     dst_entry = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+
+     cost->flops = 0;
+     cost->bytes_read = 0;
+     cost->bytes_written = ln_tensor_entry_size(dst_entry);
+}
+
+/*
+ * This function should write the C statements of one run() to ctx, from the
+ * tensors allocated in pre_run().
+ */
+static void zeros_emit(ln_op_arg *op_arg, ln_compile_ctx *ctx)
+{
+     tl_tensor *dst;
+
+     dst = op_arg->priv;
+     ln_compile_printf(ctx, "memset((%s)->data, 0, %lu);\n",
+                       ln_compile_tensor(ctx, dst),
+                       (unsigned long)(dst->len*tl_size_of(dst->dtype)));
+}
+
 static ln_op_arg op_arg_zeros = {
      .optype = "zeros",
 };
@@ -124,5 +154,7 @@ ln_op ln_opimpl_zeros = {
      .op_arg = &op_arg_zeros,
      .pre_run = zeros_pre_run,
      .run = zeros_run,
-     .post_run = zeros_post_run
+     .post_run = zeros_post_run,
+     .cost = zeros_cost,
+     .emit = zeros_emit
 };
@@ -27,9 +27,13 @@ extern ln_op ln_opimpl_slice;
 extern ln_op ln_opimpl_reshape;
 extern ln_op ln_opimpl_maxreduce;
 extern ln_op ln_opimpl_elew;
+extern ln_op ln_opimpl_elew_fused;
 extern ln_op ln_opimpl_transpose;
 extern ln_op ln_opimpl_zeros;
 extern ln_op ln_opimpl_create;
+extern ln_op ln_opimpl_copy;
+extern ln_op ln_opimpl_elew_sim;
+extern ln_op ln_opimpl_copy_sim;
 extern ln_op ln_opimpl_create_cuda;
 extern ln_op ln_opimpl_elew_cuda;
 /* end of declarations */
@@ -39,9 +43,13 @@ ln_op *ln_init_ops[] = {
      &ln_opimpl_reshape,
      &ln_opimpl_maxreduce,
      &ln_opimpl_elew,
+     &ln_opimpl_elew_fused,
      &ln_opimpl_transpose,
      &ln_opimpl_zeros,
      &ln_opimpl_create,
+     &ln_opimpl_copy,
+     &ln_opimpl_elew_sim,
+     &ln_opimpl_copy_sim,
 #ifdef LN_CUDA
      &ln_opimpl_create_cuda,
      &ln_opimpl_elew_cuda,
@@ -20,91 +20,3227 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include "ln_optimize.h"
 
-static inline void use_count_zero(ln_hash *use_counts, char *name)
+extern ln_op ln_opimpl_create;
+
+/*
+ * Use counts, live buffers and current definitions are keyed by the output
+ * entry defining a tensor, since a tensor may be defined again by a
+ * recompute op, which starts a new live range.
+ */
+static inline void use_count_zero(ln_hash *use_counts, ln_tensor_entry *def)
 {
-     ln_hash_insert(use_counts, name, (void *)0);
+     ln_hash_insert(use_counts, def, (void *)0);
 }
 
-static inline ssize_t use_count_inc(ln_hash *use_counts, char *name)
+static inline ssize_t use_count_inc(ln_hash *use_counts, ln_tensor_entry *def)
 {
      int found;
      ssize_t uc;
 
-     found = ln_hash_find_extended(use_counts, name, (void **)&uc);
+     found = ln_hash_find_extended(use_counts, def, (void **)&uc);
      assert(found);
-     ln_hash_insert(use_counts, name, (void *)(uc+1));
-     return uc;
+     ln_hash_insert(use_counts, def, (void *)(uc+1));
+     return uc+1;
+}
+
+static inline ssize_t use_count_dec(ln_hash *use_counts, ln_tensor_entry *def)
+{
+     int found;
+     ssize_t uc;
+
+     found = ln_hash_find_extended(use_counts, def, (void **)&uc);
+     assert(found);
+     ln_hash_insert(use_counts, def, (void *)(uc-1));
+     assert(uc-1 >= 0);
+     return uc-1;
 }
 
-static inline ssize_t use_count_dec(ln_hash *use_counts, char *name)
+static inline ssize_t use_count_get(ln_hash *use_counts, ln_tensor_entry *def)
 {
      int found;
      ssize_t uc;
 
-     found = ln_hash_find_extended(use_counts, name, (void **)&uc);
+     found = ln_hash_find_extended(use_counts, def, (void **)&uc);
      assert(found);
-     ln_hash_insert(use_counts, name, (void *)(uc-1));
-     assert(uc >= 0);
      return uc;
 }
 
+static ln_mem_pool *find_mem_pool(ln_hash *mem_pools, ln_mem_type mtype)
+{
+     ln_mem_pool *mp;
+
+     /* tensors that haven't been placed anywhere live in host memory */
+     if (mtype == LN_MEM_UNDEFINED)
+          mtype = LN_MEM_CPU;
+     mp = ln_hash_find(mem_pools, (void *)mtype);
+     assert(mp && "no memory pool for the tensor's ln_mem_type");
+     return mp;
+}
+
+/* the tensor that owns the data of a view, or name itself if it isn't a view */
+static char *root_name(ln_hash *roots, char *name)
+{
+     char *root;
+
+     root = ln_hash_find(roots, name);
+     return root ? root : name;
+}
+
+/* the current definition of the data of tensor name, or NULL */
+static ln_tensor_entry *find_def(ln_hash *defs, ln_hash *roots, char *name)
+{
+     return ln_hash_find(defs, root_name(roots, name));
+}
+
+/*
+ * Return the input entry of op whose memory out_te can take over, or NULL.
+ * That input must be backed by a planned buffer in the same pool that is big
+ * enough, and this op must be the last user of the buffer through any of its
+ * views.
+ */
+static ln_tensor_entry *find_inplace_src(ln_op *op, ln_tensor_entry *out_te,
+                                         ln_hash *use_counts, ln_hash *buffers,
+                                         ln_hash *defs, ln_hash *roots)
+{
+     ln_tensor_entry *in_te, *te, *def;
+     ssize_t uses_here;
+
+     if (!out_te->inplace)
+          return NULL;
+     in_te = ln_tensor_table_find_by_name(op->op_arg->tensors_in,
+                                          out_te->inplace);
+     if (!in_te)
+          return NULL;
+     def = find_def(defs, roots, in_te->name);
+     if (!def || !ln_hash_find_extended(buffers, def, NULL))
+          return NULL;
+     if (in_te->mtype != out_te->mtype
+         || tl_tensor_size(in_te->tensor) < tl_tensor_size(out_te->tensor))
+          return NULL;
+
+     uses_here = 0;
+     LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+          if (find_def(defs, roots, te->name) == def)
+               uses_here++;
+     }
+     if (use_count_get(use_counts, def) != uses_here)
+          return NULL;
+
+     return in_te;
+}
+
+/* whether op copies a tensor from one memory type to another */
+static int is_transfer(ln_op *op)
+{
+     ln_tensor_entry *in_te, *out_te;
+
+     LN_LIST_FOREACH(in_te, op->op_arg->tensors_in) {
+          LN_LIST_FOREACH(out_te, op->op_arg->tensors_out) {
+               if (in_te->mtype != LN_MEM_UNDEFINED
+                   && out_te->mtype != LN_MEM_UNDEFINED
+                   && in_te->mtype != out_te->mtype)
+                    return 1;
+          }
+     }
+     return 0;
+}
+
+static void free_buffer(ln_hash *buffers, ln_hash *mem_pools,
+                        ln_tensor_entry *def)
+{
+     size_t offset;
+
+     /* its buffer may have been taken over by an in-place output */
+     if (!ln_hash_find_extended(buffers, def, (void **)&offset))
+          return;
+     ln_mem_free(find_mem_pool(mem_pools, def->mtype), offset);
+     ln_hash_remove(buffers, def);
+}
+
+/*
+ * Plan the memory of tensors created by ops in the op list. mem_pools maps
+ * ln_mem_type to ln_mem_pool. Planned addresses are stored in the tensor
+ * entries' offset fields. Tensors that aren't created by any op in ops are
+ * left alone, and so are static tensors, whose data is set in pre_run, and
+ * dead tensors, which their ops don't compute.
+ *
+ * A view (an output with an owner) is never allocated or freed by itself; it
+ * gets the address of the tensor owning its data, and uses of the view keep
+ * that tensor alive. An output declaring an "inplace" input reuses the
+ * buffer of that input if the buffer dies at that op. A tensor defined
+ * again gets a new buffer, and the uses after that read the new one.
+ *
+ * A transfer, an op copying a tensor between memory types, may run while
+ * the op before it still runs, so the buffers dying at that op are only
+ * freed after the transfers following it. The staging buffers transfers
+ * write are thus apart from those of the overlapped op: double-buffered.
+ */
 ln_list *ln_optimize_mem(ln_list *ops, ln_hash *mem_pools)
 {
      ln_op *op;
-     ln_hash *use_counts;
-     ln_tensor_entry *te;
-     tl_tensor *t;
-     ln_mem_pool *mp;
-     ln_list *unused_tes;
+     ln_hash *use_counts;       /* definition -> number of uses */
+     ln_hash *roots;            /* view name -> name of the data owner */
+     ln_hash *defs;             /* root name -> current definition */
+     ln_hash *buffers;          /* definitions owning a live buffer */
+     ln_tensor_entry *te, *def, *inplace_te;
+     ln_list *unused_tes, *new_defs;
+     ln_list *deferred;         /* buffers freed after the next transfers */
+     ln_list *l;
+     size_t offset;
+     int defer;
 
-     use_counts = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     use_counts = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     roots = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
      LN_LIST_FOREACH(op, ops) {
-          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
-               if (ln_hash_find_extended(use_counts, te->name, NULL))
-                    use_count_inc(use_counts, te->name);
-               else
-                    use_count_zero(use_counts, te->name);
-          }
           LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
-               use_count_inc(use_counts, te->name);
+               def = find_def(defs, roots, te->name);
+               /* not created by ops, such as an external input */
+               if (!def)
+                    continue;
+               use_count_inc(use_counts, def);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->isstatic || te->isdead)
+                    continue;
+               if (te->owner) {
+                    ln_hash_insert(roots, te->name,
+                                   root_name(roots, te->owner));
+                    continue;
+               }
+               ln_hash_insert(defs, te->name, te);
+               use_count_zero(use_counts, te);
           }
      }
 
-     LN_LIST_FOREACH(op, ops) {
+     ln_hash_free(defs);
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     buffers = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     deferred = NULL;
+     for (l = ops; l; l = l->next) {
+          op = l->data;
+          if (!is_transfer(op)) {
+               LN_LIST_FOREACH(te, deferred) {
+                    free_buffer(buffers, mem_pools, te);
+               }
+               ln_list_free(deferred);
+               deferred = NULL;
+          }
+          defer = l->next && is_transfer(l->next->data);
           unused_tes = NULL;
+          new_defs = NULL;
           LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
-               mp = ln_hash_find(mem_pools, (void *)te->mtype);
-               t = te->tensor;
-               if (ln_mem_exist(mp, (size_t)t->data)) {
-                    if (use_count_dec(use_counts, te->name) == 0)
-                         unused_tes = ln_list_prepend(unused_tes, te);
+               if (te->isstatic || te->isdead)
+                    continue;
+               if (te->owner) {
+                    def = find_def(defs, roots, te->name);
+                    if (def)
+                         te->offset = def->offset;
+                    continue;
+               }
+               inplace_te = find_inplace_src(op, te, use_counts, buffers,
+                                             defs, roots);
+               if (inplace_te) {
+                    def = find_def(defs, roots, inplace_te->name);
+                    ln_hash_find_extended(buffers, def, (void **)&offset);
+                    ln_hash_remove(buffers, def);
                } else {
-                    t->data = (void *)ln_mem_alloc(mp, tl_tensor_size(t));
+                    offset = ln_mem_alloc(find_mem_pool(mem_pools, te->mtype),
+                                          tl_tensor_size(te->tensor));
                }
+               te->offset = offset;
+               ln_hash_insert(buffers, te, (void *)offset);
+               new_defs = ln_list_prepend(new_defs, te);
+               if (use_count_get(use_counts, te) == 0)
+                    unused_tes = ln_list_prepend(unused_tes, te);
           }
           LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
-               if (use_count_dec(use_counts, te->name) == 0) {
-                    mp = ln_hash_find(mem_pools, (void *)te->mtype);
-                    ln_mem_free(mp, (size_t)te->tensor->data);
+               def = find_def(defs, roots, te->name);
+               if (!def)
+                    continue;
+               te->offset = def->offset;
+               if (use_count_dec(use_counts, def) == 0) {
+                    if (defer)
+                         deferred = ln_list_prepend(deferred, def);
+                    else
+                         free_buffer(buffers, mem_pools, def);
                }
           }
+          /* inputs of this op still read the former definitions */
+          LN_LIST_FOREACH(te, new_defs) {
+               ln_hash_insert(defs, te->name, te);
+          }
           LN_LIST_FOREACH(te, unused_tes) {
-               mp = ln_hash_find(mem_pools, (void *)te->mtype);
-               ln_mem_free(mp, (size_t)te->tensor->data);
+               if (defer)
+                    deferred = ln_list_prepend(deferred, te);
+               else
+                    free_buffer(buffers, mem_pools, te);
           }
+          ln_list_free(new_defs);
           ln_list_free(unused_tes);
      }
+     ln_list_free(deferred);
 
+     ln_hash_free(buffers);
+     ln_hash_free(defs);
+     ln_hash_free(roots);
      ln_hash_free(use_counts);
      return ops;
 }
 
-ln_list *ln_optimize_mtype(ln_list *ops, ln_mem_type mtype)
+/*
+ * Dependency graph used by op reordering. Buffers are tensors owning data;
+ * a use of a view is a use of the buffer it views.
+ */
+#define MAX_EXACT_ORDER_OPS 16
+
+struct buf_info {
+     size_t  size;
+     int     n_users;           /* number of distinct ops reading it */
+};
+
+struct op_info {
+     ln_op  *op;
+     int    *preds;             /* ops producing its inputs */
+     int     n_preds;
+     int    *bufs_made;         /* buffers it creates */
+     int     n_bufs_made;
+     int    *bufs_used;         /* distinct buffers it reads */
+     int     n_bufs_used;
+};
+
+struct order_graph {
+     struct op_info  *ops;
+     int              n_ops;
+     struct buf_info *bufs;
+     int              n_bufs;
+};
+
+static int add_unique(int *array, int n, int value)
+{
+     int i;
+
+     for (i = 0; i < n; i++)
+          if (array[i] == value)
+               return n;
+     array[n] = value;
+     return n + 1;
+}
+
+static void order_graph_free(struct order_graph *g)
+{
+     int i;
+
+     for (i = 0; i < g->n_ops; i++) {
+          ln_free(g->ops[i].preds);
+          ln_free(g->ops[i].bufs_made);
+          ln_free(g->ops[i].bufs_used);
+     }
+     ln_free(g->ops);
+     ln_free(g->bufs);
+     ln_free(g);
+}
+
+/*
+ * Return NULL if ops can't be safely reordered, that is, some tensor is
+ * defined more than once or read before it is defined. If redefs is set,
+ * such ops are accepted instead and each definition makes a buffer of its
+ * own, read until the next definition; the graph is then only good for
+ * order_peak() in the list order.
+ */
+static struct order_graph *order_graph_create(ln_list *ops, int redefs)
+{
+     struct order_graph *g;
+     struct op_info *oi;
+     ln_hash *producers;        /* tensor name -> op index + 1 */
+     ln_hash *buf_ids;          /* tensor name -> buffer index + 1 */
+     ln_hash *externals;        /* tensors read before defined */
+     ln_tensor_entry *te;
+     ln_op *op;
+     ssize_t p, b;
+     int i, n_ins, n_outs, n_all_outs, ok = 1;
+
+     g = ln_alloc(sizeof(struct order_graph));
+     g->n_ops = ln_list_length(ops);
+     g->ops = ln_alloc(sizeof(struct op_info) * (g->n_ops + 1));
+     g->n_bufs = 0;
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     buf_ids = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     externals = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+
+     i = 0;
+     n_all_outs = 0;
+     LN_LIST_FOREACH(op, ops) {
+          oi = &g->ops[i];
+          n_ins = ln_tensor_table_length(op->op_arg->tensors_in);
+          n_outs = ln_tensor_table_length(op->op_arg->tensors_out);
+          oi->op = op;
+          oi->preds = ln_alloc(sizeof(int) * (n_ins + 1));
+          oi->bufs_used = ln_alloc(sizeof(int) * (n_ins + 1));
+          oi->bufs_made = ln_alloc(sizeof(int) * (n_outs + 1));
+          oi->n_preds = oi->n_bufs_used = oi->n_bufs_made = 0;
+          n_all_outs += n_outs;
+          i++;
+     }
+     g->bufs = ln_alloc(sizeof(struct buf_info) * (n_all_outs + 1));
+
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          oi = &g->ops[i];
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (!ln_hash_find_extended(producers, te->name, (void **)&p)) {
+                    ln_hash_insert(externals, te->name, NULL);
+                    continue;
+               }
+               oi->n_preds = add_unique(oi->preds, oi->n_preds, p - 1);
+               /* static tensors and their views take no buffer */
+               if (!ln_hash_find_extended(buf_ids, te->name, (void **)&b))
+                    continue;
+               oi->n_bufs_used = add_unique(oi->bufs_used, oi->n_bufs_used,
+                                            b - 1);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!redefs
+                   && (ln_hash_find_extended(producers, te->name, NULL)
+                       || ln_hash_find_extended(externals, te->name, NULL))) {
+                    ok = 0;
+                    break;
+               }
+               ln_hash_insert(producers, te->name, (void *)(ssize_t)(i + 1));
+               ln_hash_remove(buf_ids, te->name);
+               if (te->isstatic || te->isdead)
+                    continue;
+               if (te->owner) {
+                    if (ln_hash_find_extended(buf_ids, te->owner, (void **)&b))
+                         ln_hash_insert(buf_ids, te->name, (void *)b);
+                    continue;
+               }
+               g->bufs[g->n_bufs].size = tl_tensor_size(te->tensor);
+               g->bufs[g->n_bufs].n_users = 0;
+               oi->bufs_made[oi->n_bufs_made++] = g->n_bufs;
+               ln_hash_insert(buf_ids, te->name, (void *)(ssize_t)(++g->n_bufs));
+          }
+          if (!ok)
+               break;
+          for (p = 0; p < oi->n_bufs_used; p++)
+               g->bufs[oi->bufs_used[p]].n_users++;
+          i++;
+     }
+
+     ln_hash_free(externals);
+     ln_hash_free(buf_ids);
+     ln_hash_free(producers);
+     if (!ok) {
+          order_graph_free(g);
+          return NULL;
+     }
+     return g;
+}
+
+static size_t bufs_size(struct order_graph *g, int *bufs, int n)
+{
+     size_t size;
+     int i;
+
+     for (i = 0, size = 0; i < n; i++)
+          size += g->bufs[bufs[i]].size;
+     return size;
+}
+
+/*
+ * Simulate the execution of ops in order and return the peak live bytes.
+ * A buffer is live from the op creating it to its last user.
+ */
+static size_t order_peak(struct order_graph *g, int *order)
+{
+     int *remains;
+     size_t live, peak;
+     int i, j, b;
+     struct op_info *oi;
+
+     remains = ln_alloc(sizeof(int) * (g->n_bufs + 1));
+     for (i = 0; i < g->n_bufs; i++)
+          remains[i] = g->bufs[i].n_users;
+     live = peak = 0;
+     for (i = 0; i < g->n_ops; i++) {
+          oi = &g->ops[order[i]];
+          live += bufs_size(g, oi->bufs_made, oi->n_bufs_made);
+          if (live > peak)
+               peak = live;
+          for (j = 0; j < oi->n_bufs_made; j++) {
+               b = oi->bufs_made[j];
+               if (remains[b] == 0)
+                    live -= g->bufs[b].size;
+          }
+          for (j = 0; j < oi->n_bufs_used; j++) {
+               b = oi->bufs_used[j];
+               if (--remains[b] == 0)
+                    live -= g->bufs[b].size;
+          }
+     }
+     ln_free(remains);
+
+     return peak;
+}
+
+static int op_is_ready(struct op_info *oi, int *done)
+{
+     int i;
+
+     for (i = 0; i < oi->n_preds; i++)
+          if (!done[oi->preds[i]])
+               return 0;
+     return 1;
+}
+
+/*
+ * Greedy list scheduling: among the ready ops, pick the one freeing the most
+ * bytes compared to the bytes it allocates. Ties go to the original order.
+ */
+static void order_greedy(struct order_graph *g, int *order)
+{
+     int *done, *remains;
+     long long gain, best_gain;
+     int i, j, k, best;
+     struct op_info *oi;
+
+     done = ln_alloc(sizeof(int) * g->n_ops);
+     memset(done, 0, sizeof(int) * g->n_ops);
+     remains = ln_alloc(sizeof(int) * (g->n_bufs + 1));
+     for (i = 0; i < g->n_bufs; i++)
+          remains[i] = g->bufs[i].n_users;
+
+     for (i = 0; i < g->n_ops; i++) {
+          best = -1;
+          best_gain = LLONG_MIN;
+          for (j = 0; j < g->n_ops; j++) {
+               oi = &g->ops[j];
+               if (done[j] || !op_is_ready(oi, done))
+                    continue;
+               gain = -(long long)bufs_size(g, oi->bufs_made, oi->n_bufs_made);
+               for (k = 0; k < oi->n_bufs_used; k++)
+                    if (remains[oi->bufs_used[k]] == 1)
+                         gain += g->bufs[oi->bufs_used[k]].size;
+               if (gain > best_gain) {
+                    best_gain = gain;
+                    best = j;
+               }
+          }
+          assert(best >= 0);
+          oi = &g->ops[best];
+          for (k = 0; k < oi->n_bufs_used; k++)
+               remains[oi->bufs_used[k]]--;
+          done[best] = 1;
+          order[i] = best;
+     }
+
+     ln_free(remains);
+     ln_free(done);
+}
+
+/*
+ * Exact search by dynamic programming over the sets of executed ops. The live
+ * bytes after executing a set only depend on the set, so
+ * peak[S] = min over the last op v of max(peak[S-v], live[S-v] + alloc(v)).
+ */
+static void order_exact(struct order_graph *g, int *order)
+{
+     size_t *live, *peak, alloc, p;
+     int *last, *pred_masks, *users_masks;
+     int n = g->n_ops, full, S, prev, v, i, j, b;
+     struct op_info *oi;
+
+     full = (1 << n) - 1;
+     live = ln_alloc(sizeof(size_t) * (full + 1));
+     peak = ln_alloc(sizeof(size_t) * (full + 1));
+     last = ln_alloc(sizeof(int) * (full + 1));
+     pred_masks = ln_alloc(sizeof(int) * n);
+     users_masks = ln_alloc(sizeof(int) * (g->n_bufs + 1));
+
+     memset(users_masks, 0, sizeof(int) * (g->n_bufs + 1));
+     for (v = 0; v < n; v++) {
+          oi = &g->ops[v];
+          pred_masks[v] = 0;
+          for (i = 0; i < oi->n_preds; i++)
+               pred_masks[v] |= 1 << oi->preds[i];
+          for (i = 0; i < oi->n_bufs_used; i++)
+               users_masks[oi->bufs_used[i]] |= 1 << v;
+     }
+
+     live[0] = peak[0] = 0;
+     last[0] = -1;
+     for (S = 1; S <= full; S++) {
+          peak[S] = (size_t)-1;
+          last[S] = -1;
+          live[S] = 0;
+          for (v = 0; v < n; v++) {
+               if (!(S & (1 << v)))
+                    continue;
+               oi = &g->ops[v];
+               /* buffers made in S that still have users outside S */
+               for (i = 0; i < oi->n_bufs_made; i++) {
+                    b = oi->bufs_made[i];
+                    if (users_masks[b] & ~S)
+                         live[S] += g->bufs[b].size;
+               }
+          }
+          for (v = 0; v < n; v++) {
+               if (!(S & (1 << v)))
+                    continue;
+               prev = S & ~(1 << v);
+               if ((pred_masks[v] & prev) != pred_masks[v]
+                   || peak[prev] == (size_t)-1)
+                    continue;
+               oi = &g->ops[v];
+               alloc = bufs_size(g, oi->bufs_made, oi->n_bufs_made);
+               p = live[prev] + alloc > peak[prev] ?
+                    live[prev] + alloc : peak[prev];
+               /* on ties keep later ops last, closer to the original order */
+               if (p <= peak[S]) {
+                    peak[S] = p;
+                    last[S] = v;
+               }
+          }
+     }
+
+     for (S = full, j = n - 1; j >= 0; j--) {
+          order[j] = last[S];
+          S &= ~(1 << last[S]);
+     }
+
+     ln_free(users_masks);
+     ln_free(pred_masks);
+     ln_free(last);
+     ln_free(peak);
+     ln_free(live);
+}
+
+/*
+ * Return the peak live bytes of the tensors created by ops if they are run
+ * in the list order, without in-place reuse and memory fragmentation.
+ * A tensor defined more than once, as after rematerialization, counts as
+ * one tensor per definition.
+ */
+size_t ln_optimize_peak_mem(ln_list *ops)
+{
+     struct order_graph *g;
+     int *order;
+     size_t peak;
+     int i;
+
+     g = order_graph_create(ops, 1);
+     order = ln_alloc(sizeof(int) * (g->n_ops + 1));
+     for (i = 0; i < g->n_ops; i++)
+          order[i] = i;
+     peak = order_peak(g, order);
+     ln_free(order);
+     order_graph_free(g);
+
+     return peak;
+}
+
+/*
+ * Reorder ops topologically to minimize the peak live bytes of the tensors
+ * they create. Small op lists are searched exhaustively, others are
+ * scheduled greedily. The original order is kept if it's no worse, or if some
+ * tensor is defined more than once. The peaks before and after are returned
+ * in peak_before and peak_after if they aren't NULL.
+ */
+ln_list *ln_optimize_order(ln_list *ops, size_t *peak_before,
+                           size_t *peak_after)
+{
+     struct order_graph *g;
+     ln_list *new_ops;
+     int *order, *new_order;
+     size_t before, after;
+     int i;
+
+     g = order_graph_create(ops, 0);
+     if (!g) {
+          before = after = ln_optimize_peak_mem(ops);
+          goto end;
+     }
+
+     order = ln_alloc(sizeof(int) * (g->n_ops + 1));
+     new_order = ln_alloc(sizeof(int) * (g->n_ops + 1));
+     for (i = 0; i < g->n_ops; i++)
+          order[i] = i;
+     before = order_peak(g, order);
+     if (g->n_ops <= MAX_EXACT_ORDER_OPS)
+          order_exact(g, new_order);
+     else
+          order_greedy(g, new_order);
+     after = order_peak(g, new_order);
+
+     if (after < before) {
+          new_ops = NULL;
+          for (i = 0; i < g->n_ops; i++)
+               new_ops = ln_list_prepend(new_ops,
+                                         g->ops[new_order[g->n_ops-1-i]].op);
+          ln_list_free(ops);
+          ops = new_ops;
+     } else {
+          after = before;
+     }
+
+     ln_free(new_order);
+     ln_free(order);
+     order_graph_free(g);
+end:
+     if (peak_before)
+          *peak_before = before;
+     if (peak_after)
+          *peak_after = after;
+     return ops;
+}
+
+/*
+ * Rematerialization. An output of a cheap op can be dropped after a use and
+ * computed again right before a later use by a duplicate of the op, which
+ * defines the tensor again and so starts a new live range in the plan.
+ * Views own no memory and are never recomputed.
+ */
+#define UNLIMITED_POOL_SIZE (SIZE_MAX >> 1)
+
+static const char *remat_optypes[] = {"elew", "slice", NULL};
+static const ln_mem_type plan_mtypes[] = {LN_MEM_CPU, LN_MEM_CUDA, LN_MEM_MMAP,
+                                          LN_MEM_SIM};
+
+struct remat_cand {
+     ln_op *op;                 /* op to duplicate */
+     int    pos;                /* where to insert the duplicate */
+};
+
+static int is_remat_optype(const char *optype)
+{
+     int i;
+
+     for (i = 0; remat_optypes[i]; i++)
+          if (!strcmp(remat_optypes[i], optype))
+               return 1;
+     return 0;
+}
+
+/* a recompute op uses the private data and tensors of the op it duplicates */
+static void remat_nop(ln_op_arg *op_arg, ln_error **error)
+{
+}
+
+static ln_tensor_table *tensor_table_copy(ln_tensor_table *table)
+{
+     ln_tensor_table *copy = NULL;
+     ln_tensor_entry *te, *new_te;
+
+     LN_LIST_FOREACH(te, table) {
+          copy = ln_tensor_table_append(copy, te->arg_name, te->name,
+                                        te->mtype, te->tensor);
+          new_te = ln_tensor_table_find_by_arg_name(copy, te->arg_name);
+          if (te->inplace)
+               new_te->inplace = ln_strdup(te->inplace);
+          if (te->owner)
+               new_te->owner = ln_strdup(te->owner);
+     }
+     return copy;
+}
+
+static ln_op *remat_op_create(ln_op *op, int n)
+{
+     ln_op *remat;
+     char *name;
+
+     name = ln_alloc(sizeof(char) * (strlen(op->op_arg->name) + 32));
+     sprintf(name, "%s_remat%d", op->op_arg->name, n);
+     remat = ln_op_create(name, op->op_arg->optype,
+                          tensor_table_copy(op->op_arg->tensors_in),
+                          tensor_table_copy(op->op_arg->tensors_out),
+                          NULL, remat_nop, op->run, remat_nop);
+     remat->op_arg->priv = op->op_arg->priv;
+     ln_op_copy_impl(remat, op);
+     ln_free(name);
+
+     return remat;
+}
+
+static void remat_op_free(ln_op *remat)
+{
+     ln_tensor_table_free(remat->op_arg->tensors_in);
+     ln_tensor_table_free(remat->op_arg->tensors_out);
+     ln_op_free(remat);
+}
+
+/*
+ * Plan ops in unlimited pools aligned like mem_pools, and return the bytes
+ * by which the plan overflows the size of the mtype pool, or the total of
+ * all pools if mtype is LN_MEM_UNDEFINED.
+ */
+static size_t plan_excess(ln_list *ops, ln_hash *mem_pools, ln_mem_type mtype)
+{
+     ln_hash *scratch_pools;
+     ln_mem_pool *mp, *scratch;
+     size_t excess;
+     int i, n;
+
+     n = sizeof(plan_mtypes) / sizeof(plan_mtypes[0]);
+     scratch_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     for (i = 0; i < n; i++) {
+          mp = ln_hash_find(mem_pools, (void *)plan_mtypes[i]);
+          if (!mp)
+               continue;
+          scratch = ln_mem_pool_create(UNLIMITED_POOL_SIZE, mp->align_size);
+          ln_hash_insert(scratch_pools, (void *)plan_mtypes[i], scratch);
+     }
+
+     ln_optimize_mem(ops, scratch_pools);
+
+     excess = 0;
+     for (i = 0; i < n; i++) {
+          mp = ln_hash_find(mem_pools, (void *)plan_mtypes[i]);
+          if (!mp)
+               continue;
+          scratch = ln_hash_find(scratch_pools, (void *)plan_mtypes[i]);
+          if ((mtype == LN_MEM_UNDEFINED || mtype == plan_mtypes[i])
+              && scratch->peak > mp->size)
+               excess += scratch->peak - mp->size;
+          ln_mem_pool_free(scratch);
+     }
+     ln_hash_free(scratch_pools);
+
+     return excess;
+}
+
+/*
+ * Uses of outputs of cheap ops that aren't right after their previous use,
+ * so that a recompute op put before them may shorten a live range.
+ */
+static ln_list *remat_candidates(ln_list *ops)
+{
+     ln_hash *producers;        /* tensor name -> first op creating it */
+     ln_hash *last_access;      /* tensor name -> index of last op using it */
+     ln_list *cands = NULL;
+     struct remat_cand *cand;
+     ln_tensor_entry *te;
+     ln_op *op, *producer;
+     ssize_t last;
+     int i;
+
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     last_access = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               producer = ln_hash_find(producers, te->name);
+               if (!producer || !is_remat_optype(producer->op_arg->optype))
+                    continue;
+               ln_hash_find_extended(last_access, te->name, (void **)&last);
+               if (last >= i - 1)
+                    continue;
+               cand = ln_alloc(sizeof(struct remat_cand));
+               cand->op = producer;
+               cand->pos = i;
+               cands = ln_list_prepend(cands, cand);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(last_access, te->name, (void *)(ssize_t)i);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(last_access, te->name, (void *)(ssize_t)i);
+               if (!te->owner && !te->isstatic
+                   && !ln_hash_find_extended(producers, te->name, NULL))
+                    ln_hash_insert(producers, te->name, op);
+          }
+          i++;
+     }
+     ln_hash_free(last_access);
+     ln_hash_free(producers);
+
+     return cands;
+}
+
+/*
+ * Insert recompute ops into ops until their memory plan fits in mem_pools,
+ * whose sizes are the budgets of their ln_mem_type. Each round puts the
+ * recompute op that lowers the overflow the most. The number of recompute
+ * ops and the bytes they write, as a measure of the extra compute, are
+ * returned in n_extra_ops and extra_bytes if they aren't NULL. A warning is
+ * issued if the plan still doesn't fit.
+ *
+ * Planned offsets in ops are overwritten, so ln_optimize_mem() should be
+ * called after this.
+ */
+ln_list *ln_optimize_remat(ln_list *ops, ln_hash *mem_pools,
+                           int *n_extra_ops, size_t *extra_bytes)
+{
+     ln_list *cands;
+     ln_op *remat;
+     ln_tensor_entry *te;
+     ln_error *error;
+     struct remat_cand *cand, *best;
+     size_t excess, new_excess, best_excess, bytes;
+     int n_remats;
+
+     n_remats = 0;
+     bytes = 0;
+     excess = plan_excess(ops, mem_pools, LN_MEM_UNDEFINED);
+     while (excess > 0) {
+          cands = remat_candidates(ops);
+          best = NULL;
+          best_excess = excess;
+          LN_LIST_FOREACH(cand, cands) {
+               remat = remat_op_create(cand->op, n_remats);
+               ops = ln_list_insert_nth(ops, remat, cand->pos);
+               new_excess = plan_excess(ops, mem_pools, LN_MEM_UNDEFINED);
+               ops = ln_list_remove_nth(ops, cand->pos);
+               remat_op_free(remat);
+               if (new_excess < best_excess) {
+                    best_excess = new_excess;
+                    best = cand;
+               }
+          }
+          if (best) {
+               remat = remat_op_create(best->op, n_remats++);
+               ops = ln_list_insert_nth(ops, remat, best->pos);
+               LN_LIST_FOREACH(te, remat->op_arg->tensors_out) {
+                    if (!te->owner)
+                         bytes += tl_tensor_size(te->tensor);
+               }
+               excess = best_excess;
+          }
+          ln_list_free_deep(cands, ln_free);
+          if (!best)
+               break;
+     }
+
+     if (excess > 0) {
+          error = ln_error_create(LN_WARNING,
+                                  "ln_optimize_remat(): memory plan still exceeds the memory pools by %lu bytes",
+                                  excess);
+          ln_error_handle(&error);
+     }
+     if (n_extra_ops)
+          *n_extra_ops = n_remats;
+     if (extra_bytes)
+          *extra_bytes = bytes;
+     return ops;
+}
+
+/* set the ln_mem_type of tensor name, its views and all their uses */
+static void set_mtype(ln_list *ops, ln_hash *roots, char *name,
+                      ln_mem_type mtype)
+{
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (!strcmp(root_name(roots, te->name), name))
+                    te->mtype = mtype;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!strcmp(root_name(roots, te->name), name))
+                    te->mtype = mtype;
+          }
+     }
+}
+
+/*
+ * The host tensor not spilled yet with the largest size times the number of
+ * ops it lives across, counting uses through its views, or NULL.
+ */
+static char *spill_candidate(ln_list *ops, ln_hash *roots)
 {
+     ln_hash *defs;             /* root name -> index of its creating op */
+     ln_hash *sizes;            /* root name -> size */
+     ln_tensor_entry *te;
+     ln_op *op;
+     ssize_t i, def, size, score, best_score;
+     char *root, *best;
+
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     sizes = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     best = NULL;
+     best_score = 0;
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               root = root_name(roots, te->name);
+               if (!ln_hash_find_extended(defs, root, (void **)&def))
+                    continue;
+               ln_hash_find_extended(sizes, root, (void **)&size);
+               score = size * (i - def);
+               if (score > best_score) {
+                    best_score = score;
+                    best = root;
+               }
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->owner || te->isstatic || te->isdead
+                   || (te->mtype != LN_MEM_UNDEFINED
+                       && te->mtype != LN_MEM_CPU)
+                   || ln_hash_find_extended(defs, te->name, NULL))
+                    continue;
+               ln_hash_insert(defs, te->name, (void *)i);
+               ln_hash_insert(sizes, te->name,
+                              (void *)(ssize_t)tl_tensor_size(te->tensor));
+          }
+          i++;
+     }
+     ln_hash_free(sizes);
+     ln_hash_free(defs);
+
+     return best;
+}
+
+/*
+ * Move host tensors to the LN_MEM_MMAP pool in mem_pools until the memory
+ * plan of ops fits in the LN_MEM_CPU pool, whose size is the RAM budget.
+ * The largest and longest-lived tensors are moved first. The number of
+ * tensors moved is returned in n_spilled if it isn't NULL, and a warning is
+ * issued if the plan still doesn't fit.
+ *
+ * ln_op_list_do_run_in_pools() runs ops with spilled tensors in the mapped
+ * file, after ln_optimize_mem() plans them.
+ */
+ln_list *ln_optimize_spill(ln_list *ops, ln_hash *mem_pools, int *n_spilled)
+{
+     ln_hash *roots;            /* view name -> name of the data owner */
+     ln_tensor_entry *te;
+     ln_error *error;
+     ln_op *op;
+     size_t excess;
+     char *name;
+     int n;
+
+     n = 0;
+     if (!ln_hash_find(mem_pools, (void *)LN_MEM_MMAP))
+          goto end;
+
+     roots = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->owner)
+                    ln_hash_insert(roots, te->name,
+                                   root_name(roots, te->owner));
+          }
+     }
+
+     excess = plan_excess(ops, mem_pools, LN_MEM_CPU);
+     while (excess > 0 && (name = spill_candidate(ops, roots))) {
+          set_mtype(ops, roots, name, LN_MEM_MMAP);
+          n++;
+          excess = plan_excess(ops, mem_pools, LN_MEM_CPU);
+     }
+     ln_hash_free(roots);
+
+     if (excess > 0) {
+          error = ln_error_create(LN_WARNING,
+                                  "ln_optimize_spill(): memory plan still exceeds the host memory pool by %lu bytes",
+                                  excess);
+          ln_error_handle(&error);
+     }
+end:
+     if (n_spilled)
+          *n_spilled = n;
+     return ops;
+}
+
+static void op_free_tables_too(ln_op *op)
+{
+     ln_tensor_table_free(op->op_arg->tensors_in);
+     ln_tensor_table_free(op->op_arg->tensors_out);
+     ln_param_table_free(op->op_arg->params);
+     ln_op_free(op);
+}
+
+/*
+ * Remove dead_ops from ops, running their post_run to free their tensors.
+ * Input entries of the remaining ops that refer to freed tensors are
+ * cleared. A tensor also created by a remaining op, like the output of an
+ * op that a recompute op duplicates, isn't freed.
+ */
+static ln_list *remove_ops(ln_list *ops, ln_list *dead_ops, ln_error **error)
+{
+     ln_hash *freed;            /* names of freed tensors */
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     freed = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, dead_ops) {
+          ops = ln_list_remove(ops, op);
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(freed, te->name, NULL);
+          }
+     }
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_remove(freed, te->name);
+          }
+     }
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (ln_hash_find_extended(freed, te->name, NULL))
+                    te->tensor = NULL;
+          }
+     }
+     ln_hash_free(freed);
+
+     LN_LIST_FOREACH(op, dead_ops) {
+          if (!*error)
+               op->post_run(op->op_arg, error);
+          op_free_tables_too(op);
+     }
+     return ops;
+}
+
+/* the outputs of a folded op have been computed once by ln_optimize_fold() */
+static void folded_run(ln_op_arg *op_arg, ln_error **error)
+{
+}
+
+/* whether op is folded, so it reads nothing when run */
+int ln_optimize_is_folded(ln_op *op)
+{
+     return op->run == folded_run;
+}
+
+/*
+ * An op's private data refers to the tensors of its inputs, so a pass that
+ * rewires inputs has to post_run all ops and pre_run them again. That only
+ * works if pre_run can rebuild everything: no folded ops, whose outputs were
+ * computed once, no recompute ops, which share private data, and no tensor
+ * defined twice.
+ */
+static int can_reprepare(ln_list *ops)
+{
+     ln_hash *defined;
+     ln_tensor_entry *te;
+     ln_op *op;
+     int ret = 1;
+
+     defined = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          if (op->run == folded_run)
+               ret = 0;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!ln_hash_insert(defined, te->name, NULL))
+                    ret = 0;
+          }
+     }
+     ln_hash_free(defined);
+     return ret;
+}
+
+/*
+ * Free the tensors made by pre_run and clear the entries refering to them.
+ * Tensors no op creates, given by the user, are kept. Dead marks and memory
+ * types are kept, since pre_run doesn't set them.
+ */
+static void unprepare_ops(ln_list *ops, ln_error **error)
+{
+     ln_hash *created;
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     created = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          op->post_run(op->op_arg, error);
+          if (*error)
+               goto end;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(created, te->name, NULL);
+          }
+     }
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (ln_hash_find_extended(created, te->name, NULL))
+                    te->tensor = NULL;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               te->tensor = NULL;
+               ln_free(te->inplace);
+               te->inplace = NULL;
+               ln_free(te->owner);
+               te->owner = NULL;
+               te->isstatic = 0;
+          }
+     }
+end:
+     ln_hash_free(created);
+}
+
+/* unprepare ops before the first change a pass makes; 0 on error */
+static int unprepare_once(ln_list *ops, int *unprepared, ln_error **error)
+{
+     if (*unprepared)
+          return 1;
+     unprepare_ops(ops, error);
+     *unprepared = 1;
+     return !*error;
+}
+
+/* pre_run ops again in order, binding inputs to the tensors just made */
+static void prepare_ops(ln_list *ops, ln_error **error)
+{
+     ln_hash *tensors;          /* name -> tensor made by pre_run */
+     ln_tensor_entry *te;
+     tl_tensor *tensor;
+     ln_op *op;
+
+     tensors = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (ln_hash_find_extended(tensors, te->name, (void **)&tensor))
+                    te->tensor = tensor;
+          }
+          op->pre_run(op->op_arg, error);
+          if (*error)
+               break;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(tensors, te->name, te->tensor);
+          }
+     }
+     ln_hash_free(tensors);
+}
+
+/* whether op is a "create" op without data, given at run time instead */
+static int is_placeholder(ln_op *op)
+{
+     ln_param_entry *pe;
+
+     if (strcmp(op->op_arg->optype, "create"))
+          return 0;
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "data");
+     return pe && pe->type == LN_PARAM_NULL;
+}
+
+static int inputs_are_constant(ln_op *op, ln_hash *constants)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+          if (!ln_hash_find_extended(constants, te->name, NULL))
+               return 0;
+     }
+     return 1;
+}
+
+static int outputs_are_constant(ln_op *op, ln_hash *constants)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if (!ln_hash_find_extended(constants, te->name, NULL))
+               return 0;
+     }
+     return op->op_arg->tensors_out != NULL;
+}
+
+/* view name -> name of the data owner, for the views made by ops */
+static ln_hash *view_roots(ln_list *ops)
+{
+     ln_hash *roots;
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     roots = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->owner)
+                    ln_hash_insert(roots, te->name,
+                                   root_name(roots, te->owner));
+          }
+     }
+     return roots;
+}
+
+/*
+ * Root names of the data still needed after folding: used by an op that
+ * isn't constant, directly or through a view, or not used by any op, as a
+ * graph output.
+ */
+static ln_hash *needed_roots(ln_list *ops, ln_hash *roots, ln_hash *constants)
+{
+     ln_hash *used, *needed;
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     used = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     needed = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(used, te->name, NULL);
+               if (!outputs_are_constant(op, constants))
+                    ln_hash_insert(needed,
+                                   ln_strdup(root_name(roots, te->name)), NULL);
+          }
+     }
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!ln_hash_find_extended(used, te->name, NULL))
+                    ln_hash_insert(needed,
+                                   ln_strdup(root_name(roots, te->name)), NULL);
+          }
+     }
+     ln_hash_free(used);
+
+     return needed;
+}
+
+/* the "dtype" param of a create op making dtype, or NULL if it can't */
+static const char *create_dtype(tl_dtype dtype)
+{
+     switch (dtype) {
+     case TL_FLOAT:
+          return "TL_FLOAT";
+     case TL_INT32:
+          return "TL_INT32";
+     case TL_INT16:
+          return "TL_INT16";
+     case TL_INT8:
+          return "TL_INT8";
+     case TL_UINT32:
+          return "TL_UINT32";
+     case TL_UINT16:
+          return "TL_UINT16";
+     case TL_UINT8:
+          return "TL_UINT8";
+     case TL_BOOL:
+          return "TL_BOOL";
+     default:
+          return NULL;
+     }
+}
+
+/* whether the outputs of a folded op can be given by create ops */
+static int can_make_constants(ln_op *op)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if ((te->mtype != LN_MEM_UNDEFINED && te->mtype != LN_MEM_CPU)
+              || !te->tensor || !te->tensor->data
+              || !create_dtype(te->tensor->dtype))
+               return 0;
+     }
+     return 1;
+}
+
+/*
+ * The create ops with the data of the outputs of a folded op, made like
+ * proto, one per output. They are named after the op if it has one
+ * output, and after the op and the output's arg name otherwise.
+ */
+static ln_list *constant_ops(ln_op *op, ln_op *proto)
+{
+     ln_tensor_table *tensors_out;
+     ln_param_table *params;
+     ln_tensor_entry *te, *dst;
+     ln_list *consts;
+     ln_op *c;
+     tl_tensor *t;
+     double *dims, *data;
+     char *name;
+     int i;
+
+     consts = NULL;
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          t = te->tensor;
+          dims = ln_alloc(sizeof(double) * t->ndim);
+          for (i = 0; i < t->ndim; i++)
+               dims[i] = t->dims[i];
+          data = ln_alloc(sizeof(double) * t->len);
+          for (i = 0; i < t->len; i++)
+               tl_convert(&data[i], TL_DOUBLE,
+                          tl_padd(t->data, i, tl_size_of(t->dtype)), t->dtype);
+          params = ln_param_table_append_string(NULL, "dtype",
+                                                create_dtype(t->dtype));
+          params = ln_param_table_append_array_number(params, "dims",
+                                                      t->ndim, dims);
+          params = ln_param_table_append_array_number(params, "data",
+                                                      t->len, data);
+          tensors_out = ln_tensor_table_append(NULL, "dst", te->name,
+                                               te->mtype, NULL);
+          dst = tensors_out->data;
+          dst->isdead = te->isdead;
+          if (ln_tensor_table_length(op->op_arg->tensors_out) == 1) {
+               name = ln_strdup(op->op_arg->name);
+          } else {
+               name = ln_alloc(strlen(op->op_arg->name)
+                               + strlen(te->arg_name) + 2);
+               sprintf(name, "%s_%s", op->op_arg->name, te->arg_name);
+          }
+          c = ln_op_create(name, "create", NULL, tensors_out, params,
+                           proto->pre_run, proto->run, proto->post_run);
+          ln_op_copy_impl(c, proto);
+          consts = ln_list_append(consts, c);
+          ln_free(name);
+          ln_free(data);
+          ln_free(dims);
+     }
+     return consts;
+}
+
+/*
+ * Replace folded ops by create ops holding their outputs, so that later
+ * passes can prepare ops again. The folded tensors are freed, so all ops
+ * are prepared again. Nothing is replaced unless every folded op can be.
+ */
+static ln_list *replace_folded(ln_list *ops, ln_error **error)
+{
+     ln_list *new_ops, *consts, *replaced;
+     ln_op *op, *proto, *c;
+
+     LN_LIST_FOREACH(op, ops) {
+          if (op->run == folded_run && !can_make_constants(op))
+               return ops;
+     }
+     /* the create op of the caller's registered ops, if one is there */
+     if (!(proto = ln_op_list_find_by_optype(ops, "create")))
+          proto = &ln_opimpl_create;
+
+     new_ops = NULL;
+     replaced = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          if (op->run != folded_run) {
+               new_ops = ln_list_append(new_ops, op);
+               continue;
+          }
+          consts = constant_ops(op, proto);
+          LN_LIST_FOREACH(c, consts) {
+               new_ops = ln_list_append(new_ops, c);
+          }
+          ln_list_free(consts);
+          replaced = ln_list_append(replaced, op);
+     }
+     if (!replaced) {
+          ln_list_free(new_ops);
+          return ops;
+     }
+
+     unprepare_ops(ops, error);
+     LN_LIST_FOREACH(op, replaced) {
+          op_free_tables_too(op);
+     }
+     ln_list_free(replaced);
+     ln_list_free(ops);
+     if (!*error)
+          prepare_ops(new_ops, error);
+     return new_ops;
+}
+
+/*
+ * Fold ops whose inputs are all constant, that is, outputs of create ops or
+ * of ops folded before; ops without inputs, such as zeros, are folded too.
+ * Create ops without data are placeholders of inputs, not constants.
+ * A folded op is run once here and replaced by create ops with the data
+ * of its outputs, so that other passes can still prepare the ops again.
+ * Views of constants, such as reshapes, are constant too, but aren't
+ * folded, so they still share the data they view.
+ * If the list has recompute ops or tensors defined twice, or an output
+ * create can't make, such as device data, folded ops are kept instead:
+ * their outputs become static and their run function does nothing
+ * afterwards, and such ops can't be prepared again. Then constant
+ * producers used only by folded ops are post_run and removed from ops,
+ * and the entries referring to their freed tensors are cleared.
+ */
+ln_list *ln_optimize_fold(ln_list *ops, ln_error **error)
+{
+     ln_hash *constants;        /* names of constant tensors */
+     ln_hash *roots;            /* view name -> name of the data owner */
+     ln_hash *needed;           /* root names of data still needed */
+     ln_tensor_entry *te;
+     ln_list *dead_ops;
+     ln_op *op;
+     int all_static, views, dead, reprepare;
+
+     reprepare = can_reprepare(ops);
+     constants = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          if (is_placeholder(op) || !inputs_are_constant(op, constants))
+               continue;
+          all_static = 1;
+          views = 1;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               all_static = all_static && te->isstatic;
+               views = views && te->owner;
+          }
+          if (!all_static && !views) {
+               op->run(op->op_arg, error);
+               if (*error)
+                    goto end;
+               op->run = folded_run;
+               op->cost = NULL;
+               op->variants = NULL;
+               op->emit = NULL;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               te->isstatic = 1;
+               ln_hash_insert(constants, ln_strdup(te->name), NULL);
+          }
+     }
+     /* found before folded ops are replaced, as they no longer read */
+     roots = view_roots(ops);
+     needed = needed_roots(ops, roots, constants);
+     ln_hash_free(roots);
+     if (reprepare) {
+          ops = replace_folded(ops, error);
+          if (*error) {
+               ln_hash_free(needed);
+               goto end;
+          }
+     }
+
+     roots = view_roots(ops);
+     dead_ops = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          if (!outputs_are_constant(op, constants))
+               continue;
+          dead = 1;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (ln_hash_find_extended(needed, root_name(roots, te->name),
+                                         NULL))
+                    dead = 0;
+          }
+          if (dead)
+               dead_ops = ln_list_prepend(dead_ops, op);
+     }
+     ln_hash_free(needed);
+     ln_hash_free(roots);
+
+     ops = remove_ops(ops, dead_ops, error);
+     ln_list_free(dead_ops);
+
+end:
+     ln_hash_free(constants);
+     return ops;
+}
+
+/*
+ * Remove ops that don't contribute to the graph outputs, which is a list of
+ * tensor names. Outputs of the remaining ops that no one reads are marked
+ * dead, so that their ops may skip computing them and the memory planner
+ * doesn't plan them. Ops sharing private data with a remaining op, like
+ * the op a recompute op duplicates, are kept.
+ */
+ln_list *ln_optimize_dce(ln_list *ops, ln_list *outputs, ln_error **error)
+{
+     ln_hash *needed;           /* names read later or graph outputs */
+     ln_hash *live_privs;       /* private data of live ops */
+     ln_list *rev_ops, *dead_ops;
+     ln_tensor_entry *te;
+     ln_op *op;
+     char *name;
+     int live;
+
+     LN_LIST_FOREACH(name, outputs) {
+          if (!ln_op_list_find_tensor_by_name(ops, name)) {
+               *error = ln_error_create(LN_ERROR,
+                                        "ln_optimize_dce(): graph output \"%s\" isn't created by any op",
+                                        name);
+               return ops;
+          }
+     }
+
+     needed = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     live_privs = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     LN_LIST_FOREACH(name, outputs) {
+          ln_hash_insert(needed, name, NULL);
+     }
+     rev_ops = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          rev_ops = ln_list_prepend(rev_ops, op);
+     }
+     dead_ops = NULL;
+     LN_LIST_FOREACH(op, rev_ops) {
+          live = 0;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (ln_hash_find_extended(needed, te->name, NULL))
+                    live = 1;
+          }
+          if (!live && !(op->op_arg->priv
+                         && ln_hash_find_extended(live_privs,
+                                                  op->op_arg->priv, NULL))) {
+               dead_ops = ln_list_prepend(dead_ops, op);
+               continue;
+          }
+          /* this op defines its outputs, so earlier ones are overwritten */
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               te->isdead = !ln_hash_find_extended(needed, te->name, NULL);
+               ln_hash_remove(needed, te->name);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(needed, te->name, NULL);
+          }
+          if (op->op_arg->priv)
+               ln_hash_insert(live_privs, op->op_arg->priv, NULL);
+     }
+     ln_list_free(rev_ops);
+     ln_hash_free(live_privs);
+     ln_hash_free(needed);
+
+     ops = remove_ops(ops, dead_ops, error);
+     ln_list_free(dead_ops);
+     return ops;
+}
+
+static void print_string(FILE *fp, const char *str)
+{
+     fprintf(fp, "%lu:%s", (unsigned long)strlen(str), str);
+}
+
+static void print_param(FILE *fp, ln_param_entry *pe)
+{
+     int i;
+
+     print_string(fp, pe->arg_name);
+     fprintf(fp, "=%d:%d:", pe->type, pe->array_len);
+     switch (pe->type) {
+     case LN_PARAM_STRING:
+          print_string(fp, pe->value_string);
+          break;
+     case LN_PARAM_NUMBER:
+          fprintf(fp, "%.17g", pe->value_double);
+          break;
+     case LN_PARAM_BOOL:
+          fprintf(fp, "%d", pe->value_bool);
+          break;
+     case LN_PARAM_ARRAY_STRING:
+          for (i = 0; i < pe->array_len; i++)
+               print_string(fp, pe->value_array_string[i]);
+          break;
+     case LN_PARAM_ARRAY_NUMBER:
+          for (i = 0; i < pe->array_len; i++)
+               fprintf(fp, "%.17g,", pe->value_array_double[i]);
+          break;
+     case LN_PARAM_ARRAY_BOOL:
+          for (i = 0; i < pe->array_len; i++)
+               fprintf(fp, "%d,", pe->value_array_bool[i]);
+          break;
+     default:
+          break;
+     }
+     fprintf(fp, ";");
+}
+
+/*
+ * The key of an op: its optype, its input names by arg_name, its output
+ * arg_names and its params sorted by arg_name, so that two ops with the
+ * same key compute the same outputs. Returned key should be freed.
+ */
+static char *op_key(ln_op *op)
+{
+     ln_param_entry *pe, *next, *prev;
+     ln_tensor_entry *te;
+     size_t size;
+     char *key;
+     FILE *fp;
+
+     fp = open_memstream(&key, &size);
+     print_string(fp, op->op_arg->optype);
+     fprintf(fp, "|");
+     LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+          print_string(fp, te->arg_name);
+          fprintf(fp, "=");
+          print_string(fp, te->name);
+     }
+     fprintf(fp, "|");
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          print_string(fp, te->arg_name);
+     }
+     fprintf(fp, "|");
+     for (prev = NULL;; prev = next) {
+          next = NULL;
+          LN_LIST_FOREACH(pe, op->op_arg->params) {
+               if (prev && strcmp(pe->arg_name, prev->arg_name) <= 0)
+                    continue;
+               if (!next || strcmp(pe->arg_name, next->arg_name) < 0)
+                    next = pe;
+          }
+          if (!next)
+               break;
+          print_param(fp, next);
+     }
+     fclose(fp);
+
+     return key;
+}
+
+static void rename_tensor(ln_tensor_entry *te, const char *name)
+{
+     ln_free(te->name);
+     te->name = ln_strdup(name);
+}
+
+static void rename_inputs(ln_op *op, ln_hash *renames)
+{
+     ln_tensor_entry *te;
+     char *name;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+          if (ln_hash_find_extended(renames, te->name, (void **)&name))
+               rename_tensor(te, name);
+     }
+}
+
+/* a set of graph output names, copied since passes may rename tensors */
+static ln_hash *output_set(ln_list *outputs)
+{
+     ln_hash *outs;
+     char *name;
+
+     outs = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     LN_LIST_FOREACH(name, outputs) {
+          ln_hash_insert(outs, ln_strdup(name), NULL);
+     }
+     return outs;
+}
+
+static int creates_output(ln_op *op, ln_hash *outs)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if (ln_hash_find_extended(outs, te->name, NULL))
+               return 1;
+     }
+     return 0;
+}
+
+/*
+ * Merge structurally identical ops. An op with the same optype, params and
+ * inputs as an earlier op is removed, and the ops reading its outputs read
+ * the outputs of the earlier op instead. Ops creating a tensor in outputs,
+ * the graph output names, are kept, and so are placeholders, whose data
+ * differs at run time. Then the ops are
+ * prepared again, so the memory planner should be run after this pass.
+ * If there are folded ops, recompute ops or tensors defined twice, ops
+ * are returned unchanged with a warning; run this pass before those.
+ */
+ln_list *ln_optimize_cse(ln_list *ops, ln_list *outputs, ln_error **error)
+{
+     ln_hash *keys;             /* op key -> the first op with it */
+     ln_hash *renames;          /* removed output name -> surviving name */
+     ln_hash *outs;
+     ln_tensor_entry *te, *same_te;
+     ln_list *dead_ops;
+     ln_op *op, *same;
+     char *key;
+
+     if (!can_reprepare(ops)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_cse(): ops have folded or recompute ops or tensors defined twice, skipped");
+          return ops;
+     }
+
+     keys = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     renames = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     outs = output_set(outputs);
+
+     dead_ops = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          rename_inputs(op, renames);
+          if (is_placeholder(op))
+               continue;
+          key = op_key(op);
+          if (!ln_hash_find_extended(keys, key, (void **)&same)) {
+               ln_hash_insert(keys, key, op);
+               continue;
+          }
+          ln_free(key);
+          if (creates_output(op, outs))
+               continue;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               same_te = ln_tensor_table_find_by_arg_name(same->op_arg->tensors_out,
+                                                          te->arg_name);
+               same_te->isdead = same_te->isdead && te->isdead;
+               ln_hash_insert(renames, te->name, same_te->name);
+          }
+          dead_ops = ln_list_prepend(dead_ops, op);
+     }
+     ln_hash_free(outs);
+     ln_hash_free(renames);
+     ln_hash_free(keys);
+
+     if (!dead_ops)
+          return ops;
+
+     unprepare_ops(ops, error);
+     if (*error)
+          goto end;
+     LN_LIST_FOREACH(op, dead_ops) {
+          ops = ln_list_remove(ops, op);
+          op_free_tables_too(op);
+     }
+     prepare_ops(ops, error);
+
+end:
+     ln_list_free(dead_ops);
+     return ops;
+}
+
+static int is_float_const(ln_op *op)
+{
+     ln_param_entry *pe;
+
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "dtype");
+     return pe && pe->type == LN_PARAM_STRING
+          && (!strcmp(pe->value_string, "TL_FLOAT")
+              || !strcmp(pe->value_string, "TL_DOUBLE"));
+}
+
+/*
+ * The value of all elements of a create or zeros output, if they are the
+ * same. Integer tensors only get integral values.
+ */
+static int uniform_value(ln_hash *producers, char *name, double *value)
+{
+     ln_param_entry *pe;
+     ln_op *op;
+     int i;
+
+     if (!ln_hash_find_extended(producers, name, (void **)&op))
+          return 0;
+     if (!strcmp(op->op_arg->optype, "zeros")) {
+          *value = 0;
+          return 1;
+     }
+     if (strcmp(op->op_arg->optype, "create"))
+          return 0;
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "data");
+     if (!pe || pe->type != LN_PARAM_ARRAY_NUMBER || pe->array_len < 1)
+          return 0;
+     for (i = 1; i < pe->array_len; i++) {
+          if (pe->value_array_double[i] != pe->value_array_double[0])
+               return 0;
+     }
+     *value = pe->value_array_double[0];
+     return is_float_const(op) || *value == (int)*value;
+}
+
+/*
+ * The create op of the reciprocal of a float create output without zero
+ * elements, made and put into new_ops if it's not there yet.
+ */
+static ln_op *reciprocal_op(ln_hash *producers, ln_tensor_entry *src,
+                            ln_list **new_ops)
+{
+     ln_param_entry *data_pe, *dims_pe, *dtype_pe;
+     ln_param_table *params;
+     ln_tensor_table *tensors_out;
+     ln_op *op, *recip;
+     char *name;
+     double *data;
+     int i;
+
+     if (!ln_hash_find_extended(producers, src->name, (void **)&op)
+         || strcmp(op->op_arg->optype, "create") || !is_float_const(op))
+          return NULL;
+     data_pe = ln_param_table_find_by_arg_name(op->op_arg->params, "data");
+     dims_pe = ln_param_table_find_by_arg_name(op->op_arg->params, "dims");
+     dtype_pe = ln_param_table_find_by_arg_name(op->op_arg->params, "dtype");
+     if (!data_pe || data_pe->type != LN_PARAM_ARRAY_NUMBER || !dims_pe
+         || dims_pe->type != LN_PARAM_ARRAY_NUMBER)
+          return NULL;
+     for (i = 0; i < data_pe->array_len; i++) {
+          if (data_pe->value_array_double[i] == 0)
+               return NULL;
+     }
+
+     name = ln_alloc(strlen(src->name) + sizeof("_recip"));
+     sprintf(name, "%s_recip", src->name);
+     if (ln_hash_find_extended(producers, name, (void **)&recip)) {
+          ln_free(name);
+          return recip;
+     }
+     data = ln_alloc(sizeof(double) * data_pe->array_len);
+     for (i = 0; i < data_pe->array_len; i++)
+          data[i] = 1 / data_pe->value_array_double[i];
+     params = ln_param_table_append_string(NULL, "dtype",
+                                           dtype_pe->value_string);
+     params = ln_param_table_append_array_number(params, "dims",
+                                                 dims_pe->array_len,
+                                                 dims_pe->value_array_double);
+     params = ln_param_table_append_array_number(params, "data",
+                                                 data_pe->array_len, data);
+     tensors_out = ln_tensor_table_append(NULL, "dst", name, src->mtype, NULL);
+     recip = ln_op_create(name, op->op_arg->optype, NULL, tensors_out, params,
+                          op->pre_run, op->run, op->post_run);
+     ln_op_copy_impl(recip, op);
+     *new_ops = ln_list_append(*new_ops, recip);
+     ln_hash_insert(producers,
+                    ((ln_tensor_entry *)recip->op_arg->tensors_out->data)->name,
+                    recip);
+     ln_free(data);
+     ln_free(name);
+
+     return recip;
+}
+
+/* an elew op computing src * src, for x^3 and x^4 */
+static ln_op *square_op(ln_op *op, ln_tensor_entry *src, ln_tensor_entry *dst)
+{
+     ln_tensor_table *tensors_in, *tensors_out;
+     ln_param_table *params;
+     char *name, *dst_name;
+     ln_op *sq;
+
+     name = ln_alloc(strlen(op->op_arg->name) + sizeof("_sq"));
+     sprintf(name, "%s_sq", op->op_arg->name);
+     dst_name = ln_alloc(strlen(dst->name) + sizeof("_sq"));
+     sprintf(dst_name, "%s_sq", dst->name);
+     tensors_in = ln_tensor_table_append(NULL, "src1", src->name,
+                                         src->mtype, NULL);
+     tensors_in = ln_tensor_table_append(tensors_in, "src2", src->name,
+                                         src->mtype, NULL);
+     tensors_out = ln_tensor_table_append(NULL, "dst", dst_name,
+                                          dst->mtype, NULL);
+     params = ln_param_table_append_string(NULL, "elew_op", "TL_MUL");
+     sq = ln_op_create(name, op->op_arg->optype, tensors_in, tensors_out,
+                       params, op->pre_run, op->run, op->post_run);
+     ln_op_copy_impl(sq, op);
+     ln_free(dst_name);
+     ln_free(name);
+
+     return sq;
+}
+
+static void set_string_param(ln_param_entry *pe, const char *string)
+{
+     ln_free(pe->value_string);
+     pe->value_string = ln_strdup(string);
+}
+
+/*
+ * Simplify elew ops against constant operands, which are create outputs
+ * with data or zeros outputs:
+ * x*1, 1*x, x/1, x^1, x+0, 0+x and x-0 are removed and their readers read
+ * x instead, unless they are in outputs, the graph output names;
+ * x^2, x^3 and x^4 become multiplies;
+ * x/c of a float create c without zeros becomes x*(1/c), with a new create
+ * op for 1/c.
+ * x^0.5 is left as is, since there is no sqrt kernel. Constant ops no
+ * longer read are left to ln_optimize_dce(). Ops are prepared again if any
+ * op changes, so, like ln_optimize_cse(), this pass skips lists with folded
+ * or recompute ops or tensors defined twice, with a warning. If n_simplified
+ * isn't NULL, it returns the number of ops simplified.
+ */
+ln_list *ln_optimize_simplify(ln_list *ops, ln_list *outputs,
+                              int *n_simplified, ln_error **error)
+{
+     ln_hash *producers;        /* name -> op creating it */
+     ln_hash *renames;          /* removed output name -> its source name */
+     ln_hash *outs;
+     ln_tensor_entry *te, *src1, *src2, *dst, *x;
+     ln_param_entry *elew_op;
+     ln_list *new_ops;
+     ln_op *op, *recip, *sq;
+     int has1, has2, n, unprepared;
+     double v1, v2;
+     char *eop;
+
+     if (n_simplified)
+          *n_simplified = 0;
+     if (!can_reprepare(ops)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_simplify(): ops have folded or recompute ops or tensors defined twice, skipped");
+          return ops;
+     }
+
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     renames = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, ln_free);
+     outs = output_set(outputs);
+
+     new_ops = NULL;
+     n = 0;
+     unprepared = 0;
+     LN_LIST_FOREACH(op, ops) {
+          rename_inputs(op, renames);
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(producers, te->name, op);
+          }
+          src1 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+          src2 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+          dst = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+          elew_op = ln_param_table_find_by_arg_name(op->op_arg->params, "elew_op");
+          if (strcmp(op->op_arg->optype, "elew") || !src1 || !src2 || !dst
+              || !elew_op || elew_op->type != LN_PARAM_STRING) {
+               new_ops = ln_list_append(new_ops, op);
+               continue;
+          }
+
+          eop = elew_op->value_string;
+          has1 = uniform_value(producers, src1->name, &v1);
+          has2 = uniform_value(producers, src2->name, &v2);
+          x = NULL;
+          if (has2 && v2 == 1 && (!strcmp(eop, "TL_MUL")
+                                  || !strcmp(eop, "TL_DIV")
+                                  || !strcmp(eop, "TL_POW")))
+               x = src1;
+          else if (has1 && v1 == 1 && !strcmp(eop, "TL_MUL"))
+               x = src2;
+          else if (has2 && v2 == 0 && (!strcmp(eop, "TL_SUM")
+                                       || !strcmp(eop, "TL_SUB")))
+               x = src1;
+          else if (has1 && v1 == 0 && !strcmp(eop, "TL_SUM"))
+               x = src2;
+          if (x && ln_hash_find_extended(outs, dst->name, NULL))
+               x = NULL;
+
+          recip = NULL;
+          if (!x && !strcmp(eop, "TL_DIV"))
+               recip = reciprocal_op(producers, src2, &new_ops);
+          if (x || recip || (has2 && !strcmp(eop, "TL_POW")
+                             && (v2 == 2 || v2 == 3 || v2 == 4))) {
+               if (!unprepare_once(ops, &unprepared, error))
+                    break;
+               n++;
+          }
+
+          if (x) {
+               ln_hash_insert(renames, ln_strdup(dst->name),
+                              ln_strdup(x->name));
+               op_free_tables_too(op);
+               continue;
+          }
+          if (recip) {
+               te = recip->op_arg->tensors_out->data;
+               set_string_param(elew_op, "TL_MUL");
+               rename_tensor(src2, te->name);
+          } else if (has2 && !strcmp(eop, "TL_POW") && v2 == 2) {
+               set_string_param(elew_op, "TL_MUL");
+               rename_tensor(src2, src1->name);
+          } else if (has2 && !strcmp(eop, "TL_POW") && (v2 == 3 || v2 == 4)) {
+               sq = square_op(op, src1, dst);
+               new_ops = ln_list_append(new_ops, sq);
+               te = sq->op_arg->tensors_out->data;
+               set_string_param(elew_op, "TL_MUL");
+               if (v2 == 4)
+                    rename_tensor(src2, te->name);
+               else
+                    rename_tensor(src2, src1->name);
+               rename_tensor(src1, te->name);
+          }
+          new_ops = ln_list_append(new_ops, op);
+     }
+     ln_hash_free(outs);
+     ln_hash_free(renames);
+     ln_hash_free(producers);
+
+     if (*error || !unprepared) {
+          ln_list_free(new_ops);
+          return ops;
+     }
+     ln_list_free(ops);
+     prepare_ops(new_ops, error);
+     if (n_simplified)
+          *n_simplified = n;
+     return new_ops;
+}
+
+/* read counts by name, for passes that rewire inputs */
+static ssize_t read_count_get(ln_hash *counts, char *name)
+{
+     ssize_t count;
+
+     if (!ln_hash_find_extended(counts, name, (void **)&count))
+          return 0;
+     return count;
+}
+
+static void read_count_add(ln_hash *counts, char *name, ssize_t n)
+{
+     ln_hash_insert(counts, ln_strdup(name),
+                    (void *)(read_count_get(counts, name) + n));
+}
+
+static void rewire_input(ln_hash *counts, ln_tensor_entry *te,
+                         const char *name)
+{
+     read_count_add(counts, te->name, -1);
+     rename_tensor(te, name);
+     read_count_add(counts, te->name, 1);
+}
+
+static int is_optype(ln_op *op, const char *optype)
+{
+     return op && !strcmp(op->op_arg->optype, optype);
+}
+
+static ln_op *producer_of(ln_hash *producers, ln_tensor_entry *te)
+{
+     ln_op *op;
+
+     if (!te || !ln_hash_find_extended(producers, te->name, (void **)&op))
+          return NULL;
+     return op;
+}
+
+static ln_tensor_entry *src_entry(ln_op *op)
+{
+     return ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+}
+
+static ln_tensor_entry *dst_entry(ln_op *op)
+{
+     return ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+}
+
+/* the "axes" param of a transpose op, or NULL if it's malformed */
+static ln_param_entry *axes_param(ln_op *op)
+{
+     ln_param_entry *pe;
+
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "axes");
+     if (!pe || pe->type != LN_PARAM_ARRAY_NUMBER)
+          return NULL;
+     return pe;
+}
+
+static int is_identity_axes(ln_param_entry *axes)
+{
+     int i;
+
+     for (i = 0; i < axes->array_len; i++) {
+          if (axes->value_array_int[i] != i)
+               return 0;
+     }
+     return 1;
+}
+
+static int is_same_axes(ln_param_entry *a, ln_param_entry *b)
+{
+     int i;
+
+     if (a->array_len != b->array_len)
+          return 0;
+     for (i = 0; i < a->array_len; i++) {
+          if (a->value_array_int[i] != b->value_array_int[i])
+               return 0;
+     }
+     return 1;
+}
+
+/*
+ * Transposing by first then by second is transposing by
+ * first[second[i]] at axis i.
+ */
+static void compose_axes(ln_param_entry *first, ln_param_entry *second)
+{
+     double *axes;
+     int i;
+
+     axes = ln_alloc(sizeof(double) * second->array_len);
+     for (i = 0; i < second->array_len; i++)
+          axes[i] = first->value_array_int[second->value_array_int[i]];
+     for (i = 0; i < second->array_len; i++) {
+          second->value_array_double[i] = axes[i];
+          second->value_array_int[i] = (int)axes[i];
+     }
+     ln_free(axes);
+}
+
+/* a transpose op like trans, from src_name to dst_name */
+static ln_op *transpose_op_create(ln_op *trans, const char *name,
+                                  const char *src_name, const char *dst_name,
+                                  ln_mem_type mtype)
+{
+     ln_tensor_table *tensors_in, *tensors_out;
+     ln_param_table *params;
+     ln_param_entry *axes;
+     ln_op *op;
+
+     axes = axes_param(trans);
+     tensors_in = ln_tensor_table_append(NULL, "src", src_name, mtype, NULL);
+     tensors_out = ln_tensor_table_append(NULL, "dst", dst_name, mtype, NULL);
+     params = ln_param_table_append_array_number(NULL, "axes",
+                                                 axes->array_len,
+                                                 axes->value_array_double);
+     op = ln_op_create(name, trans->op_arg->optype, tensors_in, tensors_out,
+                       params, trans->pre_run, trans->run, trans->post_run);
+     ln_op_copy_impl(op, trans);
+
+     return op;
+}
+
+/*
+ * The transpose both inputs of an elew op come from, if they are transposed
+ * the same way and read only by this op, so the transpose can be sunk
+ * below the op.
+ */
+static ln_op *sinkable_transpose(ln_op *op, ln_hash *producers,
+                                 ln_hash *counts)
+{
+     ln_tensor_entry *src1, *src2;
+     ln_param_entry *axes1, *axes2;
+     ln_op *trans1, *trans2;
+     ssize_t reads1, reads2;
+
+     src1 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+     src2 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     trans1 = producer_of(producers, src1);
+     trans2 = producer_of(producers, src2);
+     if (!dst_entry(op) || !is_optype(trans1, "transpose")
+         || !is_optype(trans2, "transpose"))
+          return NULL;
+     axes1 = axes_param(trans1);
+     axes2 = axes_param(trans2);
+     if (!axes1 || !axes2 || !is_same_axes(axes1, axes2))
+          return NULL;
+     reads1 = read_count_get(counts, src1->name);
+     reads2 = read_count_get(counts, src2->name);
+     if (trans1 == trans2)
+          return reads1 == 2 ? trans1 : NULL;
+     return reads1 == 1 && reads2 == 1 ? trans1 : NULL;
+}
+
+static int is_layout_optype(ln_op *op)
+{
+     return is_optype(op, "transpose") || is_optype(op, "reshape");
+}
+
+/*
+ * Canonicalize transposes and reshapes:
+ * a transpose of a transpose becomes one transpose by the composed axes;
+ * a transpose by identity axes, 0..n-1, is removed and its readers read
+ * its input, unless it is in outputs, the graph output names;
+ * a reshape of a reshape becomes one reshape of the first input;
+ * an elew op of two inputs transposed the same way, read only by it, is
+ * computed on the untransposed inputs and transposed after, so that the
+ * transpose may cancel with a later one.
+ * Transposes and reshapes left unread by these rewrites are removed, but
+ * for those creating graph outputs. Ops
+ * are prepared again if any op changes, so, like ln_optimize_cse(), this
+ * pass skips lists with folded or recompute ops or tensors defined twice,
+ * with a warning. If n_rewritten isn't NULL, it returns the number of
+ * rewrites.
+ */
+ln_list *ln_optimize_transpose(ln_list *ops, ln_list *outputs,
+                               int *n_rewritten, ln_error **error)
+{
+     ln_hash *producers;        /* name -> op creating it */
+     ln_hash *renames;          /* removed output name -> its source name */
+     ln_hash *counts;           /* name -> number of entries reading it */
+     ln_hash *read;             /* names read before this pass */
+     ln_hash *outs;
+     ln_tensor_entry *te, *src, *dst, *src1, *src2;
+     ln_param_entry *axes;
+     ln_list *new_ops, *rev_ops;
+     ln_op *op, *prev, *trans, *sunk;
+     int n, unprepared, unread;
+     char *name, *new_name;
+
+     if (n_rewritten)
+          *n_rewritten = 0;
+     if (!can_reprepare(ops)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_transpose(): ops have folded or recompute ops or tensors defined twice, skipped");
+          return ops;
+     }
+
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     renames = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, ln_free);
+     counts = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     read = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               read_count_add(counts, te->name, 1);
+               ln_hash_insert(read, ln_strdup(te->name), NULL);
+          }
+     }
+     outs = output_set(outputs);
+
+     new_ops = NULL;
+     n = 0;
+     unprepared = 0;
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (ln_hash_find_extended(renames, te->name, (void **)&name))
+                    rewire_input(counts, te, name);
+          }
+          src = src_entry(op);
+          dst = dst_entry(op);
+          prev = producer_of(producers, src);
+
+          if (is_optype(op, "transpose") && src && dst && axes_param(op)) {
+               axes = axes_param(op);
+               if (is_optype(prev, "transpose") && axes_param(prev)
+                   && src_entry(prev)) {
+                    if (!unprepare_once(ops, &unprepared, error))
+                         break;
+                    compose_axes(axes_param(prev), axes);
+                    rewire_input(counts, src, src_entry(prev)->name);
+                    n++;
+               }
+               if (is_identity_axes(axes)
+                   && !ln_hash_find_extended(outs, dst->name, NULL)) {
+                    if (!unprepare_once(ops, &unprepared, error))
+                         break;
+                    ln_hash_insert(renames, ln_strdup(dst->name),
+                                   ln_strdup(src->name));
+                    read_count_add(counts, src->name, -1);
+                    op_free_tables_too(op);
+                    n++;
+                    continue;
+               }
+          } else if (is_optype(op, "reshape") && src && is_optype(prev, "reshape")
+                     && src_entry(prev)) {
+               if (!unprepare_once(ops, &unprepared, error))
+                    break;
+               rewire_input(counts, src, src_entry(prev)->name);
+               n++;
+          } else if (is_optype(op, "elew")
+                     && (trans = sinkable_transpose(op, producers, counts))) {
+               if (!unprepare_once(ops, &unprepared, error))
+                    break;
+               src1 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in,
+                                                       "src1");
+               src2 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in,
+                                                       "src2");
+               rewire_input(counts, src1,
+                            src_entry(producer_of(producers, src1))->name);
+               rewire_input(counts, src2,
+                            src_entry(producer_of(producers, src2))->name);
+               new_name = ln_alloc(strlen(dst->name) + sizeof("_untransposed"));
+               sprintf(new_name, "%s_untransposed", dst->name);
+               name = ln_alloc(strlen(op->op_arg->name) + sizeof("_transpose"));
+               sprintf(name, "%s_transpose", op->op_arg->name);
+               sunk = transpose_op_create(trans, name, new_name, dst->name,
+                                          dst->mtype);
+               te = dst_entry(sunk);
+               te->isdead = dst->isdead;
+               dst->isdead = 0;
+               rename_tensor(dst, new_name);
+               read_count_add(counts, new_name, 1);
+               ln_hash_insert(producers, dst->name, op);
+               new_ops = ln_list_append(new_ops, op);
+               op = sunk;
+               ln_free(new_name);
+               ln_free(name);
+               n++;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(producers, te->name, op);
+          }
+          new_ops = ln_list_append(new_ops, op);
+     }
+
+     if (!*error && unprepared) {
+          rev_ops = NULL;
+          LN_LIST_FOREACH(op, new_ops) {
+               rev_ops = ln_list_prepend(rev_ops, op);
+          }
+          LN_LIST_FOREACH(op, rev_ops) {
+               if (!is_layout_optype(op) || creates_output(op, outs))
+                    continue;
+               unread = 1;
+               LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+                    if (read_count_get(counts, te->name)
+                        || !ln_hash_find_extended(read, te->name, NULL))
+                         unread = 0;
+               }
+               if (!unread)
+                    continue;
+               LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+                    read_count_add(counts, te->name, -1);
+               }
+               new_ops = ln_list_remove(new_ops, op);
+               op_free_tables_too(op);
+          }
+          ln_list_free(rev_ops);
+     }
+     ln_hash_free(outs);
+     ln_hash_free(read);
+     ln_hash_free(counts);
+     ln_hash_free(renames);
+     ln_hash_free(producers);
+
+     if (*error || !unprepared) {
+          ln_list_free(new_ops);
+          return ops;
+     }
+     ln_list_free(ops);
+     prepare_ops(new_ops, error);
+     if (n_rewritten)
+          *n_rewritten = n;
+     return new_ops;
+}
+
+/*
+ * A fused elementwise expression, as in the "expr" param of elew_fused.
+ * Node operands >= 0 are sources and < 0 are nodes, -1 - k for node k.
+ */
+struct fuse_node {
+     char *op;
+     int   a;
+     int   b;
+};
+
+struct fuse_expr {
+     int                n_srcs;
+     char             **srcs;
+     ln_mem_type       *mtypes;
+     int                n_nodes;
+     struct fuse_node  *nodes;
+     int                grown;  /* whether other ops were inlined into it */
+};
+
+static int is_fuse_elew_op(const char *str)
+{
+     static const char *elew_ops[] = {
+          "TL_MUL", "TL_DIV", "TL_SUM", "TL_SUB", "TL_MAX", "TL_MIN",
+          "TL_POW", NULL
+     };
+     int i;
+
+     for (i = 0; elew_ops[i]; i++) {
+          if (!strcmp(str, elew_ops[i]))
+               return 1;
+     }
+     return 0;
+}
+
+/* an empty expression with room for max_srcs sources and max_nodes nodes */
+static struct fuse_expr *fuse_expr_create(int max_srcs, int max_nodes)
+{
+     struct fuse_expr *e;
+
+     e = ln_alloc(sizeof(struct fuse_expr));
+     e->n_srcs = 0;
+     e->srcs = ln_alloc(sizeof(char *) * max_srcs);
+     e->mtypes = ln_alloc(sizeof(ln_mem_type) * max_srcs);
+     e->n_nodes = 0;
+     e->nodes = ln_alloc(sizeof(struct fuse_node) * max_nodes);
+     e->grown = 0;
+     return e;
+}
+
+static void fuse_expr_free(void *p)
+{
+     struct fuse_expr *e = p;
+     int i;
+
+     for (i = 0; i < e->n_srcs; i++)
+          ln_free(e->srcs[i]);
+     for (i = 0; i < e->n_nodes; i++)
+          ln_free(e->nodes[i].op);
+     ln_free(e->srcs);
+     ln_free(e->mtypes);
+     ln_free(e->nodes);
+     ln_free(e);
+}
+
+/* the operand of source name in e, added if it isn't there */
+static int fuse_add_src(struct fuse_expr *e, const char *name,
+                        ln_mem_type mtype)
+{
+     int i;
+
+     for (i = 0; i < e->n_srcs; i++) {
+          if (!strcmp(e->srcs[i], name))
+               return i;
+     }
+     e->srcs[e->n_srcs] = ln_strdup(name);
+     e->mtypes[e->n_srcs] = mtype;
+     return e->n_srcs++;
+}
+
+/* the operand of node op(a, b), added to e */
+static int fuse_add_node(struct fuse_expr *e, const char *op, int a, int b)
+{
+     e->nodes[e->n_nodes].op = ln_strdup(op);
+     e->nodes[e->n_nodes].a = a;
+     e->nodes[e->n_nodes].b = b;
+     return -1 - e->n_nodes++;
+}
+
+/* an operand "sK" or "nK" of node n, or INT_MAX if it isn't valid */
+static int fuse_parse_operand(const char *str, int n_srcs, int n)
+{
+     char *end;
+     long k;
+
+     if (str[0] != 's' && str[0] != 'n')
+          return INT_MAX;
+     k = strtol(str + 1, &end, 10);
+     if (end == str + 1 || *end != '\0' || k < 0)
+          return INT_MAX;
+     if (str[0] == 's')
+          return k < n_srcs ? k : INT_MAX;
+     return k < n ? -1 - k : INT_MAX;
+}
+
+/*
+ * The expression of an elew op or an elew_fused op with a float "dst", or
+ * NULL if op isn't one of them or is malformed.
+ */
+static struct fuse_expr *fuse_expr_of(ln_op *op)
+{
+     ln_tensor_entry *src1, *src2, *dst, *te;
+     ln_param_entry *pe;
+     struct fuse_expr *e;
+     char name[32], eop[16], a[16], b[16];
+     int i, n, x, y;
+
+     dst = dst_entry(op);
+     if (!dst || !dst->tensor || dst->tensor->dtype != TL_FLOAT)
+          return NULL;
+
+     if (is_optype(op, "elew")) {
+          src1 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+          src2 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+          pe = ln_param_table_find_by_arg_name(op->op_arg->params, "elew_op");
+          if (!src1 || !src2 || !pe || pe->type != LN_PARAM_STRING
+              || !is_fuse_elew_op(pe->value_string))
+               return NULL;
+          e = fuse_expr_create(2, 1);
+          x = fuse_add_src(e, src1->name, src1->mtype);
+          y = fuse_add_src(e, src2->name, src2->mtype);
+          fuse_add_node(e, pe->value_string, x, y);
+          return e;
+     }
+
+     if (!is_optype(op, "elew_fused"))
+          return NULL;
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "expr");
+     if (!pe || pe->type != LN_PARAM_ARRAY_STRING || pe->array_len < 1)
+          return NULL;
+     n = ln_tensor_table_length(op->op_arg->tensors_in);
+     e = fuse_expr_create(n, pe->array_len);
+     for (i = 0; i < n; i++) {
+          snprintf(name, sizeof(name), "src%d", i);
+          te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, name);
+          if (!te || fuse_add_src(e, te->name, te->mtype) != i)
+               goto error;
+     }
+     for (i = 0; i < pe->array_len; i++) {
+          if (sscanf(pe->value_array_string[i], "%15s %15s %15s",
+                     eop, a, b) != 3 || !is_fuse_elew_op(eop))
+               goto error;
+          x = fuse_parse_operand(a, n, i);
+          y = fuse_parse_operand(b, n, i);
+          if (x == INT_MAX || y == INT_MAX)
+               goto error;
+          fuse_add_node(e, eop, x, y);
+     }
+     return e;
+
+error:
+     fuse_expr_free(e);
+     return NULL;
+}
+
+/*
+ * Add the nodes of from to e, with source i of from as operand srcs[i].
+ * Returns the operand of the last node.
+ */
+static int fuse_copy_nodes(struct fuse_expr *e, struct fuse_expr *from,
+                           int *srcs)
+{
+     struct fuse_node *node;
+     int *nodes, i, a, b, x;
+
+     nodes = ln_alloc(sizeof(int) * from->n_nodes);
+     for (i = 0; i < from->n_nodes; i++) {
+          node = &from->nodes[i];
+          a = node->a >= 0 ? srcs[node->a] : nodes[-1 - node->a];
+          b = node->b >= 0 ? srcs[node->b] : nodes[-1 - node->b];
+          nodes[i] = fuse_add_node(e, node->op, a, b);
+     }
+     x = nodes[from->n_nodes - 1];
+     ln_free(nodes);
+     return x;
+}
+
+/* e with its source k replaced by the expression p */
+static struct fuse_expr *fuse_inline(struct fuse_expr *e, int k,
+                                     struct fuse_expr *p)
+{
+     struct fuse_expr *r;
+     int *srcs, i, x;
+
+     r = fuse_expr_create(e->n_srcs + p->n_srcs, e->n_nodes + p->n_nodes);
+     srcs = ln_alloc(sizeof(int) * p->n_srcs);
+     for (i = 0; i < p->n_srcs; i++)
+          srcs[i] = fuse_add_src(r, p->srcs[i], p->mtypes[i]);
+     x = fuse_copy_nodes(r, p, srcs);
+     ln_free(srcs);
+
+     srcs = ln_alloc(sizeof(int) * e->n_srcs);
+     for (i = 0; i < e->n_srcs; i++) {
+          if (i == k)
+               srcs[i] = x;
+          else
+               srcs[i] = fuse_add_src(r, e->srcs[i], e->mtypes[i]);
+     }
+     fuse_copy_nodes(r, e, srcs);
+     ln_free(srcs);
+     r->grown = 1;
+
+     return r;
+}
+
+/* an elew_fused op computing e, replacing op */
+static ln_op *fused_op_create(ln_op *proto, ln_op *op, struct fuse_expr *e)
+{
+     ln_tensor_table *tensors_in, *tensors_out;
+     ln_tensor_entry *dst, *te;
+     ln_param_table *params;
+     struct fuse_node *node;
+     char name[32], **strs;
+     ln_op *fused;
+     int i;
+
+     tensors_in = NULL;
+     for (i = 0; i < e->n_srcs; i++) {
+          snprintf(name, sizeof(name), "src%d", i);
+          tensors_in = ln_tensor_table_append(tensors_in, name, e->srcs[i],
+                                              e->mtypes[i], NULL);
+     }
+     dst = dst_entry(op);
+     tensors_out = ln_tensor_table_append(NULL, "dst", dst->name, dst->mtype,
+                                          NULL);
+     te = tensors_out->data;
+     te->isdead = dst->isdead;
+
+     strs = ln_alloc(sizeof(char *) * e->n_nodes);
+     for (i = 0; i < e->n_nodes; i++) {
+          node = &e->nodes[i];
+          strs[i] = ln_alloc(strlen(node->op) + 2 * 16);
+          sprintf(strs[i], "%s %c%d %c%d", node->op,
+                  node->a >= 0 ? 's' : 'n', node->a >= 0 ? node->a : -1 - node->a,
+                  node->b >= 0 ? 's' : 'n', node->b >= 0 ? node->b : -1 - node->b);
+     }
+     params = ln_param_table_append_array_string(NULL, "expr", e->n_nodes,
+                                                 strs);
+     for (i = 0; i < e->n_nodes; i++)
+          ln_free(strs[i]);
+     ln_free(strs);
+
+     fused = ln_op_create(op->op_arg->name, proto->op_arg->optype, tensors_in,
+                          tensors_out, params, proto->pre_run, proto->run,
+                          proto->post_run);
+     ln_op_copy_impl(fused, proto);
+
+     return fused;
+}
+
+/*
+ * Fuse chains of elementwise ops into elew_fused ops, which compute a
+ * whole expression per element with no intermediate tensors, compiled by
+ * ln_jit_compile(). An elew or elew_fused op with a float "dst" that only
+ * one other such op reads, and that isn't in outputs, is inlined into its
+ * reader, which becomes an elew_fused op of the same name and "dst".
+ * Sources read by several inlined ops are read once. The registered
+ * "elew_fused" op is used for the new ops. Ops are prepared again, so,
+ * like ln_optimize_simplify(), this pass skips lists with folded or
+ * recompute ops or tensors defined twice, with a warning. If n_fused isn't
+ * NULL, it returns the number of ops inlined.
+ */
+ln_list *ln_optimize_fuse(ln_list *ops, ln_list *registered_ops,
+                          ln_list *outputs, int *n_fused, ln_error **error)
+{
+     ln_hash *counts;           /* name -> number of ops reading it */
+     ln_hash *producers;        /* name -> fusable op creating it */
+     ln_hash *exprs;            /* fusable op -> its expression */
+     ln_hash *inlined;          /* ops inlined into their readers */
+     ln_hash *outs;
+     ln_tensor_entry *te, *prev;
+     struct fuse_expr *e, *p, *r;
+     ln_list *new_ops;
+     ln_op *op, *prod, *proto, *fused;
+     char *name;
+     int n, k, dup;
+
+     if (n_fused)
+          *n_fused = 0;
+     if (!(proto = ln_op_list_find_by_optype(registered_ops, "elew_fused"))) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_fuse(): \"elew_fused\" isn't registered, skipped");
+          return ops;
+     }
+     if (!can_reprepare(ops)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_fuse(): ops have folded or recompute ops or tensors defined twice, skipped");
+          return ops;
+     }
+
+     counts = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     producers = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     exprs = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL,
+                            fuse_expr_free);
+     inlined = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     outs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(name, outputs) {
+          ln_hash_insert(outs, name, NULL);
+     }
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               dup = 0;
+               LN_LIST_FOREACH(prev, op->op_arg->tensors_in) {
+                    if (prev == te)
+                         break;
+                    if (!strcmp(prev->name, te->name))
+                         dup = 1;
+               }
+               if (!dup)
+                    read_count_add(counts, te->name, 1);
+          }
+     }
+
+     n = 0;
+     LN_LIST_FOREACH(op, ops) {
+          if (!(e = fuse_expr_of(op)))
+               continue;
+          for (k = 0; k < e->n_srcs;) {
+               name = e->srcs[k];
+               if (!ln_hash_find_extended(producers, name, (void **)&prod)
+                   || read_count_get(counts, name) != 1
+                   || ln_hash_find_extended(outs, name, NULL)) {
+                    k++;
+                    continue;
+               }
+               p = ln_hash_find(exprs, prod);
+               r = fuse_inline(e, k, p);
+               fuse_expr_free(e);
+               e = r;
+               ln_hash_insert(inlined, prod, NULL);
+               n++;
+               k = 0;           /* sources have moved */
+          }
+          ln_hash_insert(exprs, op, e);
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(producers, te->name, op);
+          }
+     }
+
+     new_ops = NULL;
+     if (n > 0)
+          unprepare_ops(ops, error);
+     if (n > 0 && !*error) {
+          LN_LIST_FOREACH(op, ops) {
+               if (ln_hash_find_extended(inlined, op, NULL)) {
+                    op_free_tables_too(op);
+                    continue;
+               }
+               e = ln_hash_find(exprs, op);
+               if (e && e->grown) {
+                    fused = fused_op_create(proto, op, e);
+                    op_free_tables_too(op);
+                    op = fused;
+               }
+               new_ops = ln_list_append(new_ops, op);
+          }
+     }
+     ln_hash_free(outs);
+     ln_hash_free(inlined);
+     ln_hash_free(exprs);
+     ln_hash_free(producers);
+     ln_hash_free(counts);
+
+     if (*error || n == 0) {
+          ln_list_free(new_ops);
+          return ops;
+     }
+     ln_list_free(ops);
+     prepare_ops(new_ops, error);
+     if (n_fused)
+          *n_fused = n;
+     return new_ops;
+}
+
+/*
+ * Placement of ops on backends. Reads are flattened into (op, tensor)
+ * pairs, with op -1 for graph outputs, which are read by the host.
+ */
+struct placement {
+     int          n_ops;
+     int          n_backends;
+     int          n_tensors;
+     int          n_reads;
+     ln_backend **backends;     /* the host first */
+     ln_op      **protos;       /* [op * n_backends + b], NULL if not runnable */
+     double      *times;        /* [op * n_backends + b], estimated run time */
+     int         *current;      /* backend each op is on now */
+     int         *producers;    /* op creating each tensor, or -1 */
+     size_t      *sizes;        /* bytes of each tensor */
+     int         *read_ops;
+     int         *read_tensors;
+     char        *needed;       /* [tensor * n_backends + b], scratch */
+};
+
+static void placement_free(struct placement *pl)
+{
+     ln_free(pl->backends);
+     ln_free(pl->protos);
+     ln_free(pl->times);
+     ln_free(pl->current);
+     ln_free(pl->producers);
+     ln_free(pl->sizes);
+     ln_free(pl->read_ops);
+     ln_free(pl->read_tensors);
+     ln_free(pl->needed);
+     ln_free(pl);
+}
+
+/* roofline estimate of one run of op on backend */
+static double op_time(ln_op *op, ln_backend *backend)
+{
+     ln_op_cost cost;
+     double compute, memory;
+
+     ln_op_get_cost(op, &cost);
+     compute = backend->gflops > 0 ? cost.flops / (backend->gflops * 1e9) : 0;
+     memory = backend->gbps > 0 ?
+          (cost.bytes_read + cost.bytes_written) / (backend->gbps * 1e9) : 0;
+     return compute > memory ? compute : memory;
+}
+
+/* moving between two devices goes through the host */
+static double transfer_time(struct placement *pl, int from, int to,
+                            size_t size)
+{
+     ln_backend *backend;
+     double t = 0;
+     int i, ends[2] = {from, to};
+
+     for (i = 0; i < 2; i++) {
+          if (ends[i] == 0)
+               continue;
+          backend = pl->backends[ends[i]];
+          t += backend->link_latency;
+          if (backend->link_gbps > 0)
+               t += size / (backend->link_gbps * 1e9);
+     }
+     return t;
+}
+
+static int home_of(struct placement *pl, int *assign, int tensor)
+{
+     return pl->producers[tensor] < 0 ? 0 : assign[pl->producers[tensor]];
+}
+
+static int reader_of(int *assign, int op)
+{
+     return op < 0 ? 0 : assign[op];
+}
+
+/* estimated time of a run of all ops, each tensor moved once per backend */
+static double placement_time(struct placement *pl, int *assign)
+{
+     double total = 0;
+     int i, t, home, b;
+
+     for (i = 0; i < pl->n_ops; i++)
+          total += pl->times[i * pl->n_backends + assign[i]];
+     memset(pl->needed, 0, pl->n_tensors * pl->n_backends);
+     for (i = 0; i < pl->n_reads; i++) {
+          t = pl->read_tensors[i];
+          home = home_of(pl, assign, t);
+          b = reader_of(assign, pl->read_ops[i]);
+          if (home == b || pl->needed[t * pl->n_backends + b])
+               continue;
+          pl->needed[t * pl->n_backends + b] = 1;
+          total += transfer_time(pl, home, b, pl->sizes[t]);
+     }
+     return total;
+}
+
+/* the backend whose optype suffix op has, or the host; set base optype */
+static int current_backend(struct placement *pl, ln_op *op, char **base)
+{
+     const char *optype, *suffix;
+     size_t len, suffix_len;
+     int b;
+
+     optype = op->op_arg->optype;
+     len = strlen(optype);
+     for (b = 1; b < pl->n_backends; b++) {
+          suffix = pl->backends[b]->suffix;
+          suffix_len = strlen(suffix);
+          if (suffix_len && len > suffix_len
+              && !strcmp(optype + len - suffix_len, suffix)) {
+               *base = ln_alloc(len - suffix_len + 1);
+               memcpy(*base, optype, len - suffix_len);
+               (*base)[len - suffix_len] = '\0';
+               return b;
+          }
+     }
+     *base = ln_strdup(optype);
+     return 0;
+}
+
+static ln_op *find_proto(ln_list *registered_ops, const char *base,
+                         const char *suffix)
+{
+     ln_op *proto;
+     char *optype;
+
+     optype = ln_alloc(strlen(base) + strlen(suffix) + 1);
+     sprintf(optype, "%s%s", base, suffix);
+     proto = ln_op_list_find_by_optype(registered_ops, optype);
+     ln_free(optype);
+     return proto;
+}
+
+static struct placement *placement_create(ln_list *ops,
+                                          ln_list *registered_ops,
+                                          ln_list *backends, ln_hash *outs)
+{
+     struct placement *pl;
+     ln_hash *ids;              /* name -> tensor index + 1 */
+     ln_tensor_entry *te;
+     ln_backend *backend;
+     ln_op *op;
+     char *base;
+     ssize_t id;
+     int i, b, nb;
+
+     pl = ln_alloc(sizeof(struct placement));
+     memset(pl, 0, sizeof(struct placement));
+     pl->n_ops = ln_list_length(ops);
+     pl->backends = ln_alloc(sizeof(ln_backend *) * ln_list_length(backends));
+     LN_LIST_FOREACH(backend, backends) {
+          /* a device without a registered copy op can't be reached */
+          if (pl->n_backends > 0 && (!backend->copy_optype
+                                     || !ln_op_list_find_by_optype(registered_ops,
+                                                                   (char *)backend->copy_optype)))
+               continue;
+          pl->backends[pl->n_backends++] = backend;
+     }
+     nb = pl->n_backends;
+
+     ids = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (!ln_hash_find_extended(ids, te->name, NULL))
+                    ln_hash_insert(ids, te->name, (void *)(ssize_t)++pl->n_tensors);
+               pl->n_reads++;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!ln_hash_find_extended(ids, te->name, NULL))
+                    ln_hash_insert(ids, te->name, (void *)(ssize_t)++pl->n_tensors);
+               if (ln_hash_find_extended(outs, te->name, NULL) && !te->isdead)
+                    pl->n_reads++;
+          }
+     }
+
+     pl->protos = ln_alloc(sizeof(ln_op *) * pl->n_ops * nb);
+     pl->times = ln_alloc(sizeof(double) * pl->n_ops * nb);
+     pl->current = ln_alloc(sizeof(int) * pl->n_ops);
+     pl->producers = ln_alloc(sizeof(int) * pl->n_tensors);
+     pl->sizes = ln_alloc(sizeof(size_t) * pl->n_tensors);
+     pl->read_ops = ln_alloc(sizeof(int) * pl->n_reads);
+     pl->read_tensors = ln_alloc(sizeof(int) * pl->n_reads);
+     pl->needed = ln_alloc(pl->n_tensors * nb);
+     for (i = 0; i < pl->n_tensors; i++) {
+          pl->producers[i] = -1;
+          pl->sizes[i] = 0;
+     }
+
+     pl->n_reads = 0;
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          pl->current[i] = current_backend(pl, op, &base);
+          for (b = 0; b < nb; b++) {
+               if (b == pl->current[i])
+                    pl->protos[i * nb + b] = op;
+               else
+                    pl->protos[i * nb + b] =
+                         find_proto(registered_ops, base,
+                                    pl->backends[b]->suffix);
+               pl->times[i * nb + b] = op_time(op, pl->backends[b]);
+          }
+          ln_free(base);
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               id = (ssize_t)ln_hash_find(ids, te->name) - 1;
+               pl->read_ops[pl->n_reads] = i;
+               pl->read_tensors[pl->n_reads++] = id;
+               if (pl->producers[id] < 0)
+                    pl->sizes[id] = ln_tensor_entry_size(te);
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               id = (ssize_t)ln_hash_find(ids, te->name) - 1;
+               pl->producers[id] = i;
+               pl->sizes[id] = ln_tensor_entry_size(te);
+               if (ln_hash_find_extended(outs, te->name, NULL) && !te->isdead) {
+                    pl->read_ops[pl->n_reads] = -1;
+                    pl->read_tensors[pl->n_reads++] = id;
+               }
+          }
+          i++;
+     }
+     ln_hash_free(ids);
+
+     return pl;
+}
+
+/*
+ * Local search from the current placement. A move puts a run of
+ * consecutive ops, all runnable there, on one backend, so that a chain of
+ * ops can leave the host together even if no single op would. The best
+ * move from each op is taken while it lowers the estimated time.
+ */
+static double placement_search(struct placement *pl, int *assign)
+{
+     double best, t, move_best;
+     int *saved;
+     int i, j, b, move_b, move_end, nb, improved;
+
+     nb = pl->n_backends;
+     saved = ln_alloc(sizeof(int) * (pl->n_ops > 0 ? pl->n_ops : 1));
+     best = placement_time(pl, assign);
+     do {
+          improved = 0;
+          for (i = 0; i < pl->n_ops; i++) {
+               move_best = best;
+               move_b = -1;
+               move_end = -1;
+               memcpy(saved, assign, sizeof(int) * pl->n_ops);
+               for (b = 0; b < nb; b++) {
+                    if (b == assign[i])
+                         continue;
+                    for (j = i; j < pl->n_ops && pl->protos[j * nb + b]; j++) {
+                         assign[j] = b;
+                         t = placement_time(pl, assign);
+                         if (t < move_best - 1e-9 * move_best - 1e-15) {
+                              move_best = t;
+                              move_b = b;
+                              move_end = j;
+                         }
+                    }
+                    memcpy(assign, saved, sizeof(int) * pl->n_ops);
+               }
+               if (move_b < 0)
+                    continue;
+               for (j = i; j <= move_end; j++)
+                    assign[j] = move_b;
+               best = move_best;
+               improved = 1;
+          }
+     } while (improved);
+     ln_free(saved);
+
+     return best;
+}
+
+static char *placed_name(const char *name, ln_backend *backend)
+{
+     char *placed;
+
+     placed = ln_alloc(strlen(name) + strlen(backend->name) + 2);
+     sprintf(placed, "%s_%s", name, backend->name);
+     return placed;
+}
+
+static ln_op *copy_op_create(ln_list *registered_ops, ln_backend *from,
+                             ln_backend *to, const char *src_name,
+                             const char *dst_name)
+{
+     ln_tensor_table *tensors_in, *tensors_out;
+     ln_op *proto, *copy;
+     char *name;
+
+     proto = ln_op_list_find_by_optype(registered_ops, (char *)
+                                       (to->mtype == LN_MEM_CPU ?
+                                        from->copy_optype : to->copy_optype));
+     tensors_in = ln_tensor_table_append(NULL, "src", src_name, from->mtype,
+                                         NULL);
+     tensors_out = ln_tensor_table_append(NULL, "dst", dst_name, to->mtype,
+                                          NULL);
+     name = ln_alloc(strlen(dst_name) + sizeof("_copy"));
+     sprintf(name, "%s_copy", dst_name);
+     copy = ln_op_create(name, proto->op_arg->optype, tensors_in,
+                         tensors_out, NULL, proto->pre_run, proto->run,
+                         proto->post_run);
+     ln_op_copy_impl(copy, proto);
+     ln_free(name);
+     return copy;
+}
+
+static void set_impl(ln_op *op, ln_op *proto)
+{
+     ln_free(op->op_arg->optype);
+     op->op_arg->optype = ln_strdup(proto->op_arg->optype);
+     op->pre_run = proto->pre_run;
+     op->run = proto->run;
+     op->post_run = proto->post_run;
+     ln_op_copy_impl(op, proto);
+}
+
+static int is_placed(ln_list *ops)
+{
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (te->mtype != LN_MEM_UNDEFINED)
+                    return 1;
+          }
+     }
+     return 0;
+}
+
+/* whether assign moves an op or makes an op read across backends */
+static int placement_changes(struct placement *pl, int *assign)
+{
+     int i;
+
+     for (i = 0; i < pl->n_ops; i++) {
+          if (assign[i] != pl->current[i])
+               return 1;
+     }
+     for (i = 0; i < pl->n_reads; i++) {
+          if (home_of(pl, assign, pl->read_tensors[i])
+              != reader_of(assign, pl->read_ops[i]))
+               return 1;
+     }
+     return 0;
+}
+
+static void set_mtypes(struct placement *pl, ln_list *ops, int *assign)
+{
+     ln_tensor_entry *te;
+     ln_mem_type mtype;
+     ln_op *op;
+     int i = 0;
+
+     LN_LIST_FOREACH(op, ops) {
+          mtype = pl->backends[assign[i++]]->mtype;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               te->mtype = mtype;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               te->mtype = mtype;
+          }
+     }
+}
+
+/*
+ * Place ops on backends and set the memory types of tensors, minimizing
+ * the estimated run time. backends is a list of ln_backend, the host
+ * first; an op can run on a backend if the optype with the backend's
+ * suffix is in registered_ops, and a device is usable only if its copy op
+ * is registered too. Run times are estimated with the roofline of each
+ * backend from the costs of ops, and a tensor read on another backend
+ * costs one transfer to it, done by a copy op inserted before its first
+ * reader there. Graph outputs, the names in outputs, are copied back to
+ * the host under their names. Ops that have been placed, with memory types set, are left
+ * alone. The number of inserted copy ops is returned in n_copies if it
+ * isn't NULL.
+ */
+ln_list *ln_optimize_mtype(ln_list *ops, ln_list *registered_ops,
+                           ln_list *backends, ln_list *outputs,
+                           int *n_copies, ln_error **error)
+{
+     struct placement *pl;
+     ln_hash *copied;           /* names of tensors made by copy ops */
+     ln_hash *homes;            /* name -> backend index + 1 */
+     ln_hash *outs;
+     ln_tensor_entry *te;
+     ln_list *new_ops, *out_copies;
+     ln_backend *to;
+     ln_op *op, *copy;
+     ssize_t home;
+     int *assign;
+     int i, b, n;
+     char *name;
+
+     if (n_copies)
+          *n_copies = 0;
+     if (!backends || is_placed(ops))
+          return ops;
+
+     outs = output_set(outputs);
+     pl = placement_create(ops, registered_ops, backends, outs);
+     assign = ln_alloc(sizeof(int) * (pl->n_ops > 0 ? pl->n_ops : 1));
+     memcpy(assign, pl->current, sizeof(int) * pl->n_ops);
+     placement_search(pl, assign);
+     if (!placement_changes(pl, assign)) {
+          set_mtypes(pl, ops, assign);
+          goto end;
+     }
+     if (!can_reprepare(ops)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "ln_optimize_mtype(): ops have folded or recompute ops or tensors defined twice, skipped");
+          goto end;
+     }
+     unprepare_ops(ops, error);
+     if (*error)
+          goto end;
+
+     copied = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     homes = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free, NULL);
+     new_ops = NULL;
+     n = 0;
+     i = 0;
+     LN_LIST_FOREACH(op, ops) {
+          b = assign[i];
+          to = pl->backends[b];
+          if (b != pl->current[i])
+               set_impl(op, pl->protos[i * pl->n_backends + b]);
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               home = (ssize_t)ln_hash_find(homes, te->name) - 1;
+               if (home < 0)
+                    home = 0;
+               if (home != b) {
+                    name = placed_name(te->name, to);
+                    if (!ln_hash_find_extended(copied, name, NULL)) {
+                         copy = copy_op_create(registered_ops,
+                                               pl->backends[home], to,
+                                               te->name, name);
+                         new_ops = ln_list_append(new_ops, copy);
+                         ln_hash_insert(copied, ln_strdup(name), NULL);
+                         n++;
+                    }
+                    rename_tensor(te, name);
+                    ln_free(name);
+               }
+               te->mtype = to->mtype;
+          }
+          out_copies = NULL;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               te->mtype = to->mtype;
+               if (b != 0 && !te->isdead
+                   && ln_hash_find_extended(outs, te->name, NULL)) {
+                    /* readers on this backend read the placed name too */
+                    name = placed_name(te->name, to);
+                    copy = copy_op_create(registered_ops, to,
+                                          pl->backends[0], name, te->name);
+                    out_copies = ln_list_append(out_copies, copy);
+                    ln_hash_insert(copied, ln_strdup(name), NULL);
+                    rename_tensor(te, name);
+                    ln_free(name);
+                    n++;
+               }
+               ln_hash_insert(homes, ln_strdup(te->name),
+                              (void *)(ssize_t)(b + 1));
+          }
+          new_ops = ln_list_append(new_ops, op);
+          LN_LIST_FOREACH(copy, out_copies) {
+               new_ops = ln_list_append(new_ops, copy);
+          }
+          ln_list_free(out_copies);
+          i++;
+     }
+     ln_hash_free(homes);
+     ln_hash_free(copied);
 
+     ln_list_free(ops);
+     ops = new_ops;
+     prepare_ops(ops, error);
+     if (n_copies)
+          *n_copies = n;
 
+end:
+     ln_free(assign);
+     placement_free(pl);
+     ln_hash_free(outs);
      return ops;
 }
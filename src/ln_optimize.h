@@ -28,12 +28,43 @@
 #include "ln_mem.h"
 #include "ln_op.h"
 
+/* a device that ln_optimize_mtype() can place ops on */
+typedef struct ln_backend ln_backend;
+struct ln_backend {
+     const char  *name;
+     ln_mem_type  mtype;
+     const char  *suffix;       /* optype suffix of its ops, "" for the host */
+     const char  *copy_optype;  /* op moving tensors to and from the host */
+     double       gflops;       /* peak GFLOP/s, 0 if unlimited */
+     double       gbps;         /* memory GB/s, 0 if unlimited */
+     double       link_gbps;    /* GB/s of transfers with the host */
+     double       link_latency; /* seconds per transfer */
+};
+
 #ifdef __cplusplus
 LN_CPPSTART
 #endif
 
 ln_list *ln_optimize_mem(ln_list *ops, ln_hash *mem_pools);
-ln_list *ln_optimize_mtype(ln_list *ops, ln_mem_type mtype);
+size_t ln_optimize_peak_mem(ln_list *ops);
+ln_list *ln_optimize_order(ln_list *ops, size_t *peak_before,
+                           size_t *peak_after);
+ln_list *ln_optimize_remat(ln_list *ops, ln_hash *mem_pools,
+                           int *n_extra_ops, size_t *extra_bytes);
+ln_list *ln_optimize_spill(ln_list *ops, ln_hash *mem_pools, int *n_spilled);
+ln_list *ln_optimize_fold(ln_list *ops, ln_error **error);
+int ln_optimize_is_folded(ln_op *op);
+ln_list *ln_optimize_dce(ln_list *ops, ln_list *outputs, ln_error **error);
+ln_list *ln_optimize_cse(ln_list *ops, ln_list *outputs, ln_error **error);
+ln_list *ln_optimize_simplify(ln_list *ops, ln_list *outputs,
+                              int *n_simplified, ln_error **error);
+ln_list *ln_optimize_transpose(ln_list *ops, ln_list *outputs,
+                               int *n_rewritten, ln_error **error);
+ln_list *ln_optimize_fuse(ln_list *ops, ln_list *registered_ops,
+                          ln_list *outputs, int *n_fused, ln_error **error);
+ln_list *ln_optimize_mtype(ln_list *ops, ln_list *registered_ops,
+                           ln_list *backends, ln_list *outputs,
+                           int *n_copies, ln_error **error);
 
 #ifdef __cplusplus
 LN_CPPEND
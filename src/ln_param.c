@@ -196,6 +196,50 @@ void ln_param_table_free(ln_param_table *table)
      ln_list_free_deep(table, param_entry_free_wrapper);
 }
 
+ln_param_table *ln_param_table_copy(ln_param_table *table)
+{
+     ln_param_table *copy = NULL;
+     ln_param_entry *pe;
+
+     LN_LIST_FOREACH(pe, table) {
+          switch (pe->type) {
+          case LN_PARAM_NULL:
+               copy = ln_param_table_append_null(copy, pe->arg_name);
+               break;
+          case LN_PARAM_STRING:
+               copy = ln_param_table_append_string(copy, pe->arg_name,
+                                                   pe->value_string);
+               break;
+          case LN_PARAM_NUMBER:
+               copy = ln_param_table_append_number(copy, pe->arg_name,
+                                                   pe->value_double);
+               break;
+          case LN_PARAM_BOOL:
+               copy = ln_param_table_append_bool(copy, pe->arg_name,
+                                                 pe->value_bool);
+               break;
+          case LN_PARAM_ARRAY_STRING:
+               copy = ln_param_table_append_array_string(copy, pe->arg_name,
+                                                         pe->array_len,
+                                                         pe->value_array_string);
+               break;
+          case LN_PARAM_ARRAY_NUMBER:
+               copy = ln_param_table_append_array_number(copy, pe->arg_name,
+                                                         pe->array_len,
+                                                         pe->value_array_double);
+               break;
+          case LN_PARAM_ARRAY_BOOL:
+               copy = ln_param_table_append_array_bool(copy, pe->arg_name,
+                                                       pe->array_len,
+                                                       pe->value_array_bool);
+               break;
+          default:
+               assert(0 && "unsupported ln_param_type");
+          }
+     }
+     return copy;
+}
+
 static int find_by_arg_name(void *data1, void *data2)
 {
      ln_param_entry *p1, *p2;
@@ -84,6 +84,7 @@ ln_param_table *ln_param_table_append_array_bool(ln_param_table *table,
                                                  int array_len,
                                                  ln_bool *array_bool);
 void ln_param_table_free(ln_param_table *table);
+ln_param_table *ln_param_table_copy(ln_param_table *table);
 ln_param_entry *ln_param_table_find_by_arg_name(ln_param_table *table,
 						char *arg_name);
 int ln_param_table_length(ln_param_table *table);
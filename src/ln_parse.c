@@ -24,6 +24,7 @@
 #include <assert.h>
 #include "ln_parse.h"
 #include "ln_op.h"
+#include "ln_pass.h"
 #include "cJSON.h"
 
 static ln_param_table *parse_array_value(const cJSON *array_json,
@@ -146,8 +147,73 @@ end:
      return param_table;
 }
 
+/*
+ * The "dims" param of an op creating a tensor given a shape: a -1 in the
+ * "dims" of the net is a symbolic dimension, which can be of any size,
+ * and other dimensions should be the same as in shape.
+ */
+static ln_param_table *parse_shape_dims(const cJSON *dims_json,
+					const cJSON *name_json,
+					const ln_shape *shape,
+					ln_param_table *params,
+					ln_error **error)
+{
+     const cJSON *dim_json;
+     double *dims;
+     int i;
+
+     if (!cJSON_IsArray(dims_json)
+	 || cJSON_GetArraySize(dims_json) != shape->ndim) {
+	  *error = ln_error_create(LN_ERROR,
+				   "op \"%s\"'s \"dims\" param should be an Array of %d dimensions for tensor \"%s\"",
+				   name_json->valuestring, shape->ndim,
+				   shape->name);
+	  return params;
+     }
+     dims = ln_alloc(sizeof(double) * shape->ndim);
+     i = 0;
+     cJSON_ArrayForEach(dim_json, dims_json) {
+	  if (!cJSON_IsNumber(dim_json) || shape->dims[i] <= 0
+	      || (dim_json->valueint != -1
+		  && dim_json->valueint != shape->dims[i])) {
+	       *error = ln_error_create(LN_ERROR,
+					"op \"%s\"'s tensor \"%s\" can't have size %d in dimension %d",
+					name_json->valuestring, shape->name,
+					shape->dims[i], i);
+	       ln_free(dims);
+	       return params;
+	  }
+	  dims[i] = shape->dims[i];
+	  i++;
+     }
+     params = ln_param_table_append_array_number(params, "dims",
+						 shape->ndim, dims);
+     ln_free(dims);
+     return params;
+}
+
+/* the shape of one of the tensors an op creates, or NULL */
+static const ln_shape *find_shape(const cJSON *tensors_out_json,
+				  const ln_shape *shapes, int n_shapes)
+{
+     const cJSON *tensor_json, *tensor_name_json;
+     int i;
+
+     cJSON_ArrayForEach(tensor_json, tensors_out_json) {
+	  tensor_name_json = cJSON_GetObjectItem(tensor_json, "name");
+	  if (!cJSON_IsString(tensor_name_json))
+	       continue;
+	  for (i = 0; i < n_shapes; i++) {
+	       if (!strcmp(shapes[i].name, tensor_name_json->valuestring))
+		    return &shapes[i];
+	  }
+     }
+     return NULL;
+}
+
 static ln_op *parse_op(const cJSON *op_json, ln_list *ops,
-		       ln_list *registered_ops, int idx, ln_error **error)
+		       ln_list *registered_ops, int idx,
+		       const ln_shape *shapes, int n_shapes, ln_error **error)
 {
      ln_op *op, *proto_op;
      ln_tensor_table *tensors_in = NULL;
@@ -223,6 +289,7 @@ static ln_op *parse_op(const cJSON *op_json, ln_list *ops,
      cJSON *tensor_json, *param_json;
      cJSON *tensor_arg_name_json, *tensor_name_json;
      cJSON *param_arg_name_json, *param_value_json;
+     const ln_shape *shape;
      tl_tensor *tensor;
      int i = 0;
      cJSON_ArrayForEach(tensor_json, tensors_in_json) {
@@ -302,6 +369,7 @@ static ln_op *parse_op(const cJSON *op_json, ln_list *ops,
                                                tensor);
 	  i++;
      }
+     shape = find_shape(tensors_out_json, shapes, n_shapes);
      i = 0;
      cJSON_ArrayForEach(param_json, params_json) {
 	  param_arg_name_json = cJSON_GetObjectItem(param_json, "arg_name");
@@ -325,7 +393,19 @@ static ln_op *parse_op(const cJSON *op_json, ln_list *ops,
 					param_arg_name_json->valuestring);
 	       goto err;
 	  }
-	  if (cJSON_IsNumber(param_value_json)) {
+	  /* a tensor given a shape gets its data at run time */
+	  if (shape && !strcmp(param_arg_name_json->valuestring, "dims")) {
+	       params = parse_shape_dims(param_value_json, name_json, shape,
+					 params, error);
+	       if (*error)
+		    goto err;
+	  }
+	  else if (shape
+		   && !strcmp(param_arg_name_json->valuestring, "data")) {
+	       params = ln_param_table_append_null(params,
+						   param_arg_name_json->valuestring);
+	  }
+	  else if (cJSON_IsNumber(param_value_json)) {
 	       params = ln_param_table_append_number(params,
 						     param_arg_name_json->valuestring,
 						     param_value_json->valuedouble);
@@ -377,6 +457,7 @@ static ln_op *parse_op(const cJSON *op_json, ln_list *ops,
      op = ln_op_create(name_json->valuestring, optype_json->valuestring,
 		       tensors_in, tensors_out, params, proto_op->pre_run,
                        proto_op->run, proto_op->post_run);
+     ln_op_copy_impl(op, proto_op);
      /*
       * op->pre_run() runs here, because we need it to allocate tensors
       * for following ops to reference to them.
@@ -398,6 +479,21 @@ err:
 
 ln_list *ln_parse_ops(const char *json_str, ln_list *registered_ops,
                       ln_error **error)
+{
+     return ln_parse_ops_with_shapes(json_str, registered_ops, NULL, 0,
+                                     error);
+}
+
+/*
+ * Parse ops, with the tensors in shapes created in those shapes, by
+ * overriding the "dims" params of the ops creating them, such as "create"
+ * and "zeros". Their "data" params become null, so that a "create" op of
+ * one is a placeholder, whose data is given at run time.
+ */
+ln_list *ln_parse_ops_with_shapes(const char *json_str,
+                                  ln_list *registered_ops,
+                                  const ln_shape *shapes, int n_shapes,
+                                  ln_error **error)
 {
      const cJSON *ops_json;
      const cJSON *op_json;
@@ -424,7 +520,8 @@ ln_list *ln_parse_ops(const char *json_str, ln_list *registered_ops,
 
      int i = 0;
      cJSON_ArrayForEach(op_json, ops_json) {
-	  op = parse_op(op_json, ops, registered_ops, i, error);
+	  op = parse_op(op_json, ops, registered_ops, i, shapes, n_shapes,
+			error);
 	  if (*error) {
 	       assert(!op);
 	       goto err_op;
@@ -449,3 +546,54 @@ err_json:
      cJSON_Delete(json);
      return NULL;
 }
+
+/*
+ * Parse the optional "passes" item, an Array of pass names, into a pipeline
+ * of passes. Return NULL if there isn't one.
+ */
+ln_list *ln_parse_passes(const char *json_str, ln_error **error)
+{
+     const cJSON *passes_json;
+     const cJSON *pass_json;
+     cJSON *json;
+     ln_list *pipeline = NULL;
+     ln_pass *pass;
+
+     json = cJSON_Parse(json_str);
+     if (!json) {
+	  *error = ln_error_create(LN_ERROR, "parsing JSON before: %s",
+				  cJSON_GetErrorPtr());
+	  return NULL;
+     }
+
+     passes_json = cJSON_GetObjectItem(json, "passes");
+     if (!passes_json)
+	  goto end;
+     if (!cJSON_IsArray(passes_json)) {
+	  *error = ln_error_create(LN_ERROR, "item \"passes\" has to be an Array");
+	  goto end;
+     }
+     cJSON_ArrayForEach(pass_json, passes_json) {
+	  if (!cJSON_IsString(pass_json)) {
+	       *error = ln_error_create(LN_ERROR,
+					"item \"passes\" should only have Strings");
+	       goto err;
+	  }
+	  pass = ln_pass_find(pass_json->valuestring);
+	  if (!pass) {
+	       *error = ln_error_create(LN_ERROR, "unknown pass \"%s\"",
+					pass_json->valuestring);
+	       goto err;
+	  }
+	  pipeline = ln_list_append(pipeline, pass);
+     }
+
+end:
+     cJSON_Delete(json);
+     return pipeline;
+
+err:
+     ln_list_free(pipeline);
+     cJSON_Delete(json);
+     return NULL;
+}
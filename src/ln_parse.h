@@ -26,12 +26,25 @@
 #include "ln_list.h"
 #include "ln_error.h"
 
+/* the shape a tensor of the net is created in, such as a graph input */
+typedef struct ln_shape ln_shape;
+struct ln_shape {
+     const char *name;
+     int         ndim;
+     const int  *dims;
+};
+
 #ifdef __cplusplus
 LN_CPPSTART
 #endif
 
 ln_list *ln_parse_ops(const char *json_str, ln_list *registered_ops,
                       ln_error **error);
+ln_list *ln_parse_ops_with_shapes(const char *json_str,
+                                  ln_list *registered_ops,
+                                  const ln_shape *shapes, int n_shapes,
+                                  ln_error **error);
+ln_list *ln_parse_passes(const char *json_str, ln_error **error);
 #ifdef __cplusplus
 LN_CPPEND
 #endif
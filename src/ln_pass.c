@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "ln_pass.h"
+#include "ln_optimize.h"
+#include "ln_tune.h"
+#include "ln_op.h"
+
+/* names that no op reads, taken as graph outputs if none are given */
+static ln_list *unread_names(ln_list *ops)
+{
+     ln_hash *read;
+     ln_list *names;
+     ln_tensor_entry *te;
+     ln_op *op;
+
+     read = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ln_hash_insert(read, te->name, NULL);
+          }
+     }
+     names = NULL;
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!ln_hash_find_extended(read, te->name, NULL))
+                    names = ln_list_append(names, te->name);
+          }
+     }
+     ln_hash_free(read);
+
+     return names;
+}
+
+static int need_mem_pools(ln_pass_arg *arg, const char *name,
+                          ln_error **error)
+{
+     if (arg && arg->mem_pools)
+          return 1;
+     *error = ln_error_create(LN_WARNING,
+                              "pass \"%s\" needs memory pools, skipped", name);
+     return 0;
+}
+
+static ln_list *pass_fold(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     return ln_optimize_fold(ops, error);
+}
+
+static ln_list *pass_dce(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     ln_list *outputs;
+
+     if (arg && arg->outputs)
+          return ln_optimize_dce(ops, arg->outputs, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_dce(ops, outputs, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_cse(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     ln_list *outputs;
+
+     if (arg && arg->outputs)
+          return ln_optimize_cse(ops, arg->outputs, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_cse(ops, outputs, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_simplify(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     ln_list *outputs;
+
+     if (arg && arg->outputs)
+          return ln_optimize_simplify(ops, arg->outputs, NULL, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_simplify(ops, outputs, NULL, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_transpose(ln_list *ops, ln_pass_arg *arg,
+                               ln_error **error)
+{
+     ln_list *outputs;
+
+     if (arg && arg->outputs)
+          return ln_optimize_transpose(ops, arg->outputs, NULL, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_transpose(ops, outputs, NULL, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_fuse(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     ln_list *outputs;
+
+     if (!arg || !arg->registered_ops) {
+          *error = ln_error_create(LN_WARNING,
+                                   "pass \"fuse\" needs registered ops, skipped");
+          return ops;
+     }
+     if (arg->outputs)
+          return ln_optimize_fuse(ops, arg->registered_ops, arg->outputs,
+                                  NULL, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_fuse(ops, arg->registered_ops, outputs, NULL, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_mtype(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     ln_list *outputs;
+
+     if (!arg || !arg->registered_ops || !arg->backends) {
+          *error = ln_error_create(LN_WARNING,
+                                   "pass \"mtype\" needs registered ops and backends, skipped");
+          return ops;
+     }
+     if (arg->outputs)
+          return ln_optimize_mtype(ops, arg->registered_ops, arg->backends,
+                                   arg->outputs, NULL, error);
+     outputs = unread_names(ops);
+     ops = ln_optimize_mtype(ops, arg->registered_ops, arg->backends, outputs,
+                             NULL, error);
+     ln_list_free(outputs);
+     return ops;
+}
+
+static ln_list *pass_order(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     return ln_optimize_order(ops, NULL, NULL);
+}
+
+static ln_list *pass_autotune(ln_list *ops, ln_pass_arg *arg,
+                              ln_error **error)
+{
+     ln_tune_ops(ops, arg ? arg->tune_cache : NULL, NULL, error);
+     return ops;
+}
+
+static ln_list *pass_remat(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     if (!need_mem_pools(arg, "remat", error))
+          return ops;
+     return ln_optimize_remat(ops, arg->mem_pools, NULL, NULL);
+}
+
+static ln_list *pass_spill(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     if (!need_mem_pools(arg, "spill", error))
+          return ops;
+     return ln_optimize_spill(ops, arg->mem_pools, NULL);
+}
+
+static ln_list *pass_mem(ln_list *ops, ln_pass_arg *arg, ln_error **error)
+{
+     if (!need_mem_pools(arg, "mem", error))
+          return ops;
+     return ln_optimize_mem(ops, arg->mem_pools);
+}
+
+/* registered passes, in the order they are best run */
+static ln_pass passes[] = {
+     {"fold", pass_fold},
+     {"cse", pass_cse},
+     {"simplify", pass_simplify},
+     {"transpose", pass_transpose},
+     {"dce", pass_dce},
+     {"fuse", pass_fuse},
+     {"mtype", pass_mtype},
+     {"order", pass_order},
+     {"autotune", pass_autotune},
+     {"remat", pass_remat},
+     {"spill", pass_spill},
+     {"mem", pass_mem},
+     {NULL, NULL}
+};
+
+ln_pass *ln_pass_find(const char *name)
+{
+     ln_pass *pass;
+
+     for (pass = passes; pass->name; pass++) {
+          if (!strcmp(pass->name, name))
+               return pass;
+     }
+     return NULL;
+}
+
+/*
+ * Create a pipeline, a list of passes, from comma separated pass names,
+ * such as "cse,simplify,dce,mem".
+ */
+ln_list *ln_pass_pipeline_create(const char *names, ln_error **error)
+{
+     ln_list *pipeline;
+     ln_pass *pass;
+     char *str, *name, *saveptr;
+
+     pipeline = NULL;
+     str = ln_strdup(names);
+     for (name = strtok_r(str, ", ", &saveptr); name;
+          name = strtok_r(NULL, ", ", &saveptr)) {
+          pass = ln_pass_find(name);
+          if (!pass) {
+               *error = ln_error_create(LN_ERROR, "unknown pass \"%s\"", name);
+               ln_list_free(pipeline);
+               pipeline = NULL;
+               break;
+          }
+          pipeline = ln_list_append(pipeline, pass);
+     }
+     ln_free(str);
+
+     return pipeline;
+}
+
+static int is_same_shape(tl_tensor *t1, tl_tensor *t2)
+{
+     int i;
+
+     if (t1->ndim != t2->ndim)
+          return 0;
+     for (i = 0; i < t1->ndim; i++) {
+          if (t1->dims[i] != t2->dims[i])
+               return 0;
+     }
+     return 1;
+}
+
+/*
+ * Check that ops are consistent: every tensor an op reads is created by an
+ * earlier op, with the same tensor and shape, or given by the user; every
+ * tensor an op creates has been made by pre_run; every view's owner
+ * exists. Folded ops are skipped, as they read nothing.
+ */
+void ln_pass_verify(ln_list *ops, ln_error **error)
+{
+     ln_hash *defs;             /* name -> its latest definition */
+     ln_tensor_entry *te, *def;
+     ln_op *op;
+
+     defs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               if (ln_optimize_is_folded(op))
+                    continue;
+               if (!ln_hash_find_extended(defs, te->name, (void **)&def)) {
+                    if (te->tensor)
+                         continue;
+                    *error = ln_error_create(LN_ERROR,
+                                             "op \"%s\" reads tensor \"%s\", which is neither created by an earlier op nor given",
+                                             op->op_arg->name, te->name);
+                    goto end;
+               }
+               if (te->tensor == def->tensor)
+                    continue;
+               if (te->tensor && def->tensor
+                   && !is_same_shape(te->tensor, def->tensor)) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "op \"%s\" reads tensor \"%s\" in a shape different from its definition",
+                                             op->op_arg->name, te->name);
+                    goto end;
+               }
+               *error = ln_error_create(LN_ERROR,
+                                        "op \"%s\" reads tensor \"%s\", which isn't the one defined",
+                                        op->op_arg->name, te->name);
+               goto end;
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!te->tensor) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "op \"%s\"'s tensor \"%s\" isn't made",
+                                             op->op_arg->name, te->name);
+                    goto end;
+               }
+               if (te->owner && !ln_hash_find_extended(defs, te->owner, NULL)
+                   && !ln_tensor_table_find_by_name(op->op_arg->tensors_in,
+                                                    te->owner)) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "op \"%s\"'s tensor \"%s\" is a view of \"%s\", which doesn't exist",
+                                             op->op_arg->name, te->name,
+                                             te->owner);
+                    goto end;
+               }
+               ln_hash_insert(defs, te->name, te);
+          }
+     }
+end:
+     ln_hash_free(defs);
+}
+
+static int count_tensors(ln_list *ops)
+{
+     ln_hash *names;
+     ln_tensor_entry *te;
+     ln_op *op;
+     int n;
+
+     names = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ln_hash_insert(names, te->name, NULL);
+          }
+     }
+     n = ln_hash_size(names);
+     ln_hash_free(names);
+
+     return n;
+}
+
+static double now(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Run the passes of pipeline on ops in order. Warnings of passes are
+ * printed and the pipeline goes on; an error stops it. In debug builds ops
+ * are verified after each pass. If stats isn't NULL, a list of
+ * ln_pass_stat of each pass run is returned in it, which should be freed
+ * with ln_list_free_deep(stats, ln_free).
+ */
+ln_list *ln_pass_pipeline_run(ln_list *pipeline, ln_list *ops,
+                              ln_pass_arg *arg, ln_list **stats,
+                              ln_error **error)
+{
+     ln_pass_stat *stat;
+     ln_pass *pass;
+     double start;
+
+     if (stats)
+          *stats = NULL;
+     LN_LIST_FOREACH(pass, pipeline) {
+          stat = ln_alloc(sizeof(ln_pass_stat));
+          stat->name = pass->name;
+          stat->ops_before = ln_list_length(ops);
+          stat->tensors_before = count_tensors(ops);
+          stat->mem_before = ln_optimize_peak_mem(ops);
+
+          start = now();
+          ops = pass->run(ops, arg, error);
+          stat->time = now() - start;
+
+          stat->ops_after = ln_list_length(ops);
+          stat->tensors_after = count_tensors(ops);
+          stat->mem_after = ln_optimize_peak_mem(ops);
+          if (stats)
+               *stats = ln_list_append(*stats, stat);
+          else
+               ln_free(stat);
+
+          if (*error && ((*error)->level == LN_ERROR
+                         || (*error)->level == LN_ERROR_SYS))
+               return ops;
+          ln_error_handle(error);
+#ifdef LN_DEBUG
+          ln_pass_verify(ops, error);
+          if (*error) {
+               ln_error *verify_error = *error;
+               *error = ln_error_create(LN_ERROR, "after pass \"%s\": %s",
+                                        pass->name, verify_error->err_str);
+               ln_error_free(verify_error);
+               return ops;
+          }
+#endif
+     }
+
+     return ops;
+}
+
+void ln_pass_stats_print(ln_list *stats, FILE *fp)
+{
+     ln_pass_stat *stat;
+
+     fprintf(fp, "%-12s %12s %16s %20s %28s\n",
+             "pass", "time (ms)", "ops", "tensors", "peak memory (bytes)");
+     LN_LIST_FOREACH(stat, stats) {
+          fprintf(fp, "%-12s %12.3f %6d -> %-6d %8d -> %-8d %12lu -> %-12lu\n",
+                  stat->name, stat->time * 1e3,
+                  stat->ops_before, stat->ops_after,
+                  stat->tensors_before, stat->tensors_after,
+                  (unsigned long)stat->mem_before,
+                  (unsigned long)stat->mem_after);
+     }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_PASS_H_
+#define _LN_PASS_H_
+
+#include <stdio.h>
+#include "ln_list.h"
+#include "ln_hash.h"
+#include "ln_error.h"
+
+typedef struct ln_pass_arg ln_pass_arg;
+struct ln_pass_arg {
+     ln_hash *mem_pools;        /* pools of planning passes, or NULL */
+     ln_list *outputs;          /* graph output names, or NULL for unread ones */
+     const char *tune_cache;    /* autotuning cache file, or NULL */
+     ln_list *registered_ops;   /* ops that placement can choose from */
+     ln_list *backends;         /* ln_backend to place ops on, host first */
+};
+
+typedef ln_list *(*ln_pass_func) (ln_list *ops, ln_pass_arg *arg,
+                                  ln_error **error);
+
+typedef struct ln_pass ln_pass;
+struct ln_pass {
+     const char   *name;
+     ln_pass_func  run;
+};
+
+typedef struct ln_pass_stat ln_pass_stat;
+struct ln_pass_stat {
+     const char *name;
+     double      time;          /* seconds */
+     int         ops_before;
+     int         ops_after;
+     int         tensors_before;
+     int         tensors_after;
+     size_t      mem_before;    /* peak bytes of live tensors */
+     size_t      mem_after;
+};
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_pass *ln_pass_find(const char *name);
+ln_list *ln_pass_pipeline_create(const char *names, ln_error **error);
+void ln_pass_verify(ln_list *ops, ln_error **error);
+ln_list *ln_pass_pipeline_run(ln_list *pipeline, ln_list *ops,
+                              ln_pass_arg *arg, ln_list **stats,
+                              ln_error **error);
+void ln_pass_stats_print(ln_list *stats, FILE *fp);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_PASS_H_ */
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ln_plan.h"
+
+struct ln_plan_cache {
+     char          *json_str;
+     ln_list       *registered_ops;
+     ln_list       *pipeline;
+     ln_pass_arg    pass_arg;
+     ln_list       *outputs;
+     int            capacity;
+     ln_list       *plans;      /* ln_plan, in the order they're made */
+     ln_hash       *index;      /* key -> ln_plan */
+     int           *buckets;    /* ascending batch sizes planned, or NULL */
+     int            n_buckets;  /* 0 for powers of two */
+     int            bucketing;
+     ln_hash       *batch_axes; /* output name -> batch axis + 1 */
+     unsigned long  clock;
+     ln_plan_stat   stat;
+};
+
+/*
+ * Plans for the input shapes of the net json_str, made by parsing it with
+ * those shapes and running pipeline on the ops with pass_arg, which may be
+ * NULL. outputs are the graph outputs, or NULL for the tensors no op reads.
+ * Up to capacity plans are kept, the least recently used one evicted to
+ * make room for a new one. json_str is copied; registered_ops, pipeline,
+ * the contents of pass_arg and outputs should outlive the cache.
+ */
+ln_plan_cache *ln_plan_cache_create(const char *json_str,
+                                    ln_list *registered_ops,
+                                    ln_list *pipeline, ln_pass_arg *pass_arg,
+                                    ln_list *outputs, int capacity)
+{
+     ln_plan_cache *cache;
+
+     cache = ln_alloc(sizeof(ln_plan_cache));
+     memset(cache, 0, sizeof(ln_plan_cache));
+     cache->json_str = ln_strdup(json_str);
+     cache->registered_ops = registered_ops;
+     cache->pipeline = pipeline;
+     if (pass_arg)
+          cache->pass_arg = *pass_arg;
+     if (outputs)
+          cache->pass_arg.outputs = outputs;
+     cache->outputs = outputs;
+     cache->capacity = capacity > 0 ? capacity : 1;
+     cache->index = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     cache->batch_axes = ln_hash_create(ln_str_hash, ln_str_cmp, ln_free,
+                                        NULL);
+
+     return cache;
+}
+
+static void plan_free(ln_plan *plan)
+{
+     ln_error *error = NULL;
+
+     ln_io_free(plan->io);
+     ln_op_list_do_post_run(plan->ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(plan->ops);
+     ln_free(plan->key);
+     ln_free(plan);
+}
+
+void ln_plan_cache_free(ln_plan_cache *cache)
+{
+     ln_plan *plan;
+
+     LN_LIST_FOREACH(plan, cache->plans) {
+          plan_free(plan);
+     }
+     ln_list_free(cache->plans);
+     ln_hash_free(cache->index);
+     ln_hash_free(cache->batch_axes);
+     ln_free(cache->buckets);
+     ln_free(cache->json_str);
+     ln_free(cache);
+}
+
+/* such as "x[2,4]y[2]", which should be freed */
+static char *shapes_key(const ln_shape *shapes, int n_shapes)
+{
+     size_t size;
+     char *key;
+     FILE *fp;
+     int i, j;
+
+     fp = open_memstream(&key, &size);
+     for (i = 0; i < n_shapes; i++) {
+          fprintf(fp, "%s[", shapes[i].name);
+          for (j = 0; j < shapes[i].ndim; j++)
+               fprintf(fp, j ? ",%d" : "%d", shapes[i].dims[j]);
+          fprintf(fp, "]");
+     }
+     fclose(fp);
+
+     return key;
+}
+
+static ln_plan *plan_create(ln_plan_cache *cache, const ln_shape *shapes,
+                            int n_shapes, ln_error **error)
+{
+     ln_list *ops, *inputs;
+     ln_error *post_error = NULL;
+     ln_plan *plan;
+     ln_io *io;
+     int i;
+
+     ops = ln_parse_ops_with_shapes(cache->json_str, cache->registered_ops,
+                                    shapes, n_shapes, error);
+     if (*error)
+          return NULL;
+     ops = ln_pass_pipeline_run(cache->pipeline, ops, &cache->pass_arg, NULL,
+                                error);
+     if (*error)
+          goto err;
+
+     inputs = NULL;
+     for (i = 0; i < n_shapes; i++)
+          inputs = ln_list_append(inputs, (void *)shapes[i].name);
+     io = ln_io_create(ops, inputs, cache->outputs, error);
+     ln_list_free(inputs);
+     if (*error)
+          goto err;
+
+     plan = ln_alloc(sizeof(ln_plan));
+     plan->key = shapes_key(shapes, n_shapes);
+     plan->ops = ops;
+     plan->io = io;
+     plan->last_use = 0;
+     return plan;
+
+err:
+     ln_op_list_do_post_run(ops, &post_error);
+     ln_error_handle(&post_error);
+     ln_op_list_free_tables_too(ops);
+     return NULL;
+}
+
+static void evict_lru(ln_plan_cache *cache)
+{
+     ln_plan *plan, *lru = NULL;
+
+     LN_LIST_FOREACH(plan, cache->plans) {
+          if (!lru || plan->last_use < lru->last_use)
+               lru = plan;
+     }
+     cache->plans = ln_list_remove(cache->plans, lru);
+     ln_hash_remove(cache->index, lru->key);
+     plan_free(lru);
+     cache->stat.evictions++;
+}
+
+/*
+ * The plan for inputs in shapes, a hash lookup if it was made before. It
+ * stays valid until ln_plan_cache_get() evicts it, so bind its buffers
+ * again after getting it.
+ */
+ln_plan *ln_plan_cache_get(ln_plan_cache *cache, const ln_shape *shapes,
+                           int n_shapes, ln_error **error)
+{
+     ln_plan *plan;
+     char *key;
+
+     key = shapes_key(shapes, n_shapes);
+     plan = ln_hash_find(cache->index, key);
+     ln_free(key);
+     if (plan) {
+          cache->stat.hits++;
+          plan->last_use = ++cache->clock;
+          return plan;
+     }
+
+     cache->stat.misses++;
+     plan = plan_create(cache, shapes, n_shapes, error);
+     if (!plan)
+          return NULL;
+     if (ln_list_length(cache->plans) >= cache->capacity)
+          evict_lru(cache);
+     plan->last_use = ++cache->clock;
+     cache->plans = ln_list_append(cache->plans, plan);
+     ln_hash_insert(cache->index, plan->key, plan);
+
+     return plan;
+}
+
+static int cmp_int(const void *p1, const void *p2)
+{
+     return *(const int *)p1 - *(const int *)p2;
+}
+
+/*
+ * Plan batches, the first dimension of inputs, in the sizes of buckets
+ * only, so that the number of plans is bounded. A NULL buckets means the
+ * powers of two. ln_plan_cache_run() pads a batch up to its bucket, which
+ * is only right if the rows of a batch are computed independently of each
+ * other: the padded rows mustn't change the real ones, as a reduction over
+ * the batch would. Every output should then be given its batch axis with
+ * ln_plan_cache_set_batch_axis().
+ */
+void ln_plan_cache_set_buckets(ln_plan_cache *cache, const int *buckets,
+                               int n_buckets)
+{
+     ln_free(cache->buckets);
+     cache->buckets = NULL;
+     cache->n_buckets = 0;
+     cache->bucketing = 1;
+     if (!buckets || n_buckets <= 0)
+          return;
+     cache->buckets = ln_alloc(sizeof(int) * n_buckets);
+     memcpy(cache->buckets, buckets, sizeof(int) * n_buckets);
+     qsort(cache->buckets, n_buckets, sizeof(int), cmp_int);
+     cache->n_buckets = n_buckets;
+}
+
+/* the batch size batch is planned in, or -1 if no bucket can hold it */
+int ln_plan_cache_bucket(ln_plan_cache *cache, int batch)
+{
+     int bucket, i;
+
+     if (batch <= 0)
+          return -1;
+     if (!cache->bucketing)
+          return batch;
+     if (!cache->buckets) {
+          for (bucket = 1; bucket < batch; bucket <<= 1)
+               ;
+          return bucket;
+     }
+     for (i = 0; i < cache->n_buckets; i++) {
+          if (cache->buckets[i] >= batch)
+               return cache->buckets[i];
+     }
+     return -1;
+}
+
+/*
+ * Declare that the batch of the inputs is on axis of output, each slice on
+ * it depending only on the same batch row of the inputs, so that a padded
+ * output can be trimmed there. A negative axis removes the declaration.
+ */
+void ln_plan_cache_set_batch_axis(ln_plan_cache *cache, const char *output,
+                                  int axis)
+{
+     if (axis < 0) {
+          ln_hash_remove(cache->batch_axes, (char *)output);
+          return;
+     }
+     ln_hash_insert(cache->batch_axes, ln_strdup(output),
+                    (void *)(ssize_t)(axis + 1));
+}
+
+/*
+ * Copy the first batch slices on axis of src, a tensor planned with bucket
+ * slices there, to dst, which holds batch slices.
+ */
+static void trim_axis(void *dst, const void *src, tl_tensor *tensor,
+                      int axis, int batch, int bucket)
+{
+     size_t inner, outer, i;
+     int j;
+
+     inner = tl_size_of(tensor->dtype);
+     for (j = axis + 1; j < tensor->ndim; j++)
+          inner *= tensor->dims[j];
+     outer = 1;
+     for (j = 0; j < axis; j++)
+          outer *= tensor->dims[j];
+     for (i = 0; i < outer; i++)
+          memcpy((char *)dst + i * batch * inner,
+                 (const char *)src + i * bucket * inner, batch * inner);
+}
+
+/* the batch axis of output in a plan padded to bucket, or -1 with error */
+static int check_batch_axis(ln_plan_cache *cache, const char *output,
+                            tl_tensor *tensor, int bucket, ln_error **error)
+{
+     ssize_t axis;
+
+     if (!ln_hash_find_extended(cache->batch_axes, (char *)output,
+                                (void **)&axis)) {
+          *error = ln_error_create(LN_ERROR,
+                                   "plan: output \"%s\" has no batch axis to trim a padded batch",
+                                   output);
+          return -1;
+     }
+     axis--;
+     if (axis >= tensor->ndim || tensor->dims[axis] != bucket) {
+          *error = ln_error_create(LN_ERROR,
+                                   "plan: output \"%s\" doesn't have the bucket %d on its batch axis %d",
+                                   output, bucket, (int)axis);
+          return -1;
+     }
+     return axis;
+}
+
+static void unbind_all(ln_plan *plan, const ln_shape *shapes, int n_shapes,
+                       ln_list *outputs)
+{
+     ln_error *error = NULL;
+     ln_list *l;
+     int i;
+
+     for (i = 0; i < n_shapes; i++)
+          ln_io_bind_input(plan->io, shapes[i].name, NULL, 0, &error);
+     for (l = outputs; l; l = l->next)
+          ln_io_bind_output(plan->io, l->data, NULL, 0, &error);
+     ln_error_handle(&error);
+}
+
+/*
+ * Run the net on inputs in shapes, with inputs[i] the data of shapes[i],
+ * writing the outputs given to ln_plan_cache_create() to outputs[i]. The
+ * first dimension of inputs is the batch. With buckets, a batch is
+ * planned and run padded with zeros up to its bucket, and the outputs are
+ * trimmed back to the batch on their batch axes. It's an error if the
+ * batch is padded and some output has no batch axis declared.
+ */
+void ln_plan_cache_run(ln_plan_cache *cache, const ln_shape *shapes,
+                       int n_shapes, const void *const *inputs,
+                       void *const *outputs, ln_error **error)
+{
+     ln_shape *planned;
+     ln_plan *plan;
+     tl_tensor *tensor;
+     void **bufs;
+     size_t row;
+     int batch, bucket, n_outputs, i;
+     ln_list *l;
+     int *axes;
+
+     if (!cache->outputs || n_shapes < 1 || shapes[0].ndim < 1) {
+          *error = ln_error_create(LN_ERROR,
+                                   "plan: running needs outputs and batched inputs");
+          return;
+     }
+     batch = shapes[0].dims[0];
+     for (i = 0; i < n_shapes; i++) {
+          if (shapes[i].ndim < 1 || shapes[i].dims[0] != batch) {
+               *error = ln_error_create(LN_ERROR,
+                                        "plan: input \"%s\" isn't in the batch of %d",
+                                        shapes[i].name, batch);
+               return;
+          }
+     }
+     if ((bucket = ln_plan_cache_bucket(cache, batch)) < 0) {
+          *error = ln_error_create(LN_ERROR,
+                                   "plan: no bucket for a batch of %d", batch);
+          return;
+     }
+
+     planned = ln_alloc(sizeof(ln_shape) * n_shapes);
+     for (i = 0; i < n_shapes; i++) {
+          planned[i] = shapes[i];
+          planned[i].dims = ln_alloc(sizeof(int) * shapes[i].ndim);
+          memcpy((int *)planned[i].dims, shapes[i].dims,
+                 sizeof(int) * shapes[i].ndim);
+          ((int *)planned[i].dims)[0] = bucket;
+     }
+     plan = ln_plan_cache_get(cache, planned, n_shapes, error);
+     if (*error)
+          goto end;
+
+     /* padded inputs and trimmed outputs are staged */
+     n_outputs = ln_list_length(cache->outputs);
+     bufs = ln_alloc(sizeof(void *) * (n_shapes + n_outputs));
+     memset(bufs, 0, sizeof(void *) * (n_shapes + n_outputs));
+     axes = ln_alloc(sizeof(int) * (n_outputs + 1));
+     for (i = 0; i < n_shapes && !*error; i++) {
+          tensor = ln_io_find_input(plan->io, shapes[i].name);
+          if (bucket == batch) {
+               ln_io_bind_input(plan->io, shapes[i].name, inputs[i],
+                                tl_tensor_size(tensor), error);
+               continue;
+          }
+          row = tl_tensor_size(tensor) / bucket;
+          bufs[i] = ln_alloc(tl_tensor_size(tensor));
+          memcpy(bufs[i], inputs[i], row * batch);
+          memset((char *)bufs[i] + row * batch, 0, row * (bucket - batch));
+          ln_io_bind_input(plan->io, shapes[i].name, bufs[i],
+                           tl_tensor_size(tensor), error);
+     }
+     for (l = cache->outputs, i = 0; l && !*error; l = l->next, i++) {
+          tensor = ln_io_find_output(plan->io, l->data);
+          if (bucket == batch) {
+               ln_io_bind_output(plan->io, l->data, outputs[i],
+                                 tl_tensor_size(tensor), error);
+               continue;
+          }
+          axes[i] = check_batch_axis(cache, l->data, tensor, bucket, error);
+          if (*error)
+               break;
+          bufs[n_shapes + i] = ln_alloc(tl_tensor_size(tensor));
+          ln_io_bind_output(plan->io, l->data, bufs[n_shapes + i],
+                            tl_tensor_size(tensor), error);
+     }
+     if (!*error)
+          ln_io_run(plan->io, error);
+     for (l = cache->outputs, i = 0; l && !*error; l = l->next, i++) {
+          if (!bufs[n_shapes + i])
+               continue;
+          tensor = ln_io_find_output(plan->io, l->data);
+          trim_axis(outputs[i], bufs[n_shapes + i], tensor, axes[i], batch,
+                    bucket);
+     }
+     if (!*error) {
+          cache->stat.batch_rows += batch;
+          cache->stat.padded_rows += bucket - batch;
+     }
+
+     /* the plan mustn't keep pointers to buffers of this run */
+     unbind_all(plan, shapes, n_shapes, cache->outputs);
+     for (i = 0; i < n_shapes + n_outputs; i++)
+          ln_free(bufs[i]);
+     ln_free(bufs);
+     ln_free(axes);
+end:
+     for (i = 0; i < n_shapes; i++)
+          ln_free((int *)planned[i].dims);
+     ln_free(planned);
+}
+
+int ln_plan_cache_size(ln_plan_cache *cache)
+{
+     return ln_list_length(cache->plans);
+}
+
+void ln_plan_cache_get_stat(ln_plan_cache *cache, ln_plan_stat *stat)
+{
+     *stat = cache->stat;
+}
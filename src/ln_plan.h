@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_PLAN_H_
+#define _LN_PLAN_H_
+
+#include "ln_list.h"
+#include "ln_error.h"
+#include "ln_parse.h"
+#include "ln_pass.h"
+#include "ln_io.h"
+
+/*
+ * A net prepared and optimized for one set of input shapes, with its
+ * inputs and outputs ready to be bound and run.
+ */
+typedef struct ln_plan ln_plan;
+struct ln_plan {
+     char          *key;        /* the input shapes it's for */
+     ln_list       *ops;
+     ln_io         *io;
+     unsigned long  last_use;
+};
+
+typedef struct ln_plan_stat ln_plan_stat;
+struct ln_plan_stat {
+     unsigned long hits;
+     unsigned long misses;
+     unsigned long evictions;
+     unsigned long batch_rows;  /* batch rows requested to run */
+     unsigned long padded_rows; /* rows padded up to the buckets */
+};
+
+typedef struct ln_plan_cache ln_plan_cache;
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_plan_cache *ln_plan_cache_create(const char *json_str,
+                                    ln_list *registered_ops,
+                                    ln_list *pipeline, ln_pass_arg *pass_arg,
+                                    ln_list *outputs, int capacity);
+void ln_plan_cache_free(ln_plan_cache *cache);
+ln_plan *ln_plan_cache_get(ln_plan_cache *cache, const ln_shape *shapes,
+                           int n_shapes, ln_error **error);
+void ln_plan_cache_set_buckets(ln_plan_cache *cache, const int *buckets,
+                               int n_buckets);
+int ln_plan_cache_bucket(ln_plan_cache *cache, int batch);
+void ln_plan_cache_set_batch_axis(ln_plan_cache *cache, const char *output,
+                                  int axis);
+void ln_plan_cache_run(ln_plan_cache *cache, const ln_shape *shapes,
+                       int n_shapes, const void *const *inputs,
+                       void *const *outputs, ln_error **error);
+int ln_plan_cache_size(ln_plan_cache *cache);
+void ln_plan_cache_get_stat(ln_plan_cache *cache, ln_plan_stat *stat);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_PLAN_H_ */
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#define SERVE_AFFINITY
+#endif
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ln_serve.h"
+#include "ln_parse.h"
+#include "ln_io.h"
+
+struct request {
+     const void *const *inputs;
+     void *const       *outputs;
+     ln_error          *error;
+     int                done;
+};
+
+struct instance {
+     ln_serve  *serve;
+     ln_list   *ops;
+     ln_io     *io;
+     int        first_cpu;
+     int        n_cpus;         /* cpus it's pinned to, or 0 */
+     pthread_t  thread;
+};
+
+struct ln_serve {
+     ln_list         *inputs;
+     ln_list         *outputs;
+     struct instance *instances;
+     int              n_instances;
+     int              n_started;
+     size_t           shared_bytes;
+     size_t           activation_bytes;
+     unsigned long    n_requests;
+     pthread_mutex_t  lock;
+     pthread_cond_t   work_cond;  /* a request is queued, or stopping */
+     pthread_cond_t   done_cond;  /* a request is done */
+     ln_list         *queue;      /* requests no instance has taken yet */
+     int              stopping;
+};
+
+static int is_input(ln_list *inputs, const char *name)
+{
+     char *input;
+
+     LN_LIST_FOREACH(input, inputs) {
+          if (!strcmp(input, name))
+               return 1;
+     }
+     return 0;
+}
+
+/* an op whose outputs are all constants, made once by the first instance */
+static int is_constant_op(ln_op *op, ln_list *inputs)
+{
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if (!te->isstatic || is_input(inputs, te->name))
+               return 0;
+     }
+     return op->op_arg->tensors_out != NULL;
+}
+
+/* the bytes of the constants of the first instance, kept once */
+static size_t constant_bytes(ln_list *ops, ln_list *inputs)
+{
+     ln_tensor_entry *te;
+     ln_op *op;
+     size_t bytes = 0;
+
+     LN_LIST_FOREACH(op, ops) {
+          if (!is_constant_op(op, inputs))
+               continue;
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!te->owner && te->tensor && te->tensor->data)
+                    bytes += tl_tensor_size(te->tensor);
+          }
+     }
+     return bytes;
+}
+
+/* the clone of a constant op doesn't own the tensors it shares */
+static void shared_nop(ln_op_arg *op_arg, ln_error **error)
+{
+}
+
+/*
+ * Copy table for a clone of its op. With shared, the entries keep their
+ * tensors; otherwise the tensors are looked up by name in ops, the clones
+ * made so far, and the rest is left to the pre_run of the clone.
+ */
+static ln_tensor_table *tensor_table_clone(ln_tensor_table *table,
+                                           ln_list *ops, int shared)
+{
+     ln_tensor_table *clone = NULL;
+     ln_tensor_entry *te, *new_te;
+     tl_tensor *tensor;
+
+     LN_LIST_FOREACH(te, table) {
+          tensor = shared ? te->tensor
+               : ln_op_list_find_tensor_by_name(ops, te->name);
+          clone = ln_tensor_table_append(clone, te->arg_name, te->name,
+                                         te->mtype, tensor);
+          new_te = ln_tensor_table_find_by_arg_name(clone, te->arg_name);
+          new_te->offset = te->offset;
+          new_te->isdead = te->isdead;
+          if (!shared)
+               continue;
+          new_te->isstatic = te->isstatic;
+          if (te->inplace)
+               new_te->inplace = ln_strdup(te->inplace);
+          if (te->owner)
+               new_te->owner = ln_strdup(te->owner);
+     }
+     return clone;
+}
+
+/*
+ * Clone op after the clones in ops. A constant op becomes one reading the
+ * tensors of op, doing nothing; any other op is pre_run again to get its
+ * own activations and private data.
+ */
+static ln_op *op_clone(ln_op *op, ln_list *ops, ln_list *inputs,
+                       ln_error **error)
+{
+     ln_op_arg *arg = op->op_arg;
+     ln_op *clone;
+
+     if (is_constant_op(op, inputs))
+          return ln_op_create(arg->name, arg->optype,
+                              tensor_table_clone(arg->tensors_in, ops, 1),
+                              tensor_table_clone(arg->tensors_out, ops, 1),
+                              NULL, shared_nop, shared_nop, shared_nop);
+
+     clone = ln_op_create(arg->name, arg->optype,
+                          tensor_table_clone(arg->tensors_in, ops, 0),
+                          tensor_table_clone(arg->tensors_out, ops, 0),
+                          ln_param_table_copy(arg->params),
+                          op->pre_run, op->run, op->post_run);
+     ln_op_copy_impl(clone, op);
+     clone->pre_run(clone->op_arg, error);
+     if (*error) {
+          ln_param_table_free(clone->op_arg->params);
+          ln_tensor_table_free(clone->op_arg->tensors_in);
+          ln_tensor_table_free(clone->op_arg->tensors_out);
+          ln_op_free(clone);
+          return NULL;
+     }
+     return clone;
+}
+
+/*
+ * Clone the prepared ops of the first instance, sharing its constants, so
+ * that neither the net is parsed nor the constants are made again. Ops
+ * defining a tensor again, as rematerialized ones sharing the private data
+ * of another op, can't be cloned.
+ */
+static ln_list *ops_clone(ln_list *ops, ln_list *inputs, ln_error **error)
+{
+     ln_hash *defined;          /* names of tensors cloned */
+     ln_error *post_error = NULL;
+     ln_list *clones = NULL;
+     ln_tensor_entry *te;
+     ln_op *op, *clone;
+
+     defined = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (ln_hash_find_extended(defined, te->name, NULL)) {
+                    *error = ln_error_create(LN_ERROR,
+                                             "serve: can't clone ops defining \"%s\" twice",
+                                             te->name);
+                    goto err;
+               }
+               ln_hash_insert(defined, te->name, NULL);
+          }
+          clone = op_clone(op, clones, inputs, error);
+          if (*error)
+               goto err;
+          clones = ln_list_append(clones, clone);
+     }
+     ln_hash_free(defined);
+     return clones;
+
+err:
+     ln_hash_free(defined);
+     ln_op_list_do_post_run(clones, &post_error);
+     ln_error_handle(&post_error);
+     ln_op_list_free_tables_too(clones);
+     return NULL;
+}
+
+static size_t activation_bytes(struct instance *inst)
+{
+     ln_tensor_entry *te;
+     ln_op *op;
+     size_t bytes = 0;
+
+     LN_LIST_FOREACH(op, inst->ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!te->isstatic && !te->owner)
+                    bytes += tl_tensor_size(te->tensor);
+          }
+     }
+     return bytes;
+}
+
+/* the first instance, with its ops parsed from json_str */
+static void instance_init(struct instance *inst, ln_serve *serve,
+                          const char *json_str, ln_list *registered_ops,
+                          ln_list *pipeline, ln_pass_arg *pass_arg,
+                          ln_error **error)
+{
+     inst->serve = serve;
+     inst->io = NULL;
+     inst->ops = ln_parse_ops(json_str, registered_ops, error);
+     if (*error)
+          return;
+     inst->ops = ln_pass_pipeline_run(pipeline, inst->ops, pass_arg, NULL,
+                                      error);
+     if (*error)
+          return;
+     inst->io = ln_io_create(inst->ops, serve->inputs, serve->outputs, error);
+}
+
+/* another instance, with its ops cloned from those of first */
+static void instance_init_clone(struct instance *inst, struct instance *first,
+                                ln_error **error)
+{
+     ln_serve *serve = first->serve;
+
+     inst->serve = serve;
+     inst->io = NULL;
+     inst->ops = ops_clone(first->ops, serve->inputs, error);
+     if (*error)
+          return;
+     inst->io = ln_io_create(inst->ops, serve->inputs, serve->outputs, error);
+}
+
+static void instance_fini(struct instance *inst)
+{
+     ln_error *error = NULL;
+
+     if (inst->io)
+          ln_io_free(inst->io);
+     ln_op_list_do_post_run(inst->ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(inst->ops);
+}
+
+static void pin(struct instance *inst)
+{
+#ifdef SERVE_AFFINITY
+     cpu_set_t set;
+     long n_cpus;
+     int i;
+
+     if (inst->n_cpus <= 0)
+          return;
+     n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+     CPU_ZERO(&set);
+     for (i = 0; i < inst->n_cpus; i++)
+          CPU_SET((inst->first_cpu + i) % n_cpus, &set);
+     pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static void run_request(struct instance *inst, struct request *req)
+{
+     ln_serve *serve = inst->serve;
+     ln_error *error = NULL;
+     tl_tensor *tensor;
+     ln_list *l;
+     int i;
+
+     for (l = serve->inputs, i = 0; l && !req->error; l = l->next, i++) {
+          tensor = ln_io_find_input(inst->io, l->data);
+          ln_io_bind_input(inst->io, l->data, req->inputs[i],
+                           tl_tensor_size(tensor), &req->error);
+     }
+     for (l = serve->outputs, i = 0; l && !req->error; l = l->next, i++) {
+          tensor = ln_io_find_output(inst->io, l->data);
+          ln_io_bind_output(inst->io, l->data, req->outputs[i],
+                            tl_tensor_size(tensor), &req->error);
+     }
+     if (!req->error)
+          ln_io_run(inst->io, &req->error);
+
+     /* the instance mustn't keep pointers to buffers of the request */
+     for (l = serve->inputs; l; l = l->next)
+          ln_io_bind_input(inst->io, l->data, NULL, 0, &error);
+     for (l = serve->outputs; l; l = l->next)
+          ln_io_bind_output(inst->io, l->data, NULL, 0, &error);
+     ln_error_handle(&error);
+}
+
+/* take queued requests until stopping, so an idle instance gets the next */
+static void *work(void *arg)
+{
+     struct instance *inst = arg;
+     ln_serve *serve = inst->serve;
+     struct request *req;
+
+     pin(inst);
+     pthread_mutex_lock(&serve->lock);
+     for (;;) {
+          while (!serve->queue && !serve->stopping)
+               pthread_cond_wait(&serve->work_cond, &serve->lock);
+          if (!serve->queue)
+               break;
+          req = serve->queue->data;
+          serve->queue = ln_list_remove_nth(serve->queue, 0);
+          pthread_mutex_unlock(&serve->lock);
+
+          run_request(inst, req);
+
+          pthread_mutex_lock(&serve->lock);
+          req->done = 1;
+          serve->n_requests++;
+          pthread_cond_broadcast(&serve->done_cond);
+     }
+     pthread_mutex_unlock(&serve->lock);
+
+     return NULL;
+}
+
+/*
+ * Make n_instances instances of the net json_str, with pipeline run on its
+ * ops with pass_arg, and inputs and outputs as the names of its graph
+ * inputs and outputs. Only the first instance is parsed and optimized,
+ * making the constants; the others are cloned from its ops, reading its
+ * constants and allocating only their own activations and op private
+ * data. Passes defining a tensor twice, such as "remat", can't be in
+ * pipeline. With cpus_per_instance > 0, instance i is pinned to
+ * cpus_per_instance cpus from cpu i * cpus_per_instance on. inputs and
+ * outputs should outlive the returned ln_serve.
+ */
+ln_serve *ln_serve_create(const char *json_str, ln_list *registered_ops,
+                          ln_list *pipeline, ln_pass_arg *pass_arg,
+                          ln_list *inputs, ln_list *outputs,
+                          int n_instances, int cpus_per_instance,
+                          ln_error **error)
+{
+     struct instance *inst;
+     ln_serve *serve;
+     int i;
+
+     if (n_instances < 1 || !outputs) {
+          *error = ln_error_create(LN_ERROR,
+                                   "serve: needs at least one instance and some outputs");
+          return NULL;
+     }
+     serve = ln_alloc(sizeof(ln_serve));
+     memset(serve, 0, sizeof(ln_serve));
+     serve->inputs = inputs;
+     serve->outputs = outputs;
+     serve->instances = ln_alloc(sizeof(struct instance) * n_instances);
+     memset(serve->instances, 0, sizeof(struct instance) * n_instances);
+     pthread_mutex_init(&serve->lock, NULL);
+     pthread_cond_init(&serve->work_cond, NULL);
+     pthread_cond_init(&serve->done_cond, NULL);
+
+     for (i = 0; i < n_instances; i++) {
+          inst = &serve->instances[i];
+          if (i == 0)
+               instance_init(inst, serve, json_str, registered_ops, pipeline,
+                             pass_arg, error);
+          else
+               instance_init_clone(inst, &serve->instances[0], error);
+          serve->n_instances++;
+          if (*error)
+               goto err;
+          inst->first_cpu = i * cpus_per_instance;
+          inst->n_cpus = cpus_per_instance;
+     }
+     if (n_instances > 1)
+          serve->shared_bytes = constant_bytes(serve->instances[0].ops,
+                                               inputs);
+     serve->activation_bytes = activation_bytes(&serve->instances[0]);
+
+     for (i = 0; i < n_instances; i++) {
+          inst = &serve->instances[i];
+          if (pthread_create(&inst->thread, NULL, work, inst)) {
+               *error = ln_error_create(LN_ERROR_SYS,
+                                        "serve: cannot create thread");
+               goto err;
+          }
+          serve->n_started++;
+     }
+     return serve;
+
+err:
+     ln_serve_free(serve);
+     return NULL;
+}
+
+void ln_serve_free(ln_serve *serve)
+{
+     int i;
+
+     pthread_mutex_lock(&serve->lock);
+     serve->stopping = 1;
+     pthread_cond_broadcast(&serve->work_cond);
+     pthread_mutex_unlock(&serve->lock);
+     for (i = 0; i < serve->n_started; i++)
+          pthread_join(serve->instances[i].thread, NULL);
+
+     /* the first instance last, as the others share its constants */
+     for (i = serve->n_instances - 1; i >= 0; i--)
+          instance_fini(&serve->instances[i]);
+     pthread_cond_destroy(&serve->done_cond);
+     pthread_cond_destroy(&serve->work_cond);
+     pthread_mutex_destroy(&serve->lock);
+     ln_free(serve->instances);
+     ln_free(serve);
+}
+
+/*
+ * Run the net on inputs[i], the data of the i-th input, writing the i-th
+ * output to outputs[i], on the first idle instance. It's safe to call from
+ * many threads at once, and returns when the request is done.
+ */
+void ln_serve_run(ln_serve *serve, const void *const *inputs,
+                  void *const *outputs, ln_error **error)
+{
+     struct request req;
+
+     req.inputs = inputs;
+     req.outputs = outputs;
+     req.error = NULL;
+     req.done = 0;
+
+     pthread_mutex_lock(&serve->lock);
+     serve->queue = ln_list_append(serve->queue, &req);
+     pthread_cond_signal(&serve->work_cond);
+     while (!req.done)
+          pthread_cond_wait(&serve->done_cond, &serve->lock);
+     pthread_mutex_unlock(&serve->lock);
+
+     *error = req.error;
+}
+
+void ln_serve_get_stat(ln_serve *serve, ln_serve_stat *stat)
+{
+     pthread_mutex_lock(&serve->lock);
+     stat->n_instances = serve->n_instances;
+     stat->shared_bytes = serve->shared_bytes;
+     stat->activation_bytes = serve->activation_bytes;
+     stat->n_requests = serve->n_requests;
+     pthread_mutex_unlock(&serve->lock);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_SERVE_H_
+#define _LN_SERVE_H_
+
+#include "ln_list.h"
+#include "ln_error.h"
+#include "ln_pass.h"
+
+/*
+ * Instances of a net running requests in parallel, each in a thread of
+ * its own with its own activations and op private data, and all reading
+ * the same constants, such as the data of "create" ops.
+ */
+typedef struct ln_serve ln_serve;
+
+typedef struct ln_serve_stat ln_serve_stat;
+struct ln_serve_stat {
+     int           n_instances;
+     size_t        shared_bytes;      /* constants kept once for all */
+     size_t        activation_bytes;  /* tensors each instance has */
+     unsigned long n_requests;
+};
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_serve *ln_serve_create(const char *json_str, ln_list *registered_ops,
+                          ln_list *pipeline, ln_pass_arg *pass_arg,
+                          ln_list *inputs, ln_list *outputs,
+                          int n_instances, int cpus_per_instance,
+                          ln_error **error);
+void ln_serve_free(ln_serve *serve);
+void ln_serve_run(ln_serve *serve, const void *const *inputs,
+                  void *const *outputs, ln_error **error);
+void ln_serve_get_stat(ln_serve *serve, ln_serve_stat *stat);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_SERVE_H_ */
@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include "ln_sim.h"
+#include "ln_hash.h"
+
+typedef enum sim_job_type sim_job_type;
+enum sim_job_type {
+     SIM_KERNEL,
+     SIM_COPY,                  /* a transfer, copying dst from src */
+     SIM_DELAY,                 /* a transfer whose data has been copied */
+     SIM_RECORD,                /* mark event done */
+     SIM_WAIT                   /* wait for event */
+};
+
+/* an event is done when the jobs queued before its record are done */
+struct sim_event {
+     int done;
+};
+
+struct sim_job {
+     sim_job_type      type;
+     ln_sim_func       func;
+     void             *arg;
+     void             *dst;
+     const void       *src;
+     size_t            size;
+     struct sim_event *event;
+};
+
+enum {
+     COMPUTE_STREAM,
+     COPY_STREAM,
+     N_STREAMS
+};
+
+struct sim_stream {
+     pthread_t       worker;
+     pthread_cond_t  queued;    /* signaled when a job is queued or on quit */
+     ln_list        *jobs;
+     size_t          n_pending; /* queued or running jobs */
+};
+
+/* there is one device, like a CUDA device, since ops have no handle to it */
+static struct {
+     int               initialized;
+     ln_sim_config     config;
+     ln_sim_stat       stat;
+     pthread_mutex_t   mutex;
+     pthread_cond_t    idle;    /* signaled when a stream is idle */
+     pthread_cond_t    event_done;
+     struct sim_stream streams[N_STREAMS];
+     ln_hash          *events;  /* data -> event of its last write */
+     struct sim_event  kernels[2]; /* the last two kernels marking data ready */
+     size_t            n_kernels;
+     int               quit;
+} sim;
+
+static void wait_seconds(double seconds)
+{
+     struct timespec ts;
+
+     if (seconds <= 0)
+          return;
+     ts.tv_sec = (time_t)seconds;
+     ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+     while (nanosleep(&ts, &ts) < 0)
+          ;
+}
+
+static double transfer_time(size_t size)
+{
+     double t;
+
+     t = sim.config.link_latency;
+     if (sim.config.link_gbps > 0)
+          t += size / (sim.config.link_gbps * 1e9);
+     return t;
+}
+
+static void run_job(struct sim_job *job)
+{
+     double t;
+
+     switch (job->type) {
+     case SIM_KERNEL:
+          job->func(job->arg);
+          break;
+     case SIM_COPY:
+     case SIM_DELAY:
+          t = transfer_time(job->size);
+          wait_seconds(t);
+          if (job->type == SIM_COPY)
+               memmove(job->dst, job->src, job->size);
+          pthread_mutex_lock(&sim.mutex);
+          sim.stat.copy_time += t;
+          pthread_mutex_unlock(&sim.mutex);
+          break;
+     case SIM_RECORD:
+          pthread_mutex_lock(&sim.mutex);
+          job->event->done = 1;
+          pthread_cond_broadcast(&sim.event_done);
+          pthread_mutex_unlock(&sim.mutex);
+          break;
+     case SIM_WAIT:
+          pthread_mutex_lock(&sim.mutex);
+          while (!job->event->done)
+               pthread_cond_wait(&sim.event_done, &sim.mutex);
+          pthread_mutex_unlock(&sim.mutex);
+          break;
+     }
+}
+
+static void *worker_main(void *arg)
+{
+     struct sim_stream *stream = arg;
+     struct sim_job *job;
+
+     pthread_mutex_lock(&sim.mutex);
+     for (;;) {
+          while (!stream->jobs && !sim.quit)
+               pthread_cond_wait(&stream->queued, &sim.mutex);
+          if (!stream->jobs)
+               break;
+          job = stream->jobs->data;
+          stream->jobs = ln_list_remove_nth(stream->jobs, 0);
+          pthread_mutex_unlock(&sim.mutex);
+
+          run_job(job);
+          ln_free(job);
+
+          pthread_mutex_lock(&sim.mutex);
+          if (--stream->n_pending == 0)
+               pthread_cond_broadcast(&sim.idle);
+     }
+     pthread_mutex_unlock(&sim.mutex);
+
+     return NULL;
+}
+
+/*
+ * Start the simulated device with config, or restart it with a new config
+ * after the queued jobs are done.
+ */
+void ln_sim_init(const ln_sim_config *config)
+{
+     int i;
+
+     if (sim.initialized)
+          ln_sim_cleanup();
+     memset(&sim.stat, 0, sizeof(ln_sim_stat));
+     sim.config = *config;
+     sim.quit = 0;
+     sim.events = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, ln_free);
+     sim.kernels[0].done = 1;
+     sim.kernels[1].done = 1;
+     sim.n_kernels = 0;
+     pthread_mutex_init(&sim.mutex, NULL);
+     pthread_cond_init(&sim.idle, NULL);
+     pthread_cond_init(&sim.event_done, NULL);
+     for (i = 0; i < N_STREAMS; i++) {
+          sim.streams[i].jobs = NULL;
+          sim.streams[i].n_pending = 0;
+          pthread_cond_init(&sim.streams[i].queued, NULL);
+          if (pthread_create(&sim.streams[i].worker, NULL, worker_main,
+                             &sim.streams[i]))
+               ln_err_sys("cannot create a stream of the simulated device");
+     }
+     sim.initialized = 1;
+}
+
+/* stop the device after the queued jobs are done */
+void ln_sim_cleanup(void)
+{
+     int i;
+
+     if (!sim.initialized)
+          return;
+     ln_sim_sync();
+     pthread_mutex_lock(&sim.mutex);
+     sim.quit = 1;
+     for (i = 0; i < N_STREAMS; i++)
+          pthread_cond_signal(&sim.streams[i].queued);
+     pthread_mutex_unlock(&sim.mutex);
+     for (i = 0; i < N_STREAMS; i++) {
+          pthread_join(sim.streams[i].worker, NULL);
+          pthread_cond_destroy(&sim.streams[i].queued);
+     }
+     pthread_cond_destroy(&sim.event_done);
+     pthread_cond_destroy(&sim.idle);
+     pthread_mutex_destroy(&sim.mutex);
+     ln_hash_free(sim.events);
+     sim.initialized = 0;
+}
+
+int ln_sim_is_initialized(void)
+{
+     return sim.initialized;
+}
+
+/* whether transfers overlap kernels, see ln_sim_copy_async() */
+int ln_sim_is_async(void)
+{
+     return sim.initialized && sim.config.async;
+}
+
+static struct sim_job *job_create(sim_job_type type)
+{
+     struct sim_job *job;
+
+     job = ln_alloc(sizeof(struct sim_job));
+     memset(job, 0, sizeof(struct sim_job));
+     job->type = type;
+     return job;
+}
+
+/* should be called with sim.mutex locked */
+static void queue_job_locked(int stream, struct sim_job *job)
+{
+     switch (job->type) {
+     case SIM_KERNEL:
+          sim.stat.n_kernels++;
+          break;
+     case SIM_COPY:
+     case SIM_DELAY:
+          sim.stat.n_copies++;
+          sim.stat.bytes_copied += job->size;
+          break;
+     case SIM_RECORD:
+          job->event->done = 0;
+          break;
+     default:
+          break;
+     }
+     sim.streams[stream].jobs = ln_list_append(sim.streams[stream].jobs, job);
+     sim.streams[stream].n_pending++;
+     pthread_cond_signal(&sim.streams[stream].queued);
+}
+
+static void queue_job(int stream, struct sim_job *job)
+{
+     assert(sim.initialized);
+     pthread_mutex_lock(&sim.mutex);
+     queue_job_locked(stream, job);
+     pthread_mutex_unlock(&sim.mutex);
+}
+
+static void queue_record(int stream, struct sim_event *event)
+{
+     struct sim_job *job;
+
+     job = job_create(SIM_RECORD);
+     job->event = event;
+     queue_job(stream, job);
+}
+
+static void queue_wait(int stream, struct sim_event *event)
+{
+     struct sim_job *job;
+
+     job = job_create(SIM_WAIT);
+     job->event = event;
+     queue_job(stream, job);
+}
+
+static void event_sync(struct sim_event *event)
+{
+     pthread_mutex_lock(&sim.mutex);
+     while (!event->done)
+          pthread_cond_wait(&sim.event_done, &sim.mutex);
+     pthread_mutex_unlock(&sim.mutex);
+}
+
+/* the event of the last write of data, made if there isn't one */
+static struct sim_event *data_event(const void *data)
+{
+     struct sim_event *event;
+
+     pthread_mutex_lock(&sim.mutex);
+     event = ln_hash_find(sim.events, (void *)data);
+     if (!event) {
+          event = ln_alloc(sizeof(struct sim_event));
+          event->done = 1;
+          ln_hash_insert(sim.events, (void *)data, event);
+     }
+     pthread_mutex_unlock(&sim.mutex);
+     return event;
+}
+
+/*
+ * Queue func(arg) on the compute stream of the device and return, like a
+ * kernel launch. arg should be kept valid until ln_sim_sync().
+ */
+void ln_sim_launch(ln_sim_func func, void *arg)
+{
+     struct sim_job *job;
+
+     job = job_create(SIM_KERNEL);
+     job->func = func;
+     job->arg = arg;
+     queue_job(COMPUTE_STREAM, job);
+}
+
+/*
+ * Queue a transfer of size bytes on the compute stream, after the kernels
+ * queued before, taking the configured latency and bandwidth, and return.
+ */
+void ln_sim_copy(void *dst, const void *src, size_t size)
+{
+     struct sim_job *job;
+
+     job = job_create(SIM_COPY);
+     job->dst = dst;
+     job->src = src;
+     job->size = size;
+     queue_job(COMPUTE_STREAM, job);
+}
+
+/*
+ * Make the kernels queued from now on wait until data, if it's written by
+ * a transfer on the copy stream, is ready.
+ */
+void ln_sim_wait_ready(const void *data)
+{
+     if (!ln_sim_is_async())
+          return;
+     queue_wait(COMPUTE_STREAM, data_event(data));
+}
+
+/* mark data ready once the kernels queued so far are done */
+void ln_sim_set_ready(void *data)
+{
+     if (!ln_sim_is_async())
+          return;
+     queue_record(COMPUTE_STREAM, data_event(data));
+     queue_record(COMPUTE_STREAM, &sim.kernels[sim.n_kernels++ % 2]);
+}
+
+/*
+ * Transfer on the copy stream, overlapping the kernels of the compute
+ * stream. To the device, the host data is staged at once, so the host can
+ * reuse it, and dst is ready when the simulated transfer is done. Only the
+ * last kernel may still run when it's staged, which ln_optimize_mem()
+ * keeps from sharing memory with dst, so transfers are double-buffered.
+ * To the host, the transfer waits for src to be ready, and the host waits
+ * for the transfer.
+ */
+void ln_sim_copy_async(void *dst, const void *src, size_t size, int to_host)
+{
+     struct sim_event *event;
+     struct sim_job *job;
+
+     if (to_host) {
+          queue_wait(COPY_STREAM, data_event(src));
+          job = job_create(SIM_COPY);
+          job->dst = dst;
+          job->src = src;
+          job->size = size;
+          queue_job(COPY_STREAM, job);
+          event = data_event(dst);
+          queue_record(COPY_STREAM, event);
+          event_sync(event);
+          return;
+     }
+
+     /* the kernel before the last one was the previous user of dst */
+     event_sync(&sim.kernels[sim.n_kernels % 2]);
+     memcpy(dst, src, size);
+     job = job_create(SIM_DELAY);
+     job->size = size;
+     queue_job(COPY_STREAM, job);
+     queue_record(COPY_STREAM, data_event(dst));
+}
+
+/* wait until all queued jobs are done */
+void ln_sim_sync(void)
+{
+     int i;
+
+     if (!sim.initialized)
+          return;
+     pthread_mutex_lock(&sim.mutex);
+     for (i = 0; i < N_STREAMS; i++) {
+          while (sim.streams[i].n_pending > 0)
+               pthread_cond_wait(&sim.idle, &sim.mutex);
+     }
+     pthread_mutex_unlock(&sim.mutex);
+}
+
+/* counts of the jobs queued since ln_sim_init() */
+void ln_sim_get_stat(ln_sim_stat *stat)
+{
+     if (!sim.initialized) {
+          *stat = sim.stat;
+          return;
+     }
+     pthread_mutex_lock(&sim.mutex);
+     *stat = sim.stat;
+     pthread_mutex_unlock(&sim.mutex);
+}
+
+/* the backend of the device for ln_optimize_mtype() */
+void ln_sim_backend(ln_backend *backend)
+{
+     backend->name = "sim";
+     backend->mtype = LN_MEM_SIM;
+     backend->suffix = "_sim";
+     backend->copy_optype = "copy_sim";
+     backend->gflops = sim.config.gflops;
+     backend->gbps = sim.config.gbps;
+     backend->link_gbps = sim.config.link_gbps;
+     backend->link_latency = sim.config.link_latency;
+}
+
+/*
+ * The pool of device memory for memory planning. It has real memory, host
+ * memory like that of the device, so that ops can be run in it with
+ * ln_op_list_do_run_in_pools().
+ */
+ln_mem_pool *ln_sim_mem_pool_create(size_t align_size)
+{
+     return ln_mem_pool_create_arena(sim.config.mem_size, align_size);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_SIM_H_
+#define _LN_SIM_H_
+
+#include "ln_optimize.h"
+
+/*
+ * A simulated accelerator: memory of type LN_MEM_SIM, which is host memory,
+ * a compute stream and a copy stream, each run by a worker thread, running
+ * the CPU kernels, and transfers slowed down to a given bandwidth and
+ * latency.
+ */
+typedef struct ln_sim_config ln_sim_config;
+struct ln_sim_config {
+     double gflops;             /* GFLOP/s told to placement, 0 if unlimited */
+     double gbps;               /* memory GB/s told to placement */
+     double link_gbps;          /* simulated transfer GB/s, 0 if unlimited */
+     double link_latency;       /* simulated seconds per transfer */
+     size_t mem_size;           /* bytes of device memory, for its pool */
+     int    async;              /* overlap transfers with kernels */
+};
+
+typedef struct ln_sim_stat ln_sim_stat;
+struct ln_sim_stat {
+     size_t n_kernels;
+     size_t n_copies;
+     size_t bytes_copied;
+     double copy_time;          /* simulated seconds of transfers */
+};
+
+typedef void (*ln_sim_func) (void *arg);
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+void ln_sim_init(const ln_sim_config *config);
+void ln_sim_cleanup(void);
+int ln_sim_is_initialized(void);
+void ln_sim_launch(ln_sim_func func, void *arg);
+void ln_sim_copy(void *dst, const void *src, size_t size);
+void ln_sim_wait_ready(const void *data);
+void ln_sim_set_ready(void *data);
+int ln_sim_is_async(void);
+void ln_sim_copy_async(void *dst, const void *src, size_t size, int to_host);
+void ln_sim_sync(void);
+void ln_sim_get_stat(ln_sim_stat *stat);
+void ln_sim_backend(ln_backend *backend);
+ln_mem_pool *ln_sim_mem_pool_create(size_t align_size);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_SIM_H_ */
@@ -35,6 +35,11 @@ static ln_tensor_entry *ln_tensor_entry_create(const char *name, const char *arg
      strcpy(entry->arg_name, arg_name);
      entry->mtype = mtype;
      entry->tensor = tensor;
+     entry->inplace = NULL;
+     entry->owner = NULL;
+     entry->offset = 0;
+     entry->isstatic = 0;
+     entry->isdead = 0;
 
      return entry;
 }
@@ -43,6 +48,8 @@ static void ln_tensor_entry_free(ln_tensor_entry *entry)
 {
      ln_free(entry->name);
      ln_free(entry->arg_name);
+     ln_free(entry->inplace);
+     ln_free(entry->owner);
      ln_free(entry);
 }
 
@@ -113,3 +120,11 @@ int ln_tensor_table_length(ln_tensor_table *table)
 {
      return ln_list_length(table);
 }
+
+/* bytes of the tensor's data, or 0 if it isn't made yet */
+size_t ln_tensor_entry_size(ln_tensor_entry *entry)
+{
+     if (!entry || !entry->tensor)
+          return 0;
+     return entry->tensor->len * tl_size_of(entry->tensor->dtype);
+}
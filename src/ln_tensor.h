@@ -33,6 +33,11 @@ struct ln_tensor_entry {
      char       *arg_name;
      tl_tensor  *tensor;
      ln_mem_type mtype;
+     char       *inplace;   /* input tensor whose memory this tensor can reuse */
+     char       *owner;     /* tensor whose data this tensor shares, or NULL */
+     size_t      offset;    /* address in memory pool, set by memory planner */
+     int         isstatic;  /* data is set in pre_run and kept, never planned */
+     int         isdead;    /* no one reads it, so its op may skip it */
 };
 
 typedef ln_list ln_tensor_table;
@@ -50,6 +55,7 @@ ln_tensor_entry *ln_tensor_table_find_by_arg_name(ln_tensor_table *table,
 ln_tensor_entry *ln_tensor_table_find_by_name(ln_tensor_table *table,
 					      char *name);
 int ln_tensor_table_length(ln_tensor_table *table);
+size_t ln_tensor_entry_size(ln_tensor_entry *entry);
 
 #ifdef __cplusplus
 LN_CPPEND
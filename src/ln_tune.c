@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "ln_tune.h"
+#include "cJSON.h"
+
+#define TUNE_RUNS 5
+
+/*
+ * The CPU model from /proc/cpuinfo, or "unknown" if it can't be found.
+ * Returned string should be freed.
+ */
+char *ln_tune_cpu_model(void)
+{
+     char line[256];
+     char *p, *end;
+     FILE *fp;
+
+     if (!(fp = fopen("/proc/cpuinfo", "r")))
+          return ln_strdup("unknown");
+     while (fgets(line, sizeof(line), fp)) {
+          if (strncmp(line, "model name", strlen("model name")))
+               continue;
+          if (!(p = strchr(line, ':')))
+               continue;
+          for (p++; *p == ' ' || *p == '\t'; p++)
+               ;
+          for (end = p + strlen(p); end > p && (end[-1] == '\n'
+                                               || end[-1] == ' '); end--)
+               ;
+          *end = '\0';
+          fclose(fp);
+          return ln_strdup(p);
+     }
+     fclose(fp);
+
+     return ln_strdup("unknown");
+}
+
+static void print_tensors(FILE *fp, ln_tensor_table *tensors)
+{
+     ln_tensor_entry *te;
+     int i;
+
+     LN_LIST_FOREACH(te, tensors) {
+          fprintf(fp, "%s:%d:", te->arg_name, te->tensor->dtype);
+          for (i = 0; i < te->tensor->ndim; i++)
+               fprintf(fp, i ? "x%d" : "%d", te->tensor->dims[i]);
+          fprintf(fp, ";");
+     }
+}
+
+static void print_params(FILE *fp, ln_param_table *params)
+{
+     ln_param_entry *pe;
+     int i;
+
+     LN_LIST_FOREACH(pe, params) {
+          fprintf(fp, "%s=", pe->arg_name);
+          switch (pe->type) {
+          case LN_PARAM_STRING:
+               fprintf(fp, "%s", pe->value_string);
+               break;
+          case LN_PARAM_NUMBER:
+               fprintf(fp, "%.17g", pe->value_double);
+               break;
+          case LN_PARAM_BOOL:
+               fprintf(fp, "%d", pe->value_bool);
+               break;
+          case LN_PARAM_ARRAY_STRING:
+               for (i = 0; i < pe->array_len; i++)
+                    fprintf(fp, i ? ",%s" : "%s", pe->value_array_string[i]);
+               break;
+          case LN_PARAM_ARRAY_NUMBER:
+               for (i = 0; i < pe->array_len; i++)
+                    fprintf(fp, i ? ",%.17g" : "%.17g",
+                            pe->value_array_double[i]);
+               break;
+          case LN_PARAM_ARRAY_BOOL:
+               for (i = 0; i < pe->array_len; i++)
+                    fprintf(fp, i ? ",%d" : "%d", pe->value_array_bool[i]);
+               break;
+          default:
+               break;
+          }
+          fprintf(fp, ";");
+     }
+}
+
+/*
+ * The key of op's tuning result: the CPU model, its optype, the dtypes and
+ * shapes of its tensors and its params, which decide the speed of a
+ * variant. Returned key should be freed.
+ */
+char *ln_tune_key(ln_op *op, const char *cpu_model)
+{
+     size_t size;
+     char *key;
+     FILE *fp;
+
+     fp = open_memstream(&key, &size);
+     fprintf(fp, "%s|%s|", cpu_model, op->op_arg->optype);
+     print_tensors(fp, op->op_arg->tensors_in);
+     fprintf(fp, "|");
+     print_tensors(fp, op->op_arg->tensors_out);
+     fprintf(fp, "|");
+     print_params(fp, op->op_arg->params);
+     fclose(fp);
+
+     return key;
+}
+
+static int n_variants(ln_op *op)
+{
+     const ln_op_variant *v;
+     int n;
+
+     if (!op->variants)
+          return 0;
+     for (v = op->variants, n = 0; v->name; v++, n++)
+          ;
+     return n;
+}
+
+static int is_tunable(ln_op *op)
+{
+     ln_tensor_entry *te;
+
+     if (n_variants(op) < 2)
+          return 0;
+     LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+          if (!te->tensor)
+               return 0;
+     }
+     LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+          if (!te->tensor)
+               return 0;
+     }
+     return 1;
+}
+
+static double now(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* the shortest of TUNE_RUNS runs of run after a warmup run */
+static double time_variant(ln_op *op, ln_op_func run, ln_error **error)
+{
+     double best, start, t;
+     int i;
+
+     run(op->op_arg, error);
+     if (*error)
+          return 0;
+     best = -1;
+     for (i = 0; i < TUNE_RUNS; i++) {
+          start = now();
+          run(op->op_arg, error);
+          t = now() - start;
+          if (*error)
+               return 0;
+          if (best < 0 || t < best)
+               best = t;
+     }
+
+     return best;
+}
+
+static cJSON *load_cache(const char *path, ln_error **error)
+{
+     cJSON *cache;
+     char *str;
+     long size;
+     FILE *fp;
+
+     if (!path || !(fp = fopen(path, "rb"))) {
+          if (path && errno != ENOENT)
+               *error = ln_error_create(LN_WARNING_SYS,
+                                        "cannot open tuning cache %s", path);
+          return cJSON_CreateObject();
+     }
+     fseek(fp, 0, SEEK_END);
+     size = ftell(fp);
+     rewind(fp);
+     str = ln_alloc(size + 1);
+     size = fread(str, 1, size, fp);
+     str[size] = '\0';
+     fclose(fp);
+
+     cache = cJSON_Parse(str);
+     ln_free(str);
+     if (!cJSON_IsObject(cache)) {
+          *error = ln_error_create(LN_WARNING,
+                                   "tuning cache %s is malformed, ignored",
+                                   path);
+          cJSON_Delete(cache);
+          return cJSON_CreateObject();
+     }
+
+     return cache;
+}
+
+/* return 0 if the cache can't be written */
+static int save_cache(const char *path, cJSON *cache)
+{
+     char *str;
+     FILE *fp;
+
+     if (!(fp = fopen(path, "w")))
+          return 0;
+     str = cJSON_Print(cache);
+     fprintf(fp, "%s\n", str);
+     cJSON_free(str);
+
+     return fclose(fp) == 0;
+}
+
+/*
+ * Choose the fastest variant of run for every op that has more than one,
+ * with the shapes its pre_run made. The choice is looked up in the
+ * tuning cache file cache_path, and ops missing there are benchmarked and
+ * their choices written back, so that the next load of the same model on
+ * the same CPU is instant. cache_path can be NULL to always benchmark.
+ * The number of benchmarked ops is returned in n_benchmarked if it isn't
+ * NULL.
+ */
+void ln_tune_ops(ln_list *ops, const char *cache_path, int *n_benchmarked,
+                 ln_error **error)
+{
+     const ln_op_variant *v, *best;
+     ln_error *cache_error = NULL;
+     double t, best_time;
+     cJSON *cache, *item;
+     char *cpu_model, *key;
+     int n;
+     ln_op *op;
+
+     cache = load_cache(cache_path, &cache_error);
+     cpu_model = ln_tune_cpu_model();
+     n = 0;
+     LN_LIST_FOREACH(op, ops) {
+          if (!is_tunable(op))
+               continue;
+          key = ln_tune_key(op, cpu_model);
+          item = cJSON_GetObjectItemCaseSensitive(cache, key);
+          if (cJSON_IsString(item)
+              && (v = ln_op_find_variant(op, item->valuestring))) {
+               op->run = v->run;
+               ln_free(key);
+               continue;
+          }
+
+          best = NULL;
+          best_time = 0;
+          for (v = op->variants; v->name; v++) {
+               t = time_variant(op, v->run, error);
+               if (*error) {
+                    ln_free(key);
+                    goto end;
+               }
+               if (!best || t < best_time) {
+                    best = v;
+                    best_time = t;
+               }
+          }
+          op->run = best->run;
+          if (item)
+               cJSON_ReplaceItemInObjectCaseSensitive(cache, key,
+                                         cJSON_CreateString(best->name));
+          else
+               cJSON_AddStringToObject(cache, key, best->name);
+          ln_free(key);
+          n++;
+     }
+     if (n > 0 && cache_path && !save_cache(cache_path, cache)
+         && !cache_error)
+          cache_error = ln_error_create(LN_WARNING_SYS,
+                                        "cannot write tuning cache %s",
+                                        cache_path);
+
+end:
+     if (n_benchmarked)
+          *n_benchmarked = n;
+     if (cache_error) {
+          if (*error)
+               ln_error_free(cache_error);
+          else
+               *error = cache_error;
+     }
+     ln_free(cpu_model);
+     cJSON_Delete(cache);
+}
@@ -63,6 +63,15 @@ void *ln_repeat(void *data, size_t size, int times)
      return dst;
 }
 
+char *ln_strdup(const char *s)
+{
+     char *new_s;
+
+     new_s = ln_alloc(sizeof(char)*(strlen(s)+1));
+     strcpy(new_s, s);
+     return new_s;
+}
+
 static void err_doit(int errnoflag, int error, const char *fmt, va_list ap)
 {
      char buf[LN_MAXLINE];
@@ -22,9 +22,43 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <check.h>
 
 #include "test_lightnet.h"
+#include "../src/ln_util.h"
+
+/* read a whole file into a NUL-terminated string, freed with ln_free() */
+char *read_json(const char *file)
+{
+     struct stat buf;
+     char *json_str;
+     FILE *fp;
+     size_t n;
+
+     if (stat(file, &buf) < 0) {
+          fprintf(stderr, "Cannot stat %s: ", file);
+          perror(NULL);
+          exit(EXIT_FAILURE);
+     }
+
+     json_str = ln_alloc(buf.st_size + 1);
+     if (!(fp = fopen(file, "rb"))) {
+          fprintf(stderr, "Cannot open %s: ", file);
+          perror(NULL);
+          exit(EXIT_FAILURE);
+     }
+     n = fread(json_str, buf.st_size, 1, fp);
+     if (n < 1 && ferror(fp)) {
+          fprintf(stderr, "Error reading %s: ", file);
+          perror(NULL);
+          exit(EXIT_FAILURE);
+     }
+     json_str[buf.st_size] = '\0';
+
+     fclose(fp);
+     return json_str;
+}
 
 int main(int argc, char **argv)
 {
@@ -42,6 +76,15 @@ int main(int argc, char **argv)
      srunner_add_suite(sr, make_mem_suite());
      srunner_add_suite(sr, make_hash_suite());
      srunner_add_suite(sr, make_optimize_suite());
+     srunner_add_suite(sr, make_pass_suite());
+     srunner_add_suite(sr, make_tune_suite());
+     srunner_add_suite(sr, make_sim_suite());
+     srunner_add_suite(sr, make_compile_suite());
+     srunner_add_suite(sr, make_jit_suite());
+     srunner_add_suite(sr, make_kernel_suite());
+     srunner_add_suite(sr, make_io_suite());
+     srunner_add_suite(sr, make_plan_suite());
+     srunner_add_suite(sr, make_serve_suite());
      /* end of adding suites */
 
      srunner_set_xml (sr, "result/check_output.xml");
@@ -43,8 +43,19 @@ Suite *make_parse_suite(void);
 Suite *make_mem_suite(void);
 Suite *make_hash_suite(void);
 Suite *make_optimize_suite(void);
+Suite *make_pass_suite(void);
+Suite *make_tune_suite(void);
+Suite *make_sim_suite(void);
+Suite *make_compile_suite(void);
+Suite *make_jit_suite(void);
+Suite *make_kernel_suite(void);
+Suite *make_io_suite(void);
+Suite *make_plan_suite(void);
+Suite *make_serve_suite(void);
 /* end of declarations */
 
+char *read_json(const char *file);
+
 #ifdef __cplusplus
 CPPEND
 #endif
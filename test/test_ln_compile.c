@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_lightnet.h"
+#include "../src/ln_compile.h"
+#include "../src/ln_parse.h"
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_compile.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+}
+
+static void teardown(void)
+{
+     ln_free(json_str);
+     ln_list_free(registered_ops);
+}
+
+/* the C code ln_compile() writes, or NULL if there is an error */
+static char *compile(ln_list *ops, ln_list *inputs, ln_list *outputs)
+{
+     char *code;
+     long size;
+     FILE *fp;
+
+     fp = tmpfile();
+     ln_compile(ops, inputs, outputs, "net", fp, &error);
+     size = ftell(fp);
+     if (error) {
+          ck_assert_int_eq(size, 0);
+          fclose(fp);
+          return NULL;
+     }
+     code = ln_alloc(size + 1);
+     rewind(fp);
+     ck_assert_int_eq(fread(code, 1, size, fp), size);
+     code[size] = '\0';
+     fclose(fp);
+
+     return code;
+}
+
+START_TEST(test_ln_compile_code)
+{
+     ln_list *ops, *inputs;
+     char *code;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     inputs = ln_list_append(NULL, "create1");
+     code = compile(ops, inputs, NULL);
+     ln_error_handle(&error);
+
+     /* the unread tensors are the outputs */
+     ck_assert_ptr_ne(strstr(code, " *   0: \"create1\", TL_FLOAT [2, 4], 32 bytes\n"), NULL);
+     ck_assert_ptr_ne(strstr(code, " *   0: \"transpose1\", TL_FLOAT [2, 1], 8 bytes\n"), NULL);
+     ck_assert_ptr_ne(strstr(code, " *   1: \"zeros1\", TL_FLOAT [2, 4], 32 bytes\n"), NULL);
+
+     /* constants are static data, the rest are in the planned arena */
+     ck_assert_ptr_ne(strstr(code, "d_1 = {{\n     0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x80, 0x3f,"), NULL);
+     ck_assert_ptr_ne(strstr(code, "} arena;\n"), NULL);
+     ck_assert_ptr_ne(strstr(code, ".data = arena.bytes + "), NULL);
+
+     /* straight-line kernel calls, the input read in place */
+     ck_assert_ptr_ne(strstr(code, "void net_run(const void *const *inputs, void *const *outputs)\n{\n"
+                             "     t_0.data = (void *)inputs[0];\n"
+                             "     tl_tensor_elew(&t_0, &t_1, &t_2, TL_MUL);\n"
+                             "     tl_tensor_slice(&t_2, &t_3, 1, 1, 3);\n"
+                             "     tl_tensor_maxreduce(&t_4, &t_5, &t_6, 0);\n"
+                             "     tl_tensor_elew(&t_5, &t_6, &t_7, TL_MUL);\n"
+                             "     tl_tensor_transpose(&t_7, &t_8, (int[]){1, 0}, &t_10);\n"
+                             "     memset((&t_9)->data, 0, 32);\n"
+                             "     memcpy(outputs[0], arena.bytes + "), NULL);
+     ck_assert_ptr_eq(strstr(code, "ln_"), NULL);
+
+     ln_free(code);
+     ln_list_free(inputs);
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
+
+START_TEST(test_ln_compile_errors)
+{
+     ln_list *ops, *names;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     names = ln_list_append(NULL, "nonexistent");
+     ck_assert_ptr_eq(compile(ops, NULL, names), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     /* an input should be constant data the run function can replace */
+     names->data = "mul1";
+     ck_assert_ptr_eq(compile(ops, names, NULL), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     /* every op computing something needs an emit function */
+     ln_op_list_find_by_name(ops, "slice1")->emit = NULL;
+     ck_assert_ptr_eq(compile(ops, NULL, NULL), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     ln_list_free(names);
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_compile_suite(void)
+{
+     Suite *s;
+     TCase *tc_compile;
+
+     s = suite_create("compile");
+     tc_compile = tcase_create("compile");
+     tcase_add_checked_fixture(tc_compile, setup, teardown);
+
+     tcase_add_test(tc_compile, test_ln_compile_code);
+     tcase_add_test(tc_compile, test_ln_compile_errors);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_compile);
+
+     return s;
+}
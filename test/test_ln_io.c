@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_lightnet.h"
+#include "../src/ln_io.h"
+#include "../src/ln_parse.h"
+#include "../src/ln_optimize.h"
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_list *ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_io.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+}
+
+static void teardown(void)
+{
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+     ln_list_free(registered_ops);
+}
+
+/* create io on ops, expecting an error from it */
+static void assert_create_error(const char *input, const char *output)
+{
+     ln_list *inputs, *outputs;
+
+     inputs = input ? ln_list_append(NULL, (void *)input) : NULL;
+     outputs = output ? ln_list_append(NULL, (void *)output) : NULL;
+     ck_assert_ptr_eq(ln_io_create(ops, inputs, outputs, &error), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_list_free(inputs);
+     ln_list_free(outputs);
+}
+
+START_TEST(test_ln_io_run)
+{
+     float x[8] = {1, 1, 1, 1, 2, 2, 2, 2};
+     float mul[8], reshape[8], transpose[8];
+     float mul_true[8] = {2, 1, 2, 1, 4, 2, 4, 2};
+     float transpose_true[8] = {2, 2, 4, 4, 1, 1, 2, 2};
+     ln_list *inputs, *outputs;
+     void *own_data;
+     ln_io *io;
+     int i;
+
+     inputs = ln_list_append(NULL, "create1");
+     outputs = ln_list_append(NULL, "mul1");
+     outputs = ln_list_append(outputs, "reshape1");
+     outputs = ln_list_append(outputs, "transpose1");
+     io = ln_io_create(ops, inputs, outputs, &error);
+     ln_error_handle(&error);
+     ln_list_free(inputs);
+     ln_list_free(outputs);
+
+     ck_assert_int_eq(ln_io_find_input(io, "create1")->ndim, 2);
+     ck_assert_ptr_eq(ln_io_find_input(io, "mul1"), NULL);
+     ck_assert_int_eq(ln_io_find_output(io, "transpose1")->dims[0], 2);
+
+     /* the view is copied out, the rest are written in place */
+     ck_assert_int_eq(ln_io_output_is_direct(io, "mul1"), 1);
+     ck_assert_int_eq(ln_io_output_is_direct(io, "reshape1"), 0);
+     ck_assert_int_eq(ln_io_output_is_direct(io, "transpose1"), 1);
+
+     ln_io_bind_input(io, "create1", x, sizeof(x), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "mul1", mul, sizeof(mul), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "reshape1", reshape, sizeof(reshape), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "transpose1", transpose, sizeof(transpose),
+                       &error);
+     ln_error_handle(&error);
+
+     own_data = ln_io_find_input(io, "create1")->data;
+     ln_io_run(io, &error);
+     ln_error_handle(&error);
+     ck_assert_array_float_eq_tol(mul, mul_true, 8, 0);
+     ck_assert_array_float_eq_tol(reshape, mul_true, 8, 0);
+     ck_assert_array_float_eq_tol(transpose, transpose_true, 8, 0);
+
+     /* tensors get their own data back after running */
+     ck_assert_ptr_eq(ln_io_find_input(io, "create1")->data, own_data);
+     ck_assert_ptr_ne(ln_io_find_output(io, "mul1")->data, mul);
+
+     /* a changed input is read in place */
+     for (i = 0; i < 8; i++)
+          x[i] = i + 1;
+     ln_io_run(io, &error);
+     ln_error_handle(&error);
+     ck_assert_float_eq(mul[1], 2);
+     ck_assert_float_eq(transpose[1], 6);
+
+     /* an unbound input reads the data of its create op */
+     ln_io_bind_input(io, "create1", NULL, 0, &error);
+     ln_error_handle(&error);
+     memset(mul, 0, sizeof(mul));
+     ln_io_run(io, &error);
+     ln_error_handle(&error);
+     ck_assert_float_eq(mul[7], 8);
+
+     ln_io_free(io);
+}
+END_TEST
+
+START_TEST(test_ln_io_run_outputs)
+{
+     float mul[8], transpose[8];
+     float mul_true[8] = {2, 2, 6, 4, 10, 6, 14, 8};
+     ln_list *outputs, *names;
+     ln_io *io;
+     int i;
+
+     outputs = ln_list_append(NULL, "mul1");
+     outputs = ln_list_append(outputs, "transpose1");
+     io = ln_io_create(ops, NULL, outputs, &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "mul1", mul, sizeof(mul), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "transpose1", transpose, sizeof(transpose),
+                       &error);
+     ln_error_handle(&error);
+
+     /* the transpose isn't run for the product only, twice */
+     names = ln_list_append(NULL, "mul1");
+     for (i = 0; i < 2; i++) {
+          memset(mul, 0, sizeof(mul));
+          memset(transpose, 0, sizeof(transpose));
+          ln_io_run_outputs(io, names, &error);
+          ln_error_handle(&error);
+          ck_assert_array_float_eq_tol(mul, mul_true, 8, 0);
+          ck_assert_float_eq(transpose[1], 0);
+     }
+     ck_assert_float_eq(((float *)ln_io_find_output(io, "transpose1")->data)[1], 0);
+
+     names->data = "transpose1";
+     ln_io_run_outputs(io, names, &error);
+     ln_error_handle(&error);
+     ck_assert_float_eq(transpose[1], 6);
+     ck_assert_float_eq(mul[0], 2);
+     ck_assert_int_eq(ln_io_n_subsets(io), 2);
+
+     names->data = "create2";
+     ln_io_run_outputs(io, names, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_list_free(names);
+
+     /* the same set in another order, or with repeats, reuses its ops */
+     names = ln_list_append(NULL, "mul1");
+     names = ln_list_append(names, "transpose1");
+     ln_io_run_outputs(io, names, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(ln_io_n_subsets(io), 3);
+     ln_list_free(names);
+     names = ln_list_append(NULL, "transpose1");
+     names = ln_list_append(names, "mul1");
+     names = ln_list_append(names, "transpose1");
+     memset(mul, 0, sizeof(mul));
+     memset(transpose, 0, sizeof(transpose));
+     ln_io_run_outputs(io, names, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(ln_io_n_subsets(io), 3);
+     ck_assert_array_float_eq_tol(mul, mul_true, 8, 0);
+     ck_assert_float_eq(transpose[1], 6);
+
+     ln_list_free(names);
+     ln_list_free(outputs);
+     ln_io_free(io);
+}
+END_TEST
+
+struct ready_log {
+     int    n_calls;
+     char   names[4][16];
+     float  first;              /* data[0] of the output */
+     float *transpose;          /* the buffer of "transpose1" */
+     float  transpose1;         /* transpose[1] when called */
+};
+
+static void log_ready(const char *name, const tl_tensor *tensor, void *data,
+                      void *user_data)
+{
+     struct ready_log *log = user_data;
+
+     ck_assert_int_eq(tensor->len, 8);
+     snprintf(log->names[log->n_calls], 16, "%s", name);
+     log->first = ((float *)data)[0];
+     log->transpose1 = log->transpose[1];
+     log->n_calls++;
+}
+
+START_TEST(test_ln_io_ready)
+{
+     float mul[8], reshape[8], transpose[8];
+     struct ready_log log;
+     ln_list *outputs;
+     ln_io *io;
+
+     outputs = ln_list_append(NULL, "transpose1");
+     outputs = ln_list_append(outputs, "reshape1");
+     outputs = ln_list_append(outputs, "mul1");
+     io = ln_io_create(ops, NULL, outputs, &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "mul1", mul, sizeof(mul), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "reshape1", reshape, sizeof(reshape), &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(io, "transpose1", transpose, sizeof(transpose),
+                       &error);
+     ln_error_handle(&error);
+
+     memset(&log, 0, sizeof(log));
+     log.transpose = transpose;
+     memset(transpose, 0, sizeof(transpose));
+     ln_io_set_ready_func(io, "mul1", log_ready, &log, &error);
+     ln_error_handle(&error);
+     ln_io_set_ready_func(io, "reshape1", log_ready, &log, &error);
+     ln_error_handle(&error);
+     ln_io_set_ready_func(io, "nonexistent", log_ready, &log, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     /* in the order of the ops, before the rest of the ops run */
+     ln_io_run(io, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(log.n_calls, 2);
+     ck_assert_str_eq(log.names[0], "mul1");
+     ck_assert_str_eq(log.names[1], "reshape1");
+     ck_assert_float_eq(log.first, 2);
+     ck_assert_float_eq(log.transpose1, 0);
+     ck_assert_float_eq(transpose[1], 6);
+
+     ln_io_set_ready_func(io, "mul1", NULL, NULL, &error);
+     ln_error_handle(&error);
+     ln_io_run(io, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(log.n_calls, 3);
+
+     ln_list_free(outputs);
+     ln_io_free(io);
+}
+END_TEST
+
+START_TEST(test_ln_io_errors)
+{
+     float buf[9];
+     ln_list *names;
+     ln_io *io;
+
+     assert_create_error("nonexistent", NULL);
+     assert_create_error(NULL, "nonexistent");
+     /* an input should be constant data that ops read at run time */
+     assert_create_error("mul1", NULL);
+     assert_create_error("reshape1", NULL);
+
+     names = ln_list_append(NULL, "create1");
+     io = ln_io_create(ops, names, names, &error);
+     ln_error_handle(&error);
+
+     ln_io_bind_input(io, "mul1", buf, sizeof(float) * 8, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     ln_io_bind_input(io, "create1", buf, sizeof(buf), &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     ln_io_bind_output(io, "create1", (char *)buf + 1, sizeof(float) * 8,
+                       &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_io_free(io);
+
+     /* folded readers took the input as a constant */
+     ops = ln_optimize_fold(ops, &error);
+     ln_error_handle(&error);
+     assert_create_error("create1", NULL);
+     ln_list_free(names);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_io_suite(void)
+{
+     Suite *s;
+     TCase *tc_io;
+
+     s = suite_create("io");
+     tc_io = tcase_create("io");
+     tcase_add_checked_fixture(tc_io, setup, teardown);
+
+     tcase_add_test(tc_io, test_ln_io_run);
+     tcase_add_test(tc_io, test_ln_io_run_outputs);
+     tcase_add_test(tc_io, test_ln_io_ready);
+     tcase_add_test(tc_io, test_ln_io_errors);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_io);
+
+     return s;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <unistd.h>
+#include "test_lightnet.h"
+#include "../src/ln_jit.h"
+
+#define LEN 37                  /* not a multiple of LN_JIT_WIDTH */
+
+static float src0[LEN], src1[LEN], src2[LEN];
+static const float *srcs[] = {src0, src1, src2};
+static float dst[LEN];
+static float *work;
+
+static void setup(void)
+{
+     int i;
+
+     for (i = 0; i < LEN; i++) {
+          src0[i] = i - 18;
+          src1[i] = 0.5f * i;
+          src2[i] = i % 5 + 1;
+     }
+     work = ln_alloc(sizeof(float) * LN_JIT_BLOCK * 8);
+     ln_jit_set_enabled(1);
+}
+
+static void teardown(void)
+{
+     ln_free(work);
+     ln_jit_cleanup();
+}
+
+/* max(src0 * src1 + src2, src0) / src2 - min(src1, src0) */
+static ln_jit_node nodes[] = {
+     {TL_MUL, 0, 1},
+     {TL_SUM, 3, 2},
+     {TL_MAX, 4, 0},
+     {TL_DIV, 5, 2},
+     {TL_MIN, 1, 0},
+     {TL_SUB, 6, 7},
+};
+static ln_jit_prog prog = {3, 6, nodes};
+
+static float expected(int i)
+{
+     float a, b;
+
+     a = src0[i] * src1[i] + src2[i];
+     a = a > src0[i] ? a : src0[i];
+     b = src1[i] < src0[i] ? src1[i] : src0[i];
+     return a / src2[i] - b;
+}
+
+START_TEST(test_ln_jit_run)
+{
+     ln_jit_func func;
+     int i;
+
+     func = ln_jit_compile(&prog, "test_run");
+     if (ln_jit_is_available())
+          ck_assert_ptr_ne(func, NULL);
+     ln_jit_run(&prog, func, srcs, dst, LEN, work);
+     for (i = 0; i < LEN; i++)
+          ck_assert(fabsf(dst[i] - expected(i)) < 1e-5);
+
+     /* dst may be the first source */
+     memcpy(dst, src0, sizeof(src0));
+     srcs[0] = dst;
+     ln_jit_run(&prog, func, srcs, dst, LEN, work);
+     srcs[0] = src0;
+     for (i = 0; i < LEN; i++)
+          ck_assert(fabsf(dst[i] - expected(i)) < 1e-5);
+
+     ln_jit_interpret(&prog, srcs, dst, 0, LEN, work);
+     for (i = 0; i < LEN; i++)
+          ck_assert(fabsf(dst[i] - expected(i)) < 1e-5);
+}
+END_TEST
+
+START_TEST(test_ln_jit_cache)
+{
+     ln_jit_func func1, func2, func3;
+     char path[64], line[256];
+     int found;
+     FILE *fp;
+
+     if (!ln_jit_is_available())
+          return;
+     func1 = ln_jit_compile(&prog, "test_cache");
+     func2 = ln_jit_compile(&prog, "test_cache");
+     func3 = ln_jit_compile(&prog, "test_cache_other");
+     ck_assert_ptr_ne(func1, NULL);
+     ck_assert_ptr_eq(func1, func2);
+     ck_assert(func1 != func3);
+
+     snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+     fp = fopen(path, "r");
+     ck_assert_ptr_ne(fp, NULL);
+     found = 0;
+     while (fgets(line, sizeof(line), fp)) {
+          if (strstr(line, " ln_jit:test_cache\n"))
+               found = 1;
+     }
+     fclose(fp);
+     ck_assert_int_eq(found, 1);
+
+     ln_jit_set_enabled(0);
+     ck_assert_int_eq(ln_jit_is_available(), 0);
+     ck_assert_ptr_eq(ln_jit_compile(&prog, "test_cache"), NULL);
+}
+END_TEST
+
+START_TEST(test_ln_jit_fallback)
+{
+     ln_jit_node pow_nodes[] = {{TL_POW, 2, 1}, {TL_SUM, 3, 0}};
+     ln_jit_prog pow_prog = {3, 2, pow_nodes};
+     ln_jit_func func;
+     int i;
+
+     /* no vector instruction for TL_POW, so it's interpreted */
+     func = ln_jit_compile(&pow_prog, "test_fallback");
+     ck_assert_ptr_eq(func, NULL);
+     ln_jit_run(&pow_prog, func, srcs, dst, LEN, work);
+     for (i = 0; i < LEN; i++)
+          ck_assert(fabsf(dst[i] - (powf(src2[i], src1[i]) + src0[i]))
+                    <= 1e-5 * fabsf(dst[i]) + 1e-5);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_jit_suite(void)
+{
+     Suite *s;
+     TCase *tc_jit;
+
+     s = suite_create("jit");
+     tc_jit = tcase_create("jit");
+     tcase_add_checked_fixture(tc_jit, setup, teardown);
+
+     tcase_add_test(tc_jit, test_ln_jit_run);
+     tcase_add_test(tc_jit, test_ln_jit_cache);
+     tcase_add_test(tc_jit, test_ln_jit_fallback);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_jit);
+
+     return s;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_lightnet.h"
+#include "../src/ln_kernel.h"
+
+static void setup(void)
+{
+}
+
+static void teardown(void)
+{
+}
+
+/* a tensor of dtype with elements (i * 7) % 11, with repeated maxima */
+static tl_tensor *create_tensor(int ndim, const int *dims, tl_dtype dtype)
+{
+     tl_tensor *t;
+     double v;
+     int i;
+
+     t = tl_tensor_zeros(ndim, dims, dtype);
+     for (i = 0; i < t->len; i++) {
+          v = (i * 7) % 11;
+          tl_convert((char *)t->data + i * tl_size_of(dtype), dtype,
+                     &v, TL_DOUBLE);
+     }
+     return t;
+}
+
+START_TEST(test_ln_kernel_transpose_plan)
+{
+     ln_kernel_transpose kt;
+     tl_tensor *t;
+
+     /* the identity is one contiguous copy */
+     t = tl_tensor_zeros(3, (int[]){2, 3, 4}, TL_FLOAT);
+     ck_assert_int_eq(ln_kernel_transpose_plan(&kt, t, (int[]){0, 1, 2}), 1);
+     ck_assert_int_eq(kt.ndim, 1);
+     ck_assert_int_eq(kt.dims[0], 24);
+     ck_assert_ptr_eq(kt.func, ln_kernel_transpose_table[2][0][1]);
+
+     /* the last axis stays, so rows are copied contiguously */
+     ck_assert_int_eq(ln_kernel_transpose_plan(&kt, t, (int[]){1, 0, 2}), 1);
+     ck_assert_int_eq(kt.ndim, 3);
+     ck_assert_ptr_eq(kt.func, ln_kernel_transpose_table[2][2][1]);
+
+     /* axes 0 and 1 stay adjacent and are merged */
+     ck_assert_int_eq(ln_kernel_transpose_plan(&kt, t, (int[]){2, 0, 1}), 1);
+     ck_assert_int_eq(kt.ndim, 2);
+     ck_assert_int_eq(kt.dims[0], 4);
+     ck_assert_int_eq(kt.dims[1], 6);
+     ck_assert_int_eq(kt.strides[0], 1);
+     ck_assert_int_eq(kt.strides[1], 4);
+     ck_assert_ptr_eq(kt.func, ln_kernel_transpose_table[2][1][0]);
+     tl_tensor_free_data_too(t);
+
+     /* dims of 1 are dropped */
+     t = tl_tensor_zeros(3, (int[]){1, 5, 1}, TL_DOUBLE);
+     ck_assert_int_eq(ln_kernel_transpose_plan(&kt, t, (int[]){2, 1, 0}), 1);
+     ck_assert_int_eq(kt.ndim, 1);
+     ck_assert_ptr_eq(kt.func, ln_kernel_transpose_table[3][0][1]);
+     tl_tensor_free_data_too(t);
+
+     /* no kernel of rank 7 */
+     t = tl_tensor_zeros(7, (int[]){2, 2, 2, 2, 2, 2, 2}, TL_INT8);
+     ck_assert_int_eq(ln_kernel_transpose_plan(&kt, t,
+                                               (int[]){6, 5, 4, 3, 2, 1, 0}),
+                      0);
+     ck_assert_ptr_eq(kt.func, NULL);
+     tl_tensor_free_data_too(t);
+}
+END_TEST
+
+START_TEST(test_ln_kernel_transpose)
+{
+     tl_dtype dtypes[] = {TL_UINT8, TL_INT16, TL_FLOAT, TL_DOUBLE};
+     struct {
+          int ndim;
+          int dims[7];
+          int axes[7];
+     } cases[] = {
+          {1, {7}, {0}},
+          {2, {3, 5}, {1, 0}},
+          {3, {2, 3, 4}, {2, 0, 1}},
+          {3, {2, 3, 4}, {1, 0, 2}},
+          {5, {2, 1, 3, 2, 2}, {4, 2, 0, 3, 1}},
+          {6, {2, 2, 3, 2, 2, 2}, {5, 3, 1, 4, 2, 0}},
+          {7, {2, 3, 2, 2, 3, 2, 2}, {6, 0, 5, 1, 4, 2, 3}},
+     };
+     tl_tensor *src, *dst, *expected, *workspace;
+     ln_kernel_transpose kt;
+     int dims[7];
+     int i, j, k;
+
+     for (i = 0; i < sizeof(dtypes) / sizeof(dtypes[0]); i++) {
+          for (j = 0; j < sizeof(cases) / sizeof(cases[0]); j++) {
+               src = create_tensor(cases[j].ndim, cases[j].dims, dtypes[i]);
+               for (k = 0; k < cases[j].ndim; k++)
+                    dims[k] = cases[j].dims[cases[j].axes[k]];
+               dst = tl_tensor_zeros(cases[j].ndim, dims, dtypes[i]);
+               expected = tl_tensor_zeros(cases[j].ndim, dims, dtypes[i]);
+               workspace = tl_tensor_zeros(1, (int[]){cases[j].ndim * src->len * 2},
+                                           TL_INT32);
+               tl_tensor_transpose(src, expected, cases[j].axes, workspace);
+
+               if (!ln_kernel_transpose_plan(&kt, src, cases[j].axes)) {
+                    ck_assert_int_eq(cases[j].ndim, 7);
+               } else {
+                    ln_kernel_transpose_run(&kt, src, dst);
+                    ck_assert_int_eq(memcmp(dst->data, expected->data,
+                                            src->len * tl_size_of(dtypes[i])),
+                                     0);
+               }
+               tl_tensor_free_data_too(src);
+               tl_tensor_free_data_too(dst);
+               tl_tensor_free_data_too(expected);
+               tl_tensor_free_data_too(workspace);
+          }
+     }
+}
+END_TEST
+
+START_TEST(test_ln_kernel_maxreduce)
+{
+     tl_dtype dtypes[] = {TL_DOUBLE, TL_FLOAT, TL_INT32, TL_INT16, TL_INT8,
+                          TL_UINT32, TL_UINT16, TL_UINT8};
+     int dims[] = {3, 4, 5};
+     tl_tensor *src, *dst, *arg, *expected, *expected_arg;
+     ln_kernel_maxreduce_func func;
+     int i, axis, with_arg, outer, inner;
+     size_t size;
+
+     for (i = 0; i < sizeof(dtypes) / sizeof(dtypes[0]); i++) {
+          src = create_tensor(3, dims, dtypes[i]);
+          size = tl_size_of(dtypes[i]);
+          for (axis = 0; axis < 3; axis++) {
+               outer = axis == 0 ? 1 : axis == 1 ? 3 : 12;
+               inner = axis == 0 ? 20 : axis == 1 ? 5 : 1;
+               expected = tl_tensor_create_slice(src, axis, 1, dtypes[i]);
+               expected_arg = tl_tensor_create_slice(src, axis, 1, dtypes[i]);
+               tl_tensor_maxreduce(src, expected, expected_arg, axis);
+               for (with_arg = 0; with_arg <= 1; with_arg++) {
+                    func = ln_kernel_maxreduce_find(dtypes[i], inner == 1,
+                                                    with_arg);
+                    ck_assert_ptr_ne(func, NULL);
+                    dst = tl_tensor_create_slice(src, axis, 1, dtypes[i]);
+                    arg = tl_tensor_create_slice(src, axis, 1, dtypes[i]);
+                    func(src->data, dst->data, with_arg ? arg->data : NULL,
+                         outer, dims[axis], inner);
+                    ck_assert_int_eq(memcmp(dst->data, expected->data,
+                                            dst->len * size), 0);
+                    if (with_arg)
+                         ck_assert_int_eq(memcmp(arg->data, expected_arg->data,
+                                                 arg->len * size), 0);
+                    tl_tensor_free_data_too(dst);
+                    tl_tensor_free_data_too(arg);
+               }
+               tl_tensor_free_data_too(expected);
+               tl_tensor_free_data_too(expected_arg);
+          }
+          tl_tensor_free_data_too(src);
+     }
+     ck_assert_ptr_eq(ln_kernel_maxreduce_find(TL_BOOL, 1, 0), NULL);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_kernel_suite(void)
+{
+     Suite *s;
+     TCase *tc_kernel;
+
+     s = suite_create("kernel");
+     tc_kernel = tcase_create("kernel");
+     tcase_add_checked_fixture(tc_kernel, setup, teardown);
+
+     tcase_add_test(tc_kernel, test_ln_kernel_transpose_plan);
+     tcase_add_test(tc_kernel, test_ln_kernel_transpose);
+     tcase_add_test(tc_kernel, test_ln_kernel_maxreduce);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_kernel);
+
+     return s;
+}
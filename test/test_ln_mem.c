@@ -20,6 +20,8 @@
  * SOFTWARE.
  */
 
+#include <string.h>
+#include <sys/stat.h>
 #include "test_lightnet.h"
 #include "../src/ln_mem.h"
 
@@ -38,11 +40,54 @@ START_TEST(test_ln_mem_pool_create)
      mem_pool = ln_mem_pool_create(4096, 1);
      ck_assert_int_eq(mem_pool->size, 4096);
      ck_assert_int_eq(mem_pool->align_size, 1);
+     ck_assert_int_eq(mem_pool->peak, 0);
      ck_assert_ptr_ne(mem_pool->mem_blocks, NULL);
      ln_mem_pool_free(mem_pool);
 }
 END_TEST
 
+START_TEST(test_ln_mem_pool_create_mmap)
+{
+     ln_mem_pool *mem_pool;
+     struct stat buf;
+     size_t addr;
+
+     mem_pool = ln_mem_pool_create_mmap(1 << 20, 8, "test_ln_mem.mmap");
+     ck_assert_int_eq(mem_pool->size, 1 << 20);
+     ck_assert_ptr_ne(mem_pool->base, NULL);
+     ck_assert_int_ge(mem_pool->fd, 0);
+     /* the file is gone once mapped */
+     ck_assert_int_lt(stat("test_ln_mem.mmap", &buf), 0);
+
+     addr = ln_mem_alloc(mem_pool, 4096);
+     ln_mem_prefetch(mem_pool, addr, 4096);
+     memset((char *)mem_pool->base + addr, 1, 4096);
+     ln_mem_release(mem_pool, addr, 4096);
+     /* released pages are read back from the file */
+     ck_assert_int_eq(((char *)mem_pool->base)[addr + 4095], 1);
+     ln_mem_pool_free(mem_pool);
+}
+END_TEST
+
+START_TEST(test_ln_mem_pool_create_arena)
+{
+     ln_mem_pool *mem_pool;
+     size_t addr;
+
+     mem_pool = ln_mem_pool_create_arena(1 << 20, 8);
+     ck_assert_int_eq(mem_pool->size, 1 << 20);
+     ck_assert_ptr_ne(mem_pool->base, NULL);
+     ck_assert_int_lt(mem_pool->fd, 0);
+
+     addr = ln_mem_alloc(mem_pool, 4096);
+     memset((char *)mem_pool->base + addr, 1, 4096);
+     /* releasing is a no-op without a file to page to */
+     ln_mem_release(mem_pool, addr, 4096);
+     ck_assert_int_eq(((char *)mem_pool->base)[addr + 4095], 1);
+     ln_mem_pool_free(mem_pool);
+}
+END_TEST
+
 START_TEST(test_ln_mem_pool_free)
 {
 }
@@ -76,6 +121,7 @@ START_TEST(test_ln_mem_alloc)
      ln_mem_free(mem_pool, addr6);
      addr8 = ln_mem_alloc(mem_pool, 5);
      ck_assert_int_eq(addr8, 19);
+     ck_assert_int_eq(mem_pool->peak, 30);
      ln_mem_pool_free(mem_pool);
 
      mem_pool = ln_mem_pool_create(4096, 8);
@@ -99,6 +145,7 @@ START_TEST(test_ln_mem_alloc)
      ln_mem_free(mem_pool, addr6);
      addr8 = ln_mem_alloc(mem_pool, 16);
      ck_assert_int_eq(addr8, 32);
+     ck_assert_int_eq(mem_pool->peak, 54);
      ln_mem_pool_free(mem_pool);
 }
 END_TEST
@@ -119,6 +166,8 @@ Suite *make_mem_suite(void)
      tcase_add_checked_fixture(tc_mem, setup, teardown);
 
      tcase_add_test(tc_mem, test_ln_mem_pool_create);
+     tcase_add_test(tc_mem, test_ln_mem_pool_create_mmap);
+     tcase_add_test(tc_mem, test_ln_mem_pool_create_arena);
      tcase_add_test(tc_mem, test_ln_mem_pool_free);
      tcase_add_test(tc_mem, test_ln_mem_alloc);
      tcase_add_test(tc_mem, test_ln_mem_free);
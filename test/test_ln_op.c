@@ -280,6 +280,56 @@ START_TEST(test_ln_op_list_do_run)
 }
 END_TEST
 
+static void cost(ln_op_arg *op_arg, ln_op_cost *cost)
+{
+     cost->flops = 1;
+     cost->bytes_read = 2;
+     cost->bytes_written = 3;
+}
+
+START_TEST(test_ln_op_get_cost)
+{
+     ln_op *op;
+     ln_op_cost op_cost;
+
+     op = ln_op_create("test_name", "test_optype", NULL, NULL, NULL,
+                       pre_run, run, post_run);
+     ck_assert_ptr_eq(op->cost, NULL);
+     op_cost.flops = 4;
+     ln_op_get_cost(op, &op_cost);
+     ck_assert_uint_eq(op_cost.flops, 0);
+     ck_assert_uint_eq(op_cost.bytes_read, 0);
+     ck_assert_uint_eq(op_cost.bytes_written, 0);
+
+     op->cost = cost;
+     ln_op_get_cost(op, &op_cost);
+     ck_assert_uint_eq(op_cost.flops, 1);
+     ck_assert_uint_eq(op_cost.bytes_read, 2);
+     ck_assert_uint_eq(op_cost.bytes_written, 3);
+     ln_op_free(op);
+}
+END_TEST
+
+START_TEST(test_ln_op_copy_impl)
+{
+     ln_op *op, *proto;
+     ln_op_variant variants[] = {{"test_variant", run}, {NULL, NULL}};
+
+     proto = ln_op_create("proto_name", "test_optype", NULL, NULL, NULL,
+                          pre_run, run, post_run);
+     proto->cost = cost;
+     proto->variants = variants;
+     op = ln_op_create("test_name", "test_optype", NULL, NULL, NULL,
+                       pre_run, run, post_run);
+     ln_op_copy_impl(op, proto);
+     ck_assert_ptr_eq(op->cost, cost);
+     ck_assert_ptr_eq(op->variants, variants);
+     ck_assert_ptr_eq(op->emit, NULL);
+     ln_op_free(op);
+     ln_op_free(proto);
+}
+END_TEST
+
 START_TEST(test_ln_op_list_do_post_run)
 {
 }
@@ -302,6 +352,8 @@ Suite *make_op_suite(void)
      tcase_add_test(tc_op, test_ln_op_list_find_by_optype);
      tcase_add_test(tc_op, test_ln_op_list_do_pre_run);
      tcase_add_test(tc_op, test_ln_op_list_do_run);
+     tcase_add_test(tc_op, test_ln_op_get_cost);
+     tcase_add_test(tc_op, test_ln_op_copy_impl);
      tcase_add_test(tc_op, test_ln_op_list_do_post_run);
      /* end of adding tests */
 
@@ -22,20 +22,62 @@
 
 #include "test_lightnet.h"
 #include "../src/ln_optimize.h"
+#include "../src/ln_parse.h"
+
+static ln_list *registered_ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
 
 static void setup(void)
 {
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
 }
 
 static void teardown(void)
 {
+     ln_list_free(registered_ops);
+}
+
+static size_t tensor_offset(ln_list *ops, char *name)
+{
+     ln_op *op;
+     ln_tensor_entry *te;
+
+     LN_LIST_FOREACH(op, ops) {
+          te = ln_tensor_table_find_by_name(op->op_arg->tensors_out, name);
+          if (te)
+               return te->offset;
+     }
+     ck_abort_msg("tensor %s not found", name);
+     return 0;
+}
+
+/* the bytes of tensor data held outside of pools, as pre_run allocated it */
+static size_t heap_bytes(ln_list *ops)
+{
+     ln_op *op;
+     ln_tensor_entry *te;
+     size_t bytes = 0;
+
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               if (!te->owner && te->tensor && te->tensor->data)
+                    bytes += tl_tensor_size(te->tensor);
+          }
+     }
+     return bytes;
 }
 
 START_TEST(test_ln_optimize_mem)
 {
      ln_hash *mem_pools;
      ln_mem_pool *mp_cpu, *mp_cuda;
+     ln_list *ops;
+     ln_tensor_entry *te;
+     char *json_str;
 
+     json_str = read_json("test_ln_optimize.json");
      mp_cpu = ln_mem_pool_create(4096, 1);
      mp_cuda = ln_mem_pool_create(4096, 1);
      mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp,
@@ -43,7 +85,823 @@ START_TEST(test_ln_optimize_mem)
      ln_hash_insert(mem_pools, (void *)LN_MEM_CPU, mp_cpu);
      ln_hash_insert(mem_pools, (void *)LN_MEM_CUDA, mp_cuda);
 
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_mem(ops, mem_pools);
+
+     ck_assert_int_eq(tensor_offset(ops, "zeros1"), 0);
+     ck_assert_int_eq(tensor_offset(ops, "zeros2"), 32);
+     /* "zeros2" is still used by elew2, so elew1 can't be in-place */
+     ck_assert_int_eq(tensor_offset(ops, "elew1"), 64);
+     /* elew2 is the last user of "elew1" */
+     ck_assert_int_eq(tensor_offset(ops, "elew2"), 64);
+     /* a view shares its owner's memory */
+     ck_assert_int_eq(tensor_offset(ops, "reshape1"), 64);
+     /* "reshape1" keeps "elew2" alive, so elew3 can't be in-place */
+     ck_assert_int_eq(tensor_offset(ops, "elew3"), 0);
+     ck_assert_int_eq(tensor_offset(ops, "transpose1"), 0);
+     te = ln_tensor_table_find_by_name(ln_op_list_find_by_name(ops, "elew2")->op_arg->tensors_in,
+                                       "elew1");
+     ck_assert_int_eq(te->offset, 64);
+     ck_assert_int_eq(ln_mem_exist(mp_cpu, 0), 0);
+     ck_assert_int_eq(ln_mem_exist(mp_cpu, 64), 0);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_hash_free(mem_pools);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_order)
+{
+     ln_list *ops;
+     ln_op *op;
+     size_t before, after;
+     char *json_str;
+     char *names[] = {"zeros1", "maxreduce1", "zeros2", "maxreduce2", "elew1"};
+     int i;
+
+     json_str = read_json("test_ln_optimize_order.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     ck_assert_int_eq(ln_optimize_peak_mem(ops), 1000);
+     ops = ln_optimize_order(ops, &before, &after);
+     ck_assert_int_eq(before, 1000);
+     ck_assert_int_eq(after, 800);
+     ck_assert_int_eq(ln_optimize_peak_mem(ops), 800);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     ck_assert_int_eq(i, 5);
+
+     /* already optimal, order is kept */
+     ops = ln_optimize_order(ops, &before, &after);
+     ck_assert_int_eq(before, 800);
+     ck_assert_int_eq(after, 800);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_remat)
+{
+     ln_hash *mem_pools;
+     ln_mem_pool *mp_cpu;
+     ln_list *ops;
+     ln_op *op;
+     size_t extra_bytes;
+     char *json_str;
+     int n_extra_ops;
+
+     json_str = read_json("test_ln_optimize_remat.json");
+     mp_cpu = ln_mem_pool_create(1300, 1);
+     mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_CPU, mp_cpu);
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(ln_optimize_peak_mem(ops), 1600);
+     ops = ln_optimize_remat(ops, mem_pools, &n_extra_ops, &extra_bytes);
+     ck_assert_int_eq(n_extra_ops, 1);
+     ck_assert_int_eq(extra_bytes, 400);
+     ck_assert_int_eq(ln_list_length(ops), 8);
+     /* the two definitions of "elew1" are counted apart */
+     ck_assert_int_eq(ln_optimize_peak_mem(ops), 1600);
+     /* "elew1" is dropped after maxreduce1 and recomputed for elew2 */
+     op = ln_list_nth_data(ops, 5);
+     ck_assert_str_eq(op->op_arg->name, "elew1_remat0");
+     ck_assert_str_eq(op->op_arg->optype, "elew");
+
+     ops = ln_optimize_mem(ops, mem_pools);
+     ck_assert_int_eq(mp_cpu->peak, 1200);
+     ck_assert_int_eq(tensor_offset(ops, "elew2"), 400);
+
+     /* already fits */
+     ops = ln_optimize_remat(ops, mem_pools, &n_extra_ops, &extra_bytes);
+     ck_assert_int_eq(n_extra_ops, 0);
+     ck_assert_int_eq(extra_bytes, 0);
+     ck_assert_int_eq(ln_list_length(ops), 8);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_mem_pool_free(mp_cpu);
+     ln_hash_free(mem_pools);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_spill)
+{
+     ln_hash *mem_pools;
+     ln_mem_pool *mp_cpu, *mp_mmap;
+     ln_list *ops;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     float expected[] = {6, 20, 42, 72, 110, 156, 210, 272};
+     int n_spilled, i;
+
+     json_str = read_json("test_ln_optimize_spill.json");
+     mp_cpu = ln_mem_pool_create_arena(100, 1);
+     mp_mmap = ln_mem_pool_create_mmap(4096, 1, "test_ln_optimize_spill.mmap");
+     mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, NULL);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_CPU, mp_cpu);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_MMAP, mp_mmap);
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_spill(ops, mem_pools, &n_spilled);
+     /* "elew1" lives longest, "create1" is static and never planned */
+     ck_assert_int_eq(n_spilled, 1);
+     LN_LIST_FOREACH(op, ops) {
+          LN_LIST_FOREACH(te, op->op_arg->tensors_in) {
+               ck_assert_int_eq(te->mtype == LN_MEM_MMAP,
+                                !strcmp(te->name, "elew1"));
+          }
+          LN_LIST_FOREACH(te, op->op_arg->tensors_out) {
+               ck_assert_int_eq(te->mtype == LN_MEM_MMAP,
+                                !strcmp(te->name, "elew1"));
+          }
+     }
+
+     ops = ln_optimize_mem(ops, mem_pools);
+     ck_assert_int_eq(mp_cpu->peak, 96);
+     ck_assert_int_eq(mp_mmap->peak, 32);
+
+     /* every tensor has the buffer of its pre_run so far */
+     ck_assert_int_eq(heap_bytes(ops), 4 * 32 + 3 * 16 + 32);
+     ln_op_list_do_run_in_pools(ops, mem_pools, &error);
+     ln_error_handle(&error);
+     /* only the static "create1" is left out of the pools */
+     ck_assert_int_eq(heap_bytes(ops), 32);
+     data = (float *)((char *)mp_cpu->base + tensor_offset(ops, "elew3"));
+     for (i = 0; i < 8; i++)
+          ck_assert_float_eq(data[i], expected[i]);
+     /* "elew1" was computed in the mapped file */
+     data = (float *)((char *)mp_mmap->base + tensor_offset(ops, "elew1"));
+     for (i = 0; i < 8; i++)
+          ck_assert_float_eq(data[i], 2 * (i + 1));
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_mem_pool_free(mp_mmap);
+     ln_mem_pool_free(mp_cpu);
      ln_hash_free(mem_pools);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_fold)
+{
+     ln_list *ops;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     float expected[] = {1, 3, 5, 7, 2, 4, 6, 8};
+     int i;
+
+     json_str = read_json("test_ln_optimize_fold.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_fold(ops, &error);
+     ln_error_handle(&error);
+
+     /* the whole graph is constant, only a create of its output is left */
+     ck_assert_int_eq(ln_list_length(ops), 1);
+     op = ops->data;
+     ck_assert_str_eq(op->op_arg->name, "transpose1");
+     ck_assert_str_eq(op->op_arg->optype, "create");
+     ck_assert_ptr_eq(op->op_arg->tensors_in, NULL);
+     te = ln_tensor_table_find_by_name(op->op_arg->tensors_out, "transpose1");
+     ck_assert_int_eq(te->isstatic, 1);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "transpose1")->data;
+     for (i = 0; i < 8; i++)
+          ck_assert_float_eq(data[i], expected[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_fold_cse)
+{
+     ln_list *ops, *outputs;
+     ln_op *op;
+     char *json_str;
+     float *data;
+     char *names[] = {"x", "f", "y1", "s"};
+     float x[] = {1, 1, 1, 1};
+     float s[] = {4, 8, 12, 16};
+     int i;
+
+     json_str = read_json("test_ln_optimize_fold_cse.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_fold(ops, &error);
+     ln_error_handle(&error);
+
+     /* "f" is a create op now, so the ops can still be prepared again */
+     op = ln_op_list_find_by_name(ops, "f");
+     ck_assert_str_eq(op->op_arg->optype, "create");
+     ck_assert(!ln_optimize_is_folded(op));
+     outputs = ln_list_append(NULL, "s");
+     ops = ln_optimize_cse(ops, outputs, &error);
+     ck_assert_ptr_eq(error, NULL);
+     ops = ln_optimize_simplify(ops, outputs, NULL, &error);
+     ck_assert_ptr_eq(error, NULL);
+     ln_list_free(outputs);
+
+     ck_assert_int_eq(ln_list_length(ops), 4);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+
+     /* "x" is a placeholder, given its data here */
+     ln_op_list_find_tensor_by_name(ops, "x")->data = x;
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "s")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], s[i]);
+     ln_op_list_find_tensor_by_name(ops, "x")->data = NULL;
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_dce)
+{
+     ln_list *ops, *outputs;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     char *names[] = {"create1", "maxreduce1", "elew2"};
+     int i;
+
+     json_str = read_json("test_ln_optimize_dce.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "elew2");
+     ops = ln_optimize_dce(ops, outputs, &error);
+     ln_error_handle(&error);
+
+     /* the "elew1" branch is dead */
+     ck_assert_int_eq(ln_list_length(ops), 3);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "maxreduce1");
+     te = ln_tensor_table_find_by_name(op->op_arg->tensors_out,
+                                       "maxreduce1_arg");
+     ck_assert_int_eq(te->isdead, 1);
+     te = ln_tensor_table_find_by_name(op->op_arg->tensors_out, "maxreduce1");
+     ck_assert_int_eq(te->isdead, 0);
+
+     data = ln_op_list_find_tensor_by_name(ops, "maxreduce1_arg")->data;
+     for (i = 0; i < 4; i++)
+          data[i] = -1;
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     /* argmax is skipped */
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], -1);
+     data = ln_op_list_find_tensor_by_name(ops, "elew2")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], 2 * (i + 5));
+
+     ln_list_free(outputs);
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_cse)
+{
+     ln_list *ops;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     char *names[] = {"create1", "slice1", "slice3", "elew1", "elew2", "elew4"};
+     float elew1[] = {1, 4, 25, 36};
+     float elew4[] = {6, 16, 70, 96};
+     ln_list *outputs;
+     int i;
+
+     json_str = read_json("test_ln_optimize_cse.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(ln_list_append(NULL, "elew1"), "elew4");
+     ops = ln_optimize_cse(ops, outputs, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     /* "slice2" merges into "slice1", then "elew3" into "elew2" */
+     ck_assert_int_eq(ln_list_length(ops), 6);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "elew1");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "slice1");
+     ck_assert_ptr_eq(te->tensor, ln_op_list_find_tensor_by_name(ops, "slice1"));
+     op = ln_op_list_find_by_name(ops, "elew4");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "elew2");
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew1")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew1[i]);
+     data = ln_op_list_find_tensor_by_name(ops, "elew4")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew4[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_cse_out)
+{
+     ln_list *ops, *outputs;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+
+     json_str = read_json("test_ln_optimize_cse.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     /* "elew3" is read by "elew4", but is a graph output too, so it stays */
+     outputs = ln_list_append(ln_list_append(NULL, "elew1"), "elew4");
+     outputs = ln_list_append(outputs, "elew3");
+     ops = ln_optimize_cse(ops, outputs, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     ck_assert_int_eq(ln_list_length(ops), 7);
+     ck_assert_ptr_eq(ln_op_list_find_by_name(ops, "slice2"), NULL);
+     op = ln_op_list_find_by_name(ops, "elew4");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "elew3");
+
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_simplify)
+{
+     ln_list *ops;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     char *names[] = {"create1", "ones", "zeros1", "two", "three", "divisor",
+                      "elew3", "elew4_sq", "elew4", "divisor_recip", "elew5"};
+     float elew5[] = {0.5, 16, 91.125, 256};
+     ln_list *outputs;
+     int i, n;
+
+     json_str = read_json("test_ln_optimize_simplify.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "elew5");
+     ops = ln_optimize_simplify(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     /* "elew1" (x*1) and "elew2" (x+0) are removed, the POWs become MULs
+        and the DIV a MUL by a new reciprocal constant */
+     ck_assert_int_eq(n, 5);
+     ck_assert_int_eq(ln_list_length(ops), 11);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "elew3");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+     ck_assert_str_eq(te->name, "create1");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "create1");
+     op = ln_op_list_find_by_name(ops, "elew5");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "divisor_recip");
+     ck_assert_str_eq(ln_param_table_find_by_arg_name(op->op_arg->params,
+                                                      "elew_op")->value_string,
+                      "TL_MUL");
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew5")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew5[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_simplify_div)
+{
+     ln_list *ops;
+     ln_op *op;
+     char *json_str;
+     float *data;
+     char *names[] = {"x", "c", "c_recip", "d1", "d2"};
+     float d2[] = {0.25, 0.125, 0.046875, 0.015625};
+     ln_list *outputs;
+     int i, n;
+
+     json_str = read_json("test_ln_optimize_simplify_div.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "d2");
+     ops = ln_optimize_simplify(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     /* both DIVs by "c" share one reciprocal */
+     ck_assert_int_eq(n, 2);
+     ck_assert_int_eq(ln_list_length(ops), 5);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "d2")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], d2[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_simplify_out)
+{
+     ln_list *ops, *outputs;
+     char *json_str;
+     float *data;
+     float b[] = {2, 4, 6, 8};
+     int i, n;
+
+     json_str = read_json("test_ln_optimize_simplify_out.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     /* "a" (x*1) is read by "b", but is a graph output too, so it stays */
+     outputs = ln_list_append(ln_list_append(NULL, "a"), "b");
+     ops = ln_optimize_simplify(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+     ck_assert_int_eq(n, 0);
+     ck_assert_int_eq(ln_list_length(ops), 4);
+
+     outputs = ln_list_append(NULL, "b");
+     ops = ln_optimize_simplify(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+     ck_assert_int_eq(n, 1);
+     ck_assert_int_eq(ln_list_length(ops), 3);
+     ck_assert_ptr_eq(ln_op_list_find_by_name(ops, "a"), NULL);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "b")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], b[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_transpose)
+{
+     ln_list *ops;
+     ln_op *op;
+     ln_tensor_entry *te;
+     ln_param_entry *pe;
+     char *json_str;
+     float *data;
+     char *names[] = {"create1", "create2", "create3", "elew1", "elew2",
+                      "elew3", "reshape2", "transpose7"};
+     float elew3[] = {13, 17, 19, 19, 17, 13};
+     ln_list *outputs;
+     int i, j, k, n;
+
+     json_str = read_json("test_ln_optimize_transpose.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(ln_list_append(NULL, "reshape2"), "transpose7");
+     ops = ln_optimize_transpose(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     /* "transpose1-2" cancel, "transpose3-4" sink below "elew2" and cancel
+        with "transpose5", "reshape1-2" merge, "transpose6-7" compose */
+     ck_assert_int_eq(n, 7);
+     ck_assert_int_eq(ln_list_length(ops), 8);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "elew3");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+     ck_assert_str_eq(te->name, "elew2_untransposed");
+     op = ln_op_list_find_by_name(ops, "reshape2");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_str_eq(te->name, "elew3");
+     op = ln_op_list_find_by_name(ops, "transpose7");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_str_eq(te->name, "create3");
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "axes");
+     ck_assert_int_eq(pe->value_array_int[0], 1);
+     ck_assert_int_eq(pe->value_array_int[1], 0);
+     ck_assert_int_eq(pe->value_array_int[2], 2);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "reshape2")->data;
+     for (i = 0; i < 6; i++)
+          ck_assert_float_eq(data[i], elew3[i]);
+     data = ln_op_list_find_tensor_by_name(ops, "transpose7")->data;
+     for (i = 0; i < 2; i++)
+          for (j = 0; j < 3; j++)
+               for (k = 0; k < 4; k++)
+                    ck_assert_float_eq(data[j*8 + i*4 + k], i*12 + j*4 + k);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_transpose_out)
+{
+     ln_list *ops, *outputs;
+     ln_op *op;
+     ln_tensor_entry *te;
+     char *json_str;
+     float *data;
+     float elew3[] = {13, 17, 19, 19, 17, 13};
+     int i, n;
+
+     json_str = read_json("test_ln_optimize_transpose.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     /* "transpose2" (identity once composed) and "reshape1" are read by
+        other ops, but are graph outputs too, so they stay */
+     outputs = ln_list_append(ln_list_append(NULL, "reshape2"), "transpose7");
+     outputs = ln_list_append(outputs, "transpose2");
+     outputs = ln_list_append(outputs, "reshape1");
+     ops = ln_optimize_transpose(ops, outputs, &n, &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+
+     ck_assert_int_eq(n, 6);
+     ck_assert_ptr_eq(ln_op_list_find_by_name(ops, "transpose1"), NULL);
+     op = ln_op_list_find_by_name(ops, "transpose2");
+     ck_assert_ptr_ne(op, NULL);
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_str_eq(te->name, "create1");
+     ck_assert_ptr_ne(ln_op_list_find_by_name(ops, "reshape1"), NULL);
+     op = ln_op_list_find_by_name(ops, "reshape2");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_str_eq(te->name, "elew3");
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "transpose2")->data;
+     for (i = 0; i < 6; i++)
+          ck_assert_float_eq(data[i], i + 1);
+     data = ln_op_list_find_tensor_by_name(ops, "reshape1")->data;
+     for (i = 0; i < 6; i++)
+          ck_assert_float_eq(data[i], elew3[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_mtype)
+{
+     ln_list *ops, *registered, *backends, *outputs;
+     ln_op *op, fast_elew;
+     ln_tensor_entry *te;
+     ln_op_arg fast_elew_arg = {.optype = "elew_fast"};
+     ln_backend host = {"cpu", LN_MEM_CPU, "", "copy", 2e-6, 0, 0, 0};
+     ln_backend fast = {"fast", LN_MEM_CUDA, "_fast", "copy", 0, 0, 0, 1e-2};
+     char *json_str;
+     float *data;
+     char *names[] = {"create1", "create2", "create1_fast_copy",
+                      "create2_fast_copy", "elew1", "elew2", "elew3",
+                      "elew3_copy"};
+     float elew3[] = {36, 196, 576, 1296};
+     float elew2[] = {6, 14, 24, 36};
+     int i, n;
+
+     /* a faster device, running the CPU kernels of elew */
+     fast_elew = *ln_op_list_find_by_optype(registered_ops, "elew");
+     fast_elew.op_arg = &fast_elew_arg;
+     registered = NULL;
+     LN_LIST_FOREACH(op, registered_ops) {
+          registered = ln_list_append(registered, op);
+     }
+     registered = ln_list_append(registered, &fast_elew);
+     backends = ln_list_append(ln_list_append(NULL, &host), &fast);
+     json_str = read_json("test_ln_optimize_mtype.json");
+     outputs = ln_list_append(NULL, "elew3");
+
+     /* an elew takes 2ms on the host; transfers of 10ms aren't worth it */
+     ops = ln_parse_ops(json_str, registered, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_mtype(ops, registered, backends, outputs, &n, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(n, 0);
+     ck_assert_int_eq(ln_list_length(ops), 5);
+     LN_LIST_FOREACH(op, ops) {
+          ck_assert_str_ne(op->op_arg->optype, "elew_fast");
+          te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+          ck_assert_int_eq(te->mtype, LN_MEM_CPU);
+     }
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+
+     /* with 1ms transfers, no single elew is worth moving, but the chain
+        of three is */
+     fast.link_latency = 1e-3;
+     ops = ln_parse_ops(json_str, registered, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_mtype(ops, registered, backends, outputs, &n, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(n, 3);
+     ck_assert_int_eq(ln_list_length(ops), 8);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "elew2");
+     ck_assert_str_eq(op->op_arg->optype, "elew_fast");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src2");
+     ck_assert_str_eq(te->name, "create1_fast");
+     ck_assert_int_eq(te->mtype, LN_MEM_CUDA);
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     ck_assert_int_eq(te->mtype, LN_MEM_CUDA);
+     op = ln_list_nth_data(ops, 7);
+     ck_assert_str_eq(op->op_arg->optype, "copy");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_str_eq(te->name, "elew3_fast");
+     ck_assert_int_eq(te->mtype, LN_MEM_CUDA);
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     ck_assert_str_eq(te->name, "elew3");
+     ck_assert_int_eq(te->mtype, LN_MEM_CPU);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew3")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew3[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+
+     /* "elew2" is read by "elew3", but is a graph output too, so it is
+        copied back as well, and "elew3" reads it on the device */
+     outputs = ln_list_append(outputs, "elew2");
+     ops = ln_parse_ops(json_str, registered, &error);
+     ln_error_handle(&error);
+     ops = ln_optimize_mtype(ops, registered, backends, outputs, &n, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(n, 4);
+     ck_assert_int_eq(ln_list_length(ops), 9);
+     op = ln_list_nth_data(ops, 6);
+     ck_assert_str_eq(op->op_arg->name, "elew2_copy");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     ck_assert_str_eq(te->name, "elew2");
+     ck_assert_int_eq(te->mtype, LN_MEM_CPU);
+     op = ln_op_list_find_by_name(ops, "elew3");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+     ck_assert_str_eq(te->name, "elew2_fast");
+     ck_assert_int_eq(te->mtype, LN_MEM_CUDA);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew2")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew2[i]);
+     data = ln_op_list_find_tensor_by_name(ops, "elew3")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew3[i]);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_list_free(outputs);
+     ln_list_free(backends);
+     ln_list_free(registered);
+     ln_free(json_str);
+}
+END_TEST
+
+START_TEST(test_ln_optimize_fuse)
+{
+     ln_list *ops, *outputs;
+     ln_op *op;
+     ln_tensor_entry *te;
+     ln_param_entry *pe;
+     char *json_str;
+     float *data;
+     char *names[] = {"a", "b", "c", "elew2", "elew4", "elew5"};
+     int i, n;
+
+     json_str = read_json("test_ln_optimize_fuse.json");
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "elew4");
+     outputs = ln_list_append(outputs, "elew5");
+     ops = ln_optimize_fuse(ops, registered_ops, outputs, &n, &error);
+     ln_error_handle(&error);
+
+     /* "elew1" is inlined into "elew2" and "elew3" into "elew4"; "elew2"
+        is read twice and "elew4" is an output, so they stay */
+     ck_assert_int_eq(n, 2);
+     ck_assert_int_eq(ln_list_length(ops), 6);
+     i = 0;
+     LN_LIST_FOREACH(op, ops)
+          ck_assert_str_eq(op->op_arg->name, names[i++]);
+     op = ln_op_list_find_by_name(ops, "elew2");
+     ck_assert_str_eq(op->op_arg->optype, "elew_fused");
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "expr");
+     ck_assert_int_eq(pe->array_len, 2);
+     ck_assert_str_eq(pe->value_array_string[0], "TL_MUL s0 s1");
+     ck_assert_str_eq(pe->value_array_string[1], "TL_SUM n0 s2");
+     op = ln_op_list_find_by_name(ops, "elew4");
+     ck_assert_str_eq(op->op_arg->optype, "elew_fused");
+     ck_assert_int_eq(ln_tensor_table_length(op->op_arg->tensors_in), 2);
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src0");
+     ck_assert_str_eq(te->name, "elew2");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src1");
+     ck_assert_str_eq(te->name, "a");
+     pe = ln_param_table_find_by_arg_name(op->op_arg->params, "expr");
+     ck_assert_int_eq(pe->array_len, 2);
+     ck_assert_str_eq(pe->value_array_string[0], "TL_SUB s0 s1");
+     ck_assert_str_eq(pe->value_array_string[1], "TL_MIN s0 n0");
+     op = ln_op_list_find_by_name(ops, "elew5");
+     ck_assert_str_eq(op->op_arg->optype, "elew");
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew4")->data;
+     for (i = 0; i < 10; i++)
+          ck_assert_float_eq(data[i], i + 4);
+     data = ln_op_list_find_tensor_by_name(ops, "elew5")->data;
+     for (i = 0; i < 10; i++)
+          ck_assert_float_eq(data[i], (i + 4) / 2.0);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_list_free(outputs);
+     ln_free(json_str);
 }
 END_TEST
 /* end of tests */
@@ -58,6 +916,21 @@ Suite *make_optimize_suite(void)
      tcase_add_checked_fixture(tc_optimize, setup, teardown);
 
      tcase_add_test(tc_optimize, test_ln_optimize_mem);
+     tcase_add_test(tc_optimize, test_ln_optimize_order);
+     tcase_add_test(tc_optimize, test_ln_optimize_remat);
+     tcase_add_test(tc_optimize, test_ln_optimize_spill);
+     tcase_add_test(tc_optimize, test_ln_optimize_fold);
+     tcase_add_test(tc_optimize, test_ln_optimize_fold_cse);
+     tcase_add_test(tc_optimize, test_ln_optimize_dce);
+     tcase_add_test(tc_optimize, test_ln_optimize_cse);
+     tcase_add_test(tc_optimize, test_ln_optimize_cse_out);
+     tcase_add_test(tc_optimize, test_ln_optimize_simplify);
+     tcase_add_test(tc_optimize, test_ln_optimize_simplify_div);
+     tcase_add_test(tc_optimize, test_ln_optimize_simplify_out);
+     tcase_add_test(tc_optimize, test_ln_optimize_transpose);
+     tcase_add_test(tc_optimize, test_ln_optimize_transpose_out);
+     tcase_add_test(tc_optimize, test_ln_optimize_mtype);
+     tcase_add_test(tc_optimize, test_ln_optimize_fuse);
      /* end of adding tests */
 
      suite_add_tcase(s, tc_optimize);
@@ -205,6 +205,39 @@ START_TEST(test_ln_param_table_append_array_bool)
 }
 END_TEST
 
+START_TEST(test_ln_param_table_copy)
+{
+     ln_param_table *params, *copy;
+     ln_param_entry *entry;
+     double array_number[] = {2.2, 3};
+     char *array_string[] = {"test_array_str1", "test_array_str2"};
+
+     params = ln_param_table_append_string(NULL, "test_arg_name_1", "test_string");
+     params = ln_param_table_append_array_number(params, "test_arg_name_2",
+						 2, array_number);
+     params = ln_param_table_append_array_string(params, "test_arg_name_3",
+						 2, array_string);
+     params = ln_param_table_append_null(params, "test_arg_name_4");
+     copy = ln_param_table_copy(params);
+     ln_param_table_free(params);
+
+     ck_assert_int_eq(ln_param_table_length(copy), 4);
+     entry = ln_param_table_find_by_arg_name(copy, "test_arg_name_1");
+     ck_assert_int_eq(entry->type, LN_PARAM_STRING);
+     ck_assert_str_eq(entry->value_string, "test_string");
+     entry = ln_param_table_find_by_arg_name(copy, "test_arg_name_2");
+     ck_assert_int_eq(entry->type, LN_PARAM_ARRAY_NUMBER);
+     ck_assert(entry->value_array_double[0] == array_number[0]);
+     ck_assert_int_eq(entry->value_array_int[1], 3);
+     entry = ln_param_table_find_by_arg_name(copy, "test_arg_name_3");
+     ck_assert_int_eq(entry->type, LN_PARAM_ARRAY_STRING);
+     ck_assert_str_eq(entry->value_array_string[1], array_string[1]);
+     entry = ln_param_table_find_by_arg_name(copy, "test_arg_name_4");
+     ck_assert_int_eq(entry->type, LN_PARAM_NULL);
+     ln_param_table_free(copy);
+}
+END_TEST
+
 START_TEST(test_ln_param_table_find_by_arg_name)
 {
 }
@@ -247,6 +280,7 @@ Suite *make_param_suite(void)
      tcase_add_test(tc_param, test_ln_param_table_append_array_string);
      tcase_add_test(tc_param, test_ln_param_table_append_array_number);
      tcase_add_test(tc_param, test_ln_param_table_append_array_bool);
+     tcase_add_test(tc_param, test_ln_param_table_copy);
      tcase_add_test(tc_param, test_ln_param_table_find_by_arg_name);
      tcase_add_test(tc_param, test_ln_param_table_length);
      tcase_add_test(tc_param, test_ln_param_type_name);
@@ -20,7 +20,6 @@
  * SOFTWARE.
  */
 
-#include <sys/stat.h>
 #include "test_lightnet.h"
 #include "../src/ln_op.h"
 #include "../src/ln_parse.h"
@@ -33,28 +32,7 @@ extern ln_op *ln_init_ops[];
 
 static void setup(void)
 {
-     struct stat buf;
-     FILE *fp;
-     size_t n;
-
-     if (stat("test_ln_parse.json", &buf) < 0) {
-          perror("Cannot stat test_ln_parse.json");
-          exit(EXIT_FAILURE);
-     }
-
-     json_str = ln_alloc(buf.st_size);
-     if (!(fp = fopen("test_ln_parse.json", "rb"))) {
-          perror("Cannot open test_ln_parse.json");
-          exit(EXIT_FAILURE);
-     }
-     n = fread(json_str, buf.st_size, 1, fp);
-     if (n < 1 && ferror(fp)) {
-          perror("Error reading test_ln_parse.json");
-          exit(EXIT_FAILURE);
-     }
-
-     fclose(fp);
-
+     json_str = read_json("test_ln_parse.json");
      registered_ops = ln_op_list_create_from_array(ln_init_ops);
 }
 
@@ -273,6 +251,48 @@ START_TEST(test_ln_parse_ops)
      ln_op_list_free_tables_too(ops);
 }
 END_TEST
+
+START_TEST(test_ln_parse_ops_cost)
+{
+     ln_list *ops;
+     ln_op *op;
+     ln_op_cost cost;
+     double *times;
+     FILE *fp;
+     char *names[] = {"create1", "slice1", "reshape1", "maxreduce1", "elew1",
+                      "transpose1", "zeros1"};
+     size_t costs[][3] = {{0, 0, 0}, {0, 24, 24}, {0, 0, 0}, {6, 24, 16},
+                          {2, 16, 8}, {0, 8, 8}, {0, 0, 32}};
+     int i;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+
+     for (i = 0; i < 7; i++) {
+          op = ln_op_list_find_by_name(ops, names[i]);
+          ck_assert_ptr_eq(op->cost,
+                           ln_op_list_find_by_optype(registered_ops,
+                                                     op->op_arg->optype)->cost);
+          ln_op_get_cost(op, &cost);
+          ck_assert_uint_eq(cost.flops, costs[i][0]);
+          ck_assert_uint_eq(cost.bytes_read, costs[i][1]);
+          ck_assert_uint_eq(cost.bytes_written, costs[i][2]);
+     }
+
+     times = ln_op_list_time(ops, 2, &error);
+     ln_error_handle(&error);
+     for (i = 0; i < 7; i++)
+          ck_assert(times[i] >= 0);
+     fp = fopen("/dev/null", "w");
+     ln_op_list_print_roofline(ops, times, 100, 10, fp);
+     fclose(fp);
+     ln_free(times);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
 /* end of tests */
 
 Suite *make_parse_suite(void)
@@ -285,6 +305,7 @@ Suite *make_parse_suite(void)
      tcase_add_checked_fixture(tc_parse, setup, teardown);
 
      tcase_add_test(tc_parse, test_ln_parse_ops);
+     tcase_add_test(tc_parse, test_ln_parse_ops_cost);
      /* end of adding tests */
 
      suite_add_tcase(s, tc_parse);
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_lightnet.h"
+#include "../src/ln_pass.h"
+#include "../src/ln_parse.h"
+#include "../src/ln_op.h"
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_pass.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+}
+
+static void teardown(void)
+{
+     ln_free(json_str);
+     ln_list_free(registered_ops);
+}
+
+START_TEST(test_ln_pass_pipeline_create)
+{
+     ln_list *pipeline;
+
+     pipeline = ln_pass_pipeline_create("cse, simplify,dce", &error);
+     ck_assert_ptr_eq(error, NULL);
+     ck_assert_int_eq(ln_list_length(pipeline), 3);
+     ck_assert_str_eq(((ln_pass *)ln_list_nth_data(pipeline, 0))->name, "cse");
+     ck_assert_str_eq(((ln_pass *)ln_list_nth_data(pipeline, 1))->name,
+                      "simplify");
+     ck_assert_ptr_eq(ln_list_nth_data(pipeline, 2), ln_pass_find("dce"));
+     ln_list_free(pipeline);
+
+     pipeline = ln_pass_pipeline_create("cse,no_such_pass", &error);
+     ck_assert_ptr_eq(pipeline, NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ck_assert_int_eq(error->level, LN_ERROR);
+     ln_error_free(error);
+     error = NULL;
+
+     pipeline = ln_parse_passes(json_str, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(ln_list_length(pipeline), 2);
+     ck_assert_ptr_eq(ln_list_nth_data(pipeline, 0), ln_pass_find("transpose"));
+     ck_assert_ptr_eq(ln_list_nth_data(pipeline, 1), ln_pass_find("dce"));
+     ln_list_free(pipeline);
+}
+END_TEST
+
+START_TEST(test_ln_pass_pipeline_run)
+{
+     ln_list *ops, *pipeline, *stats;
+     ln_pass_stat *stat;
+     float *data;
+     float elew1[] = {1, 4, 9, 16};
+     int i;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     pipeline = ln_parse_passes(json_str, &error);
+     ln_error_handle(&error);
+     ops = ln_pass_pipeline_run(pipeline, ops, NULL, &stats, &error);
+     ln_error_handle(&error);
+     ln_pass_verify(ops, &error);
+     ck_assert_ptr_eq(error, NULL);
+
+     ck_assert_int_eq(ln_list_length(stats), 2);
+     stat = ln_list_nth_data(stats, 0);
+     ck_assert_str_eq(stat->name, "transpose");
+     ck_assert_int_eq(stat->ops_before, 4);
+     ck_assert_int_eq(stat->ops_after, 2);
+     ck_assert_int_eq(stat->tensors_before, 4);
+     ck_assert_int_eq(stat->tensors_after, 2);
+     ck_assert_uint_eq(stat->mem_before, 2 * 4 * sizeof(float));
+     ck_assert_uint_eq(stat->mem_after, 4 * sizeof(float));
+     ck_assert(stat->time >= 0);
+     stat = ln_list_nth_data(stats, 1);
+     ck_assert_str_eq(stat->name, "dce");
+     ck_assert_int_eq(stat->ops_before, stat->ops_after);
+
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+     data = ln_op_list_find_tensor_by_name(ops, "elew1")->data;
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew1[i]);
+
+     ln_list_free_deep(stats, ln_free);
+     ln_list_free(pipeline);
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
+
+START_TEST(test_ln_pass_verify)
+{
+     ln_list *ops;
+     ln_tensor_entry *te;
+     tl_tensor *tensor;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ln_pass_verify(ops, &error);
+     ck_assert_ptr_eq(error, NULL);
+
+     /* a stale tensor, as if "transpose1" were rewired without pre_run */
+     te = ln_tensor_table_find_by_arg_name(ln_op_list_find_by_name(ops, "transpose2")->op_arg->tensors_in,
+                                           "src");
+     tensor = te->tensor;
+     te->tensor = ln_op_list_find_tensor_by_name(ops, "create1");
+     ln_pass_verify(ops, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     te->tensor = tensor;
+
+     /* a dangling name */
+     ln_free(te->name);
+     te->name = ln_strdup("no_such_tensor");
+     te->tensor = NULL;
+     ln_pass_verify(ops, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_free(te->name);
+     te->name = ln_strdup("transpose1");
+     te->tensor = tensor;
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_pass_suite(void)
+{
+     Suite *s;
+     TCase *tc_pass;
+
+     s = suite_create("pass");
+     tc_pass = tcase_create("pass");
+     tcase_add_checked_fixture(tc_pass, setup, teardown);
+
+     tcase_add_test(tc_pass, test_ln_pass_pipeline_create);
+     tcase_add_test(tc_pass, test_ln_pass_pipeline_run);
+     tcase_add_test(tc_pass, test_ln_pass_verify);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_pass);
+
+     return s;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_lightnet.h"
+#include "../src/ln_plan.h"
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_list *pipeline;
+static ln_list *outputs;
+static ln_plan_cache *cache;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_plan.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+     /* placeholders are neither merged nor folded */
+     pipeline = ln_pass_pipeline_create("cse,fold,dce", &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "transpose1");
+     cache = ln_plan_cache_create(json_str, registered_ops, pipeline, NULL,
+                                  outputs, 2);
+}
+
+static void teardown(void)
+{
+     ln_plan_cache_free(cache);
+     ln_list_free(outputs);
+     ln_list_free(pipeline);
+     ln_list_free(registered_ops);
+     ln_free(json_str);
+}
+
+/* the plan for x and y of [batch, 4] */
+static ln_plan *get_plan(int batch)
+{
+     int dims[2] = {batch, 4};
+     ln_shape shapes[2] = {{"x", 2, dims}, {"y", 2, dims}};
+
+     return ln_plan_cache_get(cache, shapes, 2, &error);
+}
+
+/* run plan with x[i] = i and y[i] = 2, checking the transposed product */
+static void run_plan(ln_plan *plan, int batch)
+{
+     float *x, *y, *out;
+     size_t size;
+     int i, j;
+
+     size = sizeof(float) * batch * 4;
+     x = ln_alloc(size);
+     y = ln_alloc(size);
+     out = ln_alloc(size);
+     for (i = 0; i < batch * 4; i++) {
+          x[i] = i;
+          y[i] = 2;
+     }
+     ln_io_bind_input(plan->io, "x", x, size, &error);
+     ln_error_handle(&error);
+     ln_io_bind_input(plan->io, "y", y, size, &error);
+     ln_error_handle(&error);
+     ln_io_bind_output(plan->io, "transpose1", out, size, &error);
+     ln_error_handle(&error);
+     ln_io_run(plan->io, &error);
+     ln_error_handle(&error);
+
+     ck_assert_int_eq(ln_io_find_output(plan->io, "transpose1")->dims[1],
+                      batch);
+     for (i = 0; i < 4; i++) {
+          for (j = 0; j < batch; j++)
+               ck_assert_float_eq(out[i * batch + j], 2 * (j * 4 + i));
+     }
+     ln_free(x);
+     ln_free(y);
+     ln_free(out);
+}
+
+START_TEST(test_ln_plan_cache)
+{
+     ln_plan *plan2, *plan3, *plan;
+     ln_plan_stat stat;
+
+     plan2 = get_plan(2);
+     ln_error_handle(&error);
+     ck_assert_int_eq(ln_list_length(plan2->ops), 4);
+     run_plan(plan2, 2);
+
+     plan3 = get_plan(3);
+     ln_error_handle(&error);
+     run_plan(plan3, 3);
+
+     /* a shape seen before costs a lookup */
+     plan = get_plan(2);
+     ln_error_handle(&error);
+     ck_assert_ptr_eq(plan, plan2);
+     run_plan(plan, 2);
+
+     /* the least recently used plan makes room */
+     plan = get_plan(5);
+     ln_error_handle(&error);
+     run_plan(plan, 5);
+     ck_assert_int_eq(ln_plan_cache_size(cache), 2);
+     ck_assert_ptr_eq(get_plan(2), plan2);
+
+     ln_plan_cache_get_stat(cache, &stat);
+     ck_assert_int_eq(stat.hits, 2);
+     ck_assert_int_eq(stat.misses, 3);
+     ck_assert_int_eq(stat.evictions, 1);
+}
+END_TEST
+
+START_TEST(test_ln_plan_shapes)
+{
+     int dims[2] = {2, 5};
+     ln_shape shape = {"x", 2, dims};
+     ln_list *ops;
+
+     /* symbolic dimensions need a shape */
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ck_assert_ptr_eq(ops, NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     /* other dimensions stay as they are */
+     ck_assert_ptr_eq(ln_plan_cache_get(cache, &shape, 1, &error), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     shape.ndim = 1;
+     ck_assert_ptr_eq(ln_plan_cache_get(cache, &shape, 1, &error), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ck_assert_int_eq(ln_plan_cache_size(cache), 0);
+}
+END_TEST
+
+START_TEST(test_ln_plan_buckets)
+{
+     int buckets[2] = {4, 2};
+     int dims[2] = {3, 4};
+     ln_shape shapes[2] = {{"x", 2, dims}, {"y", 2, dims}};
+     float x[20], y[20], out[20];
+     const void *inputs[2] = {x, y};
+     void *outs[1] = {out};
+     ln_plan_cache *bucketed;
+     ln_list *names;
+     ln_plan_stat stat;
+     int i;
+
+     names = ln_list_append(NULL, "mul1");
+     bucketed = ln_plan_cache_create(json_str, registered_ops, pipeline, NULL,
+                                     names, 4);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 3), 3);
+     ln_plan_cache_set_buckets(bucketed, buckets, 2);
+     ln_plan_cache_set_batch_axis(bucketed, "mul1", 0);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 1), 2);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 3), 4);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 5), -1);
+
+     for (i = 0; i < 20; i++) {
+          x[i] = i;
+          y[i] = 2;
+     }
+     /* a batch of 3 is padded to 4 and trimmed back */
+     out[12] = -1;
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ln_error_handle(&error);
+     for (i = 0; i < 12; i++)
+          ck_assert_float_eq(out[i], 2 * i);
+     ck_assert_float_eq(out[12], -1);
+
+     dims[0] = 4;
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ln_error_handle(&error);
+     ck_assert_float_eq(out[15], 30);
+     ck_assert_int_eq(ln_plan_cache_size(bucketed), 1);
+
+     dims[0] = 5;
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+
+     ln_plan_cache_get_stat(bucketed, &stat);
+     ck_assert_int_eq(stat.batch_rows, 7);
+     ck_assert_int_eq(stat.padded_rows, 1);
+     ck_assert_int_eq(stat.misses, 1);
+
+     /* powers of two */
+     ln_plan_cache_set_buckets(bucketed, NULL, 0);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 1), 1);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 5), 8);
+     ck_assert_int_eq(ln_plan_cache_bucket(bucketed, 8), 8);
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ln_error_handle(&error);
+     ck_assert_float_eq(out[19], 38);
+
+     ln_plan_cache_free(bucketed);
+     ln_list_free(names);
+}
+END_TEST
+
+START_TEST(test_ln_plan_batch_axis)
+{
+     int dims[2] = {5, 4};
+     ln_shape shapes[2] = {{"x", 2, dims}, {"y", 2, dims}};
+     float x[20], y[20], out[24];
+     const void *inputs[2] = {x, y};
+     void *outs[1] = {out};
+     ln_plan_cache *bucketed;
+     ln_list *names;
+     int i, j;
+
+     names = ln_list_append(NULL, "transpose1");
+     bucketed = ln_plan_cache_create(json_str, registered_ops, pipeline, NULL,
+                                     names, 4);
+     ln_plan_cache_set_buckets(bucketed, NULL, 0);
+     for (i = 0; i < 20; i++) {
+          x[i] = i;
+          y[i] = 2;
+     }
+     for (i = 0; i < 24; i++)
+          out[i] = -1;
+
+     /* the [4, 8] output padded from [4, 5] can't be trimmed on axis 0 */
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_plan_cache_set_batch_axis(bucketed, "transpose1", 0);
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     for (i = 0; i < 24; i++)
+          ck_assert_float_eq(out[i], -1);
+
+     ln_plan_cache_set_batch_axis(bucketed, "transpose1", 1);
+     ln_plan_cache_run(bucketed, shapes, 2, inputs, outs, &error);
+     ln_error_handle(&error);
+     for (i = 0; i < 4; i++)
+          for (j = 0; j < 5; j++)
+               ck_assert_float_eq(out[i * 5 + j], 2 * (j * 4 + i));
+     for (i = 20; i < 24; i++)
+          ck_assert_float_eq(out[i], -1);
+
+     ln_plan_cache_free(bucketed);
+     ln_list_free(names);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_plan_suite(void)
+{
+     Suite *s;
+     TCase *tc_plan;
+
+     s = suite_create("plan");
+     tc_plan = tcase_create("plan");
+     tcase_add_checked_fixture(tc_plan, setup, teardown);
+
+     tcase_add_test(tc_plan, test_ln_plan_cache);
+     tcase_add_test(tc_plan, test_ln_plan_shapes);
+     tcase_add_test(tc_plan, test_ln_plan_buckets);
+     tcase_add_test(tc_plan, test_ln_plan_batch_axis);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_plan);
+
+     return s;
+}
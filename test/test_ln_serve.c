@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include "test_lightnet.h"
+#include "../src/ln_serve.h"
+#include "../src/ln_op.h"
+
+#define N_THREADS 4
+#define N_RUNS 50
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_list *inputs;
+static ln_list *outputs;
+static ln_serve *serve;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+extern ln_op ln_opimpl_create;
+
+/* the data "create" ops have allocated */
+static size_t create_bytes;
+
+static void counted_create_pre_run(ln_op_arg *op_arg, ln_error **error)
+{
+     ln_tensor_entry *te;
+
+     ln_opimpl_create.pre_run(op_arg, error);
+     te = ln_tensor_table_find_by_arg_name(op_arg->tensors_out, "dst");
+     if (!*error && te->tensor->data)
+          create_bytes += tl_tensor_size(te->tensor);
+}
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_serve.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+     inputs = ln_list_append(NULL, "x");
+     outputs = ln_list_append(NULL, "sum1");
+     serve = ln_serve_create(json_str, registered_ops, NULL, NULL, inputs,
+                             outputs, 3, 1, &error);
+     ln_error_handle(&error);
+}
+
+static void teardown(void)
+{
+     ln_serve_free(serve);
+     ln_list_free(inputs);
+     ln_list_free(outputs);
+     ln_list_free(registered_ops);
+     ln_free(json_str);
+}
+
+/* requests of one client, returning the number of wrong results */
+static void *client(void *arg)
+{
+     size_t id = (size_t)arg;
+     float x[8], sum[8];
+     const void *ins[1] = {x};
+     void *outs[1] = {sum};
+     ln_error *client_error = NULL;
+     size_t n_wrong = 0;
+     int i, j;
+
+     for (i = 0; i < N_RUNS; i++) {
+          for (j = 0; j < 8; j++)
+               x[j] = id * 100 + i + j;
+          ln_serve_run(serve, ins, outs, &client_error);
+          if (client_error) {
+               ln_error_free(client_error);
+               client_error = NULL;
+               n_wrong++;
+               continue;
+          }
+          /* x * w + w, w being 1..8 */
+          for (j = 0; j < 8; j++) {
+               if (sum[j] != x[j] * (j + 1) + (j + 1)) {
+                    n_wrong++;
+                    break;
+               }
+          }
+     }
+     return (void *)n_wrong;
+}
+
+START_TEST(test_ln_serve_run)
+{
+     pthread_t threads[N_THREADS];
+     ln_serve_stat stat;
+     void *n_wrong;
+     size_t i;
+
+     for (i = 0; i < N_THREADS; i++)
+          ck_assert_int_eq(pthread_create(&threads[i], NULL, client,
+                                          (void *)i), 0);
+     for (i = 0; i < N_THREADS; i++) {
+          pthread_join(threads[i], &n_wrong);
+          ck_assert_int_eq((size_t)n_wrong, 0);
+     }
+
+     /* the weights are kept once, the activations per instance */
+     ln_serve_get_stat(serve, &stat);
+     ck_assert_int_eq(stat.n_instances, 3);
+     ck_assert_int_eq(stat.shared_bytes, 32);
+     ck_assert_int_eq(stat.activation_bytes, 64);
+     ck_assert_int_eq(stat.n_requests, N_THREADS * N_RUNS);
+}
+END_TEST
+
+START_TEST(test_ln_serve_errors)
+{
+     float x[9], sum[8];
+     const void *ins[1] = {(char *)x + 1};
+     void *outs[1] = {sum};
+     ln_list *names;
+
+     /* a misaligned buffer fails the request only */
+     ln_serve_run(serve, ins, outs, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ins[0] = x;
+     ln_serve_run(serve, ins, outs, &error);
+     ln_error_handle(&error);
+
+     names = ln_list_append(NULL, "mul1");
+     ck_assert_ptr_eq(ln_serve_create(json_str, registered_ops, NULL, NULL,
+                                      names, outputs, 2, 0, &error), NULL);
+     ck_assert_ptr_ne(error, NULL);
+     ln_error_free(error);
+     error = NULL;
+     ln_list_free(names);
+}
+END_TEST
+
+START_TEST(test_ln_serve_load_once)
+{
+     float x[8], sum[8];
+     const void *ins[1] = {x};
+     void *outs[1] = {sum};
+     ln_op counted_create;
+     ln_list *counted_ops, *pipeline;
+     ln_serve *counted;
+     ln_serve_stat stat;
+     int i;
+
+     counted_create = ln_opimpl_create;
+     counted_create.pre_run = counted_create_pre_run;
+     counted_ops = ln_list_prepend(registered_ops, &counted_create);
+     pipeline = ln_pass_pipeline_create("cse,fold,dce", &error);
+     ln_error_handle(&error);
+
+     /* the weights are made by the first instance only */
+     create_bytes = 0;
+     counted = ln_serve_create(json_str, counted_ops, pipeline, NULL, inputs,
+                               outputs, 4, 0, &error);
+     ln_error_handle(&error);
+     ck_assert_int_eq(create_bytes, 32);
+     ln_serve_get_stat(counted, &stat);
+     ck_assert_int_eq(stat.shared_bytes, 32);
+
+     for (i = 0; i < 8; i++)
+          x[i] = i;
+     for (i = 0; i < 8; i++) {
+          ln_serve_run(counted, ins, outs, &error);
+          ln_error_handle(&error);
+          ck_assert_float_eq(sum[7], 7 * 8 + 8);
+     }
+
+     ln_serve_free(counted);
+     ln_list_free(pipeline);
+     ln_list_remove_nth(counted_ops, 0);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_serve_suite(void)
+{
+     Suite *s;
+     TCase *tc_serve;
+
+     s = suite_create("serve");
+     tc_serve = tcase_create("serve");
+     tcase_add_checked_fixture(tc_serve, setup, teardown);
+
+     tcase_add_test(tc_serve, test_ln_serve_run);
+     tcase_add_test(tc_serve, test_ln_serve_errors);
+     tcase_add_test(tc_serve, test_ln_serve_load_once);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_serve);
+
+     return s;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <time.h>
+#include <pthread.h>
+#include "test_lightnet.h"
+#include "../src/ln_sim.h"
+#include "../src/ln_parse.h"
+
+static ln_list *registered_ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+}
+
+static void teardown(void)
+{
+     ln_sim_cleanup();
+     ln_list_free(registered_ops);
+}
+
+static double now(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int order[4];
+static int n_order;
+
+static void record(void *arg)
+{
+     order[n_order++] = *(int *)arg;
+}
+
+START_TEST(test_ln_sim_stream)
+{
+     ln_sim_config config = {0, 0, 0, 2e-3, 1024};
+     ln_sim_stat stat;
+     int args[] = {0, 1, 2};
+     char src[64], dst[64];
+     double start;
+
+     ln_sim_init(&config);
+     memset(src, 7, sizeof(src));
+     memset(dst, 0, sizeof(dst));
+     n_order = 0;
+
+     start = now();
+     ln_sim_launch(record, &args[0]);
+     ln_sim_copy(dst, src, sizeof(src));
+     ln_sim_launch(record, &args[1]);
+     ln_sim_launch(record, &args[2]);
+     ln_sim_sync();
+     ck_assert(now() - start >= 2e-3);
+
+     ck_assert_int_eq(n_order, 3);
+     ck_assert_int_eq(order[0], 0);
+     ck_assert_int_eq(order[1], 1);
+     ck_assert_int_eq(order[2], 2);
+     ck_assert_int_eq(memcmp(dst, src, sizeof(src)), 0);
+
+     ln_sim_get_stat(&stat);
+     ck_assert_uint_eq(stat.n_kernels, 3);
+     ck_assert_uint_eq(stat.n_copies, 1);
+     ck_assert_uint_eq(stat.bytes_copied, sizeof(src));
+     ck_assert(stat.copy_time >= 2e-3);
+}
+END_TEST
+
+static void run_placement(int async)
+{
+     ln_sim_config config = {0, 0, 0, 1e-4, 4096, async};
+     ln_backend host = {"cpu", LN_MEM_CPU, "", "copy", 2e-6, 0, 0, 0};
+     ln_backend sim;
+     ln_list *ops, *backends, *outputs;
+     ln_hash *mem_pools;
+     ln_mem_pool *mp_sim, *mp_cpu;
+     ln_tensor_entry *te, *te2;
+     ln_sim_stat stat;
+     ln_op *op;
+     char *json_str;
+     float *data;
+     float elew3[] = {36, 169, 484, 1089};
+     int i, n;
+
+     ln_sim_init(&config);
+     ck_assert_int_eq(ln_sim_is_async(), async);
+     ln_sim_backend(&sim);
+     ck_assert_int_eq(sim.mtype, LN_MEM_SIM);
+     backends = ln_list_append(ln_list_append(NULL, &host), &sim);
+     json_str = read_json("test_ln_sim.json");
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     outputs = ln_list_append(NULL, "elew3");
+     ops = ln_optimize_mtype(ops, registered_ops, backends, outputs, &n,
+                             &error);
+     ln_error_handle(&error);
+     ln_list_free(outputs);
+     ck_assert_int_eq(n, 4);
+     op = ln_op_list_find_by_name(ops, "elew2");
+     ck_assert_str_eq(op->op_arg->optype, "elew_sim");
+     op = ln_op_list_find_by_name(ops, "create1_sim_copy");
+     ck_assert_str_eq(op->op_arg->optype, "copy_sim");
+
+     /* sim tensors are planned in the pool of the device */
+     mp_sim = ln_sim_mem_pool_create(1);
+     ck_assert_ptr_ne(mp_sim->base, NULL);
+     mp_cpu = ln_mem_pool_create_arena(4096, 1);
+     mem_pools = ln_hash_create(ln_direct_hash, ln_direct_cmp,
+                                NULL, (ln_free_func)ln_mem_pool_free);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_CPU, mp_cpu);
+     ln_hash_insert(mem_pools, (void *)LN_MEM_SIM, mp_sim);
+     ops = ln_optimize_mem(ops, mem_pools);
+     ck_assert_uint_gt(mp_sim->peak, 0);
+     op = ln_op_list_find_by_name(ops, "elew3_copy");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_in, "src");
+     ck_assert_int_eq(te->mtype, LN_MEM_SIM);
+
+     /* the transfer of create3 after elew1 may overlap elew1, so it does
+        not take the buffer of create2_sim, dying at elew1 */
+     op = ln_op_list_find_by_name(ops, "create3_sim_copy");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     op = ln_op_list_find_by_name(ops, "create2_sim_copy");
+     te2 = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     ck_assert(te->offset != te2->offset);
+
+     /* run in the planned memory, so that transfers are double-buffered */
+     ln_op_list_do_run_in_pools(ops, mem_pools, &error);
+     ln_error_handle(&error);
+     op = ln_op_list_find_by_name(ops, "elew3_copy");
+     te = ln_tensor_table_find_by_arg_name(op->op_arg->tensors_out, "dst");
+     data = (float *)((char *)mp_cpu->base + te->offset);
+     for (i = 0; i < 4; i++)
+          ck_assert_float_eq(data[i], elew3[i]);
+     ln_sim_get_stat(&stat);
+     ck_assert_uint_eq(stat.n_kernels, 3);
+     ck_assert_uint_eq(stat.n_copies, 4);
+     ck_assert_uint_eq(stat.bytes_copied, 4 * 4 * sizeof(float));
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_hash_free(mem_pools);
+     ln_list_free(backends);
+     ln_free(json_str);
+}
+
+START_TEST(test_ln_sim_placement)
+{
+     run_placement(0);
+}
+END_TEST
+
+START_TEST(test_ln_sim_placement_async)
+{
+     run_placement(1);
+}
+END_TEST
+
+/* the number of steps whose inputs the host has queued for upload */
+static pthread_mutex_t step_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t step_cond = PTHREAD_COND_INITIALIZER;
+static int n_uploaded;
+
+struct step {
+     const int *in;
+     int       *out;
+     int        wait_for;       /* n_uploaded to wait for, 0 if none */
+     int        overlapped;     /* if n_uploaded got there while running */
+};
+
+/*
+ * Wait, a second at most, until the host has queued the upload of the next
+ * step, which it can only do while this kernel runs if they overlap.
+ */
+static void step_kernel(void *arg)
+{
+     struct step *step = arg;
+     struct timespec deadline;
+
+     clock_gettime(CLOCK_REALTIME, &deadline);
+     deadline.tv_sec++;
+     pthread_mutex_lock(&step_mutex);
+     while (n_uploaded < step->wait_for
+            && !pthread_cond_timedwait(&step_cond, &step_mutex, &deadline))
+          ;
+     step->overlapped = n_uploaded >= step->wait_for;
+     pthread_mutex_unlock(&step_mutex);
+     *step->out = *step->in;
+}
+
+START_TEST(test_ln_sim_overlap)
+{
+     ln_sim_config config = {0, 0, 0, 5e-3, 1024, 1};
+     struct step steps[4];
+     int inputs[4] = {10, 11, 12, 13};
+     int bufs[2], outs[4];
+     int i;
+
+     /* each step uploads its input and runs a kernel on it; the upload of
+        a step is queued while the kernel of the step before runs, into
+        the other buffer */
+     ln_sim_init(&config);
+     n_uploaded = 0;
+     for (i = 0; i < 4; i++) {
+          ln_sim_copy_async(&bufs[i % 2], &inputs[i], sizeof(int), 0);
+          pthread_mutex_lock(&step_mutex);
+          n_uploaded = i + 1;
+          pthread_cond_broadcast(&step_cond);
+          pthread_mutex_unlock(&step_mutex);
+          ln_sim_wait_ready(&bufs[i % 2]);
+          steps[i].in = &bufs[i % 2];
+          steps[i].out = &outs[i];
+          steps[i].wait_for = i < 3 ? i + 2 : 0;
+          ln_sim_launch(step_kernel, &steps[i]);
+          ln_sim_set_ready(&outs[i]);
+     }
+     ln_sim_sync();
+
+     for (i = 0; i < 4; i++) {
+          ck_assert_int_eq(outs[i], inputs[i]);
+          ck_assert_int_eq(steps[i].overlapped, 1);
+     }
+}
+END_TEST
+
+START_TEST(test_ln_sim_uninitialized)
+{
+     ln_list *ops;
+     char *json_str = "{\"ops\": [{\"name\": \"create1\", \"optype\": \"create\", \"tensors_in\": [], \"tensors_out\": [{\"arg_name\": \"dst\", \"name\": \"create1\"}], \"params\": [{\"arg_name\": \"dtype\", \"value\": \"TL_FLOAT\"}, {\"arg_name\": \"dims\", \"value\": [1]}, {\"arg_name\": \"data\", \"value\": [1]}]}, {\"name\": \"copy1\", \"optype\": \"copy_sim\", \"tensors_in\": [{\"arg_name\": \"src\", \"name\": \"create1\"}], \"tensors_out\": [{\"arg_name\": \"dst\", \"name\": \"copy1\"}], \"params\": []}]}";
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ck_assert_ptr_ne(error, NULL);
+     ck_assert_int_eq(error->level, LN_ERROR);
+     ln_error_free(error);
+     error = NULL;
+     ck_assert_ptr_eq(ops, NULL);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_sim_suite(void)
+{
+     Suite *s;
+     TCase *tc_sim;
+
+     s = suite_create("sim");
+     tc_sim = tcase_create("sim");
+     tcase_add_checked_fixture(tc_sim, setup, teardown);
+
+     tcase_add_test(tc_sim, test_ln_sim_stream);
+     tcase_add_test(tc_sim, test_ln_sim_placement);
+     tcase_add_test(tc_sim, test_ln_sim_placement_async);
+     tcase_add_test(tc_sim, test_ln_sim_overlap);
+     tcase_add_test(tc_sim, test_ln_sim_uninitialized);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_sim);
+
+     return s;
+}
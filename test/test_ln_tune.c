@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2018 Zhao Zhixu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <ctype.h>
+#include <unistd.h>
+#include "test_lightnet.h"
+#include "../src/ln_tune.h"
+#include "../src/ln_parse.h"
+#include "../src/ln_op.h"
+#include "../src/cJSON.h"
+
+#define CACHE_PATH "result/test_ln_tune_cache.json"
+
+static char *json_str;
+static ln_list *registered_ops;
+static ln_error *error = NULL;
+
+extern ln_op *ln_init_ops[];
+
+static void setup(void)
+{
+     json_str = read_json("test_ln_tune.json");
+     registered_ops = ln_op_list_create_from_array(ln_init_ops);
+}
+
+static void teardown(void)
+{
+     ln_free(json_str);
+     ln_list_free(registered_ops);
+}
+
+START_TEST(test_ln_tune_variants)
+{
+     ln_list *ops;
+     ln_op *op;
+     tl_tensor *dst;
+     float expected[24];
+     char *names[] = {"transpose1", "transpose2"};
+     int i, j;
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_do_run(ops, &error);
+     ln_error_handle(&error);
+
+     for (i = 0; i < 2; i++) {
+          op = ln_op_list_find_by_name(ops, names[i]);
+          ck_assert_ptr_ne(ln_op_find_variant(op, "tl"), NULL);
+          ck_assert_ptr_ne(ln_op_find_variant(op, "gather"), NULL);
+          ck_assert_ptr_eq(ln_op_find_variant(op, "no_such_variant"), NULL);
+
+          dst = ln_op_list_find_tensor_by_name(ops, names[i]);
+          ln_op_find_variant(op, "tl")->run(op->op_arg, &error);
+          ln_error_handle(&error);
+          memcpy(expected, dst->data, sizeof(expected));
+          memset(dst->data, 0, sizeof(expected));
+          ln_op_find_variant(op, "gather")->run(op->op_arg, &error);
+          ln_error_handle(&error);
+          for (j = 0; j < 24; j++)
+               ck_assert_float_eq(((float *)dst->data)[j], expected[j]);
+     }
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+}
+END_TEST
+
+START_TEST(test_ln_tune_ops)
+{
+     ln_list *ops;
+     ln_op *op;
+     char *cpu_model, *key;
+     int n, i;
+
+     unlink(CACHE_PATH);
+     cpu_model = ln_tune_cpu_model();
+     ck_assert(strlen(cpu_model) > 0);
+
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ln_tune_ops(ops, CACHE_PATH, &n, &error);
+     ck_assert_ptr_eq(error, NULL);
+     ck_assert_int_eq(n, 2);
+     ck_assert_int_eq(access(CACHE_PATH, R_OK), 0);
+
+     key = ln_tune_key(ln_op_list_find_by_name(ops, "transpose1"), cpu_model);
+     ck_assert_ptr_ne(strstr(key, cpu_model), NULL);
+     ck_assert_ptr_ne(strstr(key, "src:"), NULL);
+     ck_assert_ptr_ne(strstr(key, "2x3x4"), NULL);
+     ln_free(key);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+
+     /* a second load is served by the cache */
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     ln_tune_ops(ops, CACHE_PATH, &n, &error);
+     ck_assert_ptr_eq(error, NULL);
+     ck_assert_int_eq(n, 0);
+
+     op = ln_op_list_find_by_name(ops, "transpose1");
+     for (i = 0; op->variants[i].name; i++) {
+          if (op->variants[i].run == op->run)
+               break;
+     }
+     ck_assert_ptr_ne(op->variants[i].name, NULL);
+
+     /* ops without variants are left alone */
+     op = ln_op_list_find_by_name(ops, "create1");
+     ck_assert_ptr_eq(op->variants, NULL);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(cpu_model);
+     unlink(CACHE_PATH);
+}
+END_TEST
+
+START_TEST(test_ln_tune_case)
+{
+     ln_list *ops, *l;
+     ln_op *op;
+     cJSON *cache;
+     char *cpu_model, *key, *str, *p;
+     FILE *fp;
+     int n;
+
+     /* a cache whose keys only differ in case must not be hit */
+     cpu_model = ln_tune_cpu_model();
+     ops = ln_parse_ops(json_str, registered_ops, &error);
+     ln_error_handle(&error);
+     cache = cJSON_CreateObject();
+     for (l = ops; l; l = l->next) {
+          op = l->data;
+          if (!op->variants)
+               continue;
+          key = ln_tune_key(op, cpu_model);
+          for (p = key; *p; p++)
+               *p = islower(*p) ? toupper(*p) : tolower(*p);
+          cJSON_AddStringToObject(cache, key, op->variants[0].name);
+          ln_free(key);
+     }
+     str = cJSON_Print(cache);
+     fp = fopen(CACHE_PATH, "w");
+     ck_assert_ptr_ne(fp, NULL);
+     fputs(str, fp);
+     fclose(fp);
+     cJSON_free(str);
+     cJSON_Delete(cache);
+
+     ln_tune_ops(ops, CACHE_PATH, &n, &error);
+     ck_assert_ptr_eq(error, NULL);
+     ck_assert_int_eq(n, 2);
+
+     ln_op_list_do_post_run(ops, &error);
+     ln_error_handle(&error);
+     ln_op_list_free_tables_too(ops);
+     ln_free(cpu_model);
+     unlink(CACHE_PATH);
+}
+END_TEST
+/* end of tests */
+
+Suite *make_tune_suite(void)
+{
+     Suite *s;
+     TCase *tc_tune;
+
+     s = suite_create("tune");
+     tc_tune = tcase_create("tune");
+     tcase_add_checked_fixture(tc_tune, setup, teardown);
+
+     tcase_add_test(tc_tune, test_ln_tune_variants);
+     tcase_add_test(tc_tune, test_ln_tune_ops);
+     tcase_add_test(tc_tune, test_ln_tune_case);
+     /* end of adding tests */
+
+     suite_add_tcase(s, tc_tune);
+
+     return s;
+}